@@ -0,0 +1,174 @@
+#include "HeadlessScene.h"
+#include <sstream>
+
+/***********\
+ * DEFINES *
+\***********/
+#define MAX_PLANE_PARAMS 16
+#define COMMENT_CHAR '#'
+#define PROPERTY_CHAR '+'
+#define QUERY_GROUP 64		// Rays of a batch looked up in the broadphase together, as in EnvironmentManager
+
+// Default Constructor
+HeadlessScene::HeadlessScene()
+{
+}
+
+// Destructor
+HeadlessScene::~HeadlessScene()
+{
+	for ( unsigned int i = 0; i < m_pSystems.size(); ++i )
+		delete m_pSystems[ i ];
+}
+
+// Reads the file the same way as the Object Factory: a keyword line ("plane {"), then whitespace separated
+//	values up to the closing "}".  Property blocks ("+texture { ... }") inside an object are skipped.
+bool HeadlessScene::loadFromFile( const string& sFileName, const vector< string >& sOptions )
+{
+	ifstream inFile( sFileName );
+	string sBuffer, sIndicator, sToken;
+	vector< string > sData;
+
+	if ( !inFile.good() )
+	{
+		cout << "Error: Unable to open scene file \"" << sFileName << "\".\n";
+		return false;
+	}
+
+	while ( getline( inFile, sBuffer ) )
+	{
+		istringstream sStream( sBuffer );
+		unsigned int iPropertyDepth = 0;
+		bool bClosed = false;
+
+		// Determine if we care about the line
+		if ( sBuffer.empty() || COMMENT_CHAR == sBuffer[ 0 ] || !(sStream >> sIndicator) )
+			continue;
+
+		sData.clear();
+		while ( !bClosed && getline( inFile, sBuffer ) )
+		{
+			istringstream sLine( sBuffer );
+
+			while ( !bClosed && sLine >> sToken )
+			{
+				if ( PROPERTY_CHAR == sToken[ 0 ] )
+					++iPropertyDepth;
+				else if ( "}" == sToken )
+				{
+					bClosed = (0 == iPropertyDepth);
+					if ( !bClosed )
+						--iPropertyDepth;
+				}
+				else if ( 0 == iPropertyDepth && "{" != sToken )
+					sData.push_back( sToken );
+			}
+		}
+
+		handleData( sIndicator, sData, sOptions );
+	}
+
+	if ( m_pSystems.empty() )
+		cout << "Error: No mass_spring block in \"" << sFileName << "\".\n";
+
+	return !m_pSystems.empty();
+}
+
+// Builds the planes and the Mass Spring Systems; everything else is only drawn, so it's ignored.
+void HeadlessScene::handleData( const string& sIndicator, vector< string >& sData, const vector< string >& sOptions )
+{
+	if ( "plane" == sIndicator )
+	{
+		if ( MAX_PLANE_PARAMS == sData.size() )
+		{
+			vector< vec3 > vCorners;
+
+			for ( unsigned int i = 3; i < 15; i += 3 )
+				vCorners.push_back( vec3( stof( sData[ i ] ), stof( sData[ i + 1 ] ), stof( sData[ i + 2 ] ) ) );
+
+			addPlane( vec3( stof( sData[ 0 ] ), stof( sData[ 1 ] ), stof( sData[ 2 ] ) ), vCorners );
+		}
+		else
+			cout << "Error: plane needs " << MAX_PLANE_PARAMS << " parameters, found " << sData.size() << ".\n";
+	}
+	else if ( "mass_spring" == sIndicator )
+	{
+		sData.insert( sData.end(), sOptions.begin(), sOptions.end() );
+		addSystem( MassSpringSystem::createFromScene( sData ) );
+	}
+}
+
+// Adds a plane to collide against
+void HeadlessScene::addPlane( const vec3& vPosition, const vector< vec3 >& vCorners )
+{
+	vec3 vMin, vMax;
+
+	m_vPlanes.push_back( PlaneCollider( vPosition, vCorners ) );
+	m_vPlanes.back().getBounds( vMin, vMax );
+	m_vPlaneMin.push_back( vMin );
+	m_vPlaneMax.push_back( vMax );
+	m_sPlaneBVH.build( m_vPlaneMin, m_vPlaneMax );
+}
+
+// Adds a simulated system, every mass_spring block of the scene adds one
+void HeadlessScene::addSystem( MassSpringSystem* pSystem )
+{
+	if ( nullptr != pSystem )
+	{
+		pSystem->setEnvironment( this );
+		m_pSystems.push_back( pSystem );
+	}
+}
+
+// Closest plane hit along the ray, see EnvironmentManager::checkCollision.
+float HeadlessScene::checkCollision( const vec3& vPos, const vec3& vRay, vec3& vIntersectingNormal )
+{
+	float fReturnT = FLT_MAX;
+	float fT;
+	vec3 vReturnNormal = vIntersectingNormal;
+	vec3 vRayMin, vRayMax;
+
+	BoundingVolumeHierarchy::getRayBounds( vPos, vRay, vRayMin, vRayMax );
+	m_sPlaneBVH.query( vRayMin, vRayMax, [ & ]( unsigned int iPlane )
+	{
+		if ( m_vPlanes[ iPlane ].isCollision( vPos, vRay, fT, vIntersectingNormal ) && fT >= 0.0 && fT < fReturnT )
+		{
+			fReturnT = fT;
+			vReturnNormal = vIntersectingNormal;
+		}
+	} );
+
+	vIntersectingNormal = vReturnNormal;
+	return fReturnT;
+}
+
+// Batched search, see EnvironmentManager::checkCollisions.
+void HeadlessScene::checkCollisions( const vec3* pPos, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+									 unsigned int* pObject )
+{
+	vec3 vRayMin, vRayMax;
+
+	for ( unsigned int i = 0; i < iCount; ++i )
+		pT[ i ] = FLT_MAX;
+
+	for ( unsigned int iFirst = 0; iFirst < iCount; iFirst += QUERY_GROUP )
+	{
+		unsigned int iGroup = std::min( iCount - iFirst, (unsigned int)QUERY_GROUP );
+
+		BoundingVolumeHierarchy::getRayBounds( pPos + iFirst, pRay + iFirst, iGroup, vRayMin, vRayMax );
+		m_sPlaneBVH.query( vRayMin, vRayMax, [ & ]( unsigned int iPlane )
+		{
+			m_vPlanes[ iPlane ].findCollisions( pPos + iFirst, pRay + iFirst, iGroup, pT + iFirst, pNormal + iFirst,
+												pObject + iFirst, iPlane );
+		} );
+	}
+}
+
+// Distance to the bounds of the closest plane that isn't ignored, see EnvironmentManager::getClearance.
+float HeadlessScene::getClearance( const vec3& vPos, const unsigned int* pIgnore, unsigned int iIgnoreCount )
+{
+	return m_sPlaneBVH.getDistance( vPos, [ & ]( unsigned int iPlane )
+	{
+		return find( pIgnore, pIgnore + iIgnoreCount, iPlane ) == pIgnore + iIgnoreCount;
+	} );
+}
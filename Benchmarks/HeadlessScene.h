@@ -0,0 +1,48 @@
+#pragma once
+#include "stdafx.h"
+#include "CollisionEnvironment.h"
+#include "PlaneCollider.h"
+#include "BoundingVolumeHierarchy.h"
+#include "MassSpringSystem.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: HeadlessScene.h
+// Class: The simulated part of a scene, without a GL context: the mass_spring blocks and the planes
+//			they collide against.  Every other block (lights, spheres, meshes, properties) is skipped.
+//////////////////////////////////
+class HeadlessScene : public CollisionEnvironment
+{
+public:
+	HeadlessScene();
+	~HeadlessScene();
+
+	// Loads sFileName; sOptions ("option value" pairs) are applied after each mass_spring block's own.
+	//	Returns false if the file couldn't be read or has no valid mass_spring block.
+	bool loadFromFile( const string& sFileName, const vector< string >& sOptions );
+
+	// Adds a plane through vPosition with 4 corners relative to it (same as a plane block)
+	void addPlane( const vec3& vPosition, const vector< vec3 >& vCorners );
+
+	// Takes ownership of pSystem, which then collides against the scene's planes
+	void addSystem( MassSpringSystem* pSystem );
+	MassSpringSystem* getSystem( unsigned int iIndex = 0 ) { return m_pSystems[ iIndex ]; }
+	unsigned int getNumSystems() const { return m_pSystems.size(); }
+	unsigned int getNumPlanes() const { return m_vPlanes.size(); }
+
+	// Updates every system by a frame (see MassSpringSystem::updateSystems)
+	void update() { MassSpringSystem::updateSystems( m_pSystems ); }
+
+	// Same search as the Environment Manager over the scene's planes, keyed by their index
+	float checkCollision( const vec3& vPos, const vec3& vRay, vec3& vIntersectingNormal );
+	void checkCollisions( const vec3* pPos, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						  unsigned int* pObject );
+	float getClearance( const vec3& vPos, const unsigned int* pIgnore, unsigned int iIgnoreCount );
+
+private:
+	vector< MassSpringSystem* > m_pSystems;
+	vector< PlaneCollider > m_vPlanes;
+	vector< vec3 > m_vPlaneMin, m_vPlaneMax;
+	BoundingVolumeHierarchy m_sPlaneBVH;	// The planes don't move, so it's rebuilt as they're added
+
+	void handleData( const string& sIndicator, vector< string >& sData, const vector< string >& sOptions );
+};
@@ -0,0 +1,162 @@
+// Benchmark of the MassSpringSystem update across lattice sizes and topologies.
+//	Sweeps the cube, cloth, chain and flag topologies from 8^3 up to the given size^3 masses (cloth and flag
+//	as a near square sheet, chain as a single line of the same number of masses), plus a 1024x1024 cloth
+//	once the sweep reaches 128^3.  Each run is timed on its own system without any collision environment:
+//	initialize() construction time, then ns per spring and ns per mass for every substep taken.
+//	Results go to stdout as CSV or JSON so they can be compared between releases; progress goes to stderr.
+//
+//	Usage: bench_sim [max size] [csv|json] [option value ...]
+//		max size: largest cube edge, the sweep doubles from 8 up to it (default 128)
+//		option value: mass_spring options applied to every run (threads 4, integrator xpbd, ...)
+#include "MassSpringSystem.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace glm;
+
+/***********\
+ * DEFINES *
+\***********/
+#define MIN_SIZE 8
+#define DEFAULT_MAX_SIZE 128
+#define LARGE_CLOTH_SIZE 1024		// 1024x1024 cloth, run with the 128^3 sizes
+#define LARGE_CLOTH_FROM 128
+#define SPRING_K 1000.0f
+#define REST_LENGTH 1.0f
+#define MASS_PER_POINT 0.1f
+#define DAMPING_COEFF 0.0001f
+#define DELTA_T 0.001f
+#define LOOP_COUNT 4
+#define COLLISION_K 1000.0f
+#define COLLISION_DAMP 2.0f
+#define WORK_PER_RUN 2.0e8			// Spring updates timed per run, so small lattices still run long enough
+#define MIN_UPDATES 2
+
+struct BenchRun
+{
+	const char* sTopology;
+	SpringType eType;
+	int iLength, iHeight, iDepth;
+};
+
+struct BenchResult
+{
+	unsigned int iNumMasses, iNumSprings;
+	unsigned long long iSubsteps;
+	double fInitMs, fNsPerSpring, fNsPerMass;
+};
+
+// Sheet of about iNumMasses masses, as close to square as the count allows
+static void sheetSize( int iNumMasses, int& iLength, int& iHeight )
+{
+	iLength = (int)sqrt( (double)iNumMasses );
+	iHeight = (iNumMasses + iLength - 1) / iLength;
+}
+
+// Builds and steps one system, timing initialize() and the updates separately.
+static BenchResult runBenchmark( const BenchRun& sRun, const vector< string >& sOptions )
+{
+	BenchResult sResult;
+	float fTotalMass = MASS_PER_POINT * sRun.iLength * sRun.iHeight * sRun.iDepth;
+	MassSpringSystem sSystem( SPRING_K, REST_LENGTH, fTotalMass, DAMPING_COEFF, DELTA_T, LOOP_COUNT, COLLISION_K, COLLISION_DAMP );
+
+	for ( unsigned int i = 0; i + 1 < sOptions.size(); i += 2 )
+		sSystem.setOption( sOptions[ i ], sOptions[ i + 1 ] );
+
+	chrono::high_resolution_clock::time_point tStart = chrono::high_resolution_clock::now();
+	sSystem.initialize( sRun.iLength, sRun.iHeight, sRun.iDepth, sRun.eType );
+	chrono::duration< double, milli > tInit = chrono::high_resolution_clock::now() - tStart;
+
+	sResult.iNumMasses = sSystem.getNumMasses();
+	sResult.iNumSprings = sSystem.getNumSprings();
+	sResult.fInitMs = tInit.count();
+
+	// Enough updates for WORK_PER_RUN spring updates, after one to warm up
+	int iUpdates = (int)(WORK_PER_RUN / ((double)LOOP_COUNT * (sResult.iNumSprings > 0 ? sResult.iNumSprings : 1)));
+	if ( iUpdates < MIN_UPDATES )
+		iUpdates = MIN_UPDATES;
+
+	sSystem.update();
+	unsigned long long iFirstStep = sSystem.getStepCount();
+
+	tStart = chrono::high_resolution_clock::now();
+	for ( int i = 0; i < iUpdates; ++i )
+		sSystem.update();
+	chrono::duration< double, nano > tElapsed = chrono::high_resolution_clock::now() - tStart;
+
+	sResult.iSubsteps = sSystem.getStepCount() - iFirstStep;
+	sResult.fNsPerSpring = tElapsed.count() / ((double)sResult.iSubsteps * sResult.iNumSprings);
+	sResult.fNsPerMass = tElapsed.count() / ((double)sResult.iSubsteps * sResult.iNumMasses);
+
+	return sResult;
+}
+
+int main( int argc, char* argv[] )
+{
+	int iMaxSize = (argc > 1) ? atoi( argv[ 1 ] ) : DEFAULT_MAX_SIZE;
+	bool bJSON = (argc > 2) && 0 == strcmp( argv[ 2 ], "json" );
+	vector< string > sOptions;
+	vector< BenchRun > vRuns;
+	string sOptionText;
+
+	if ( iMaxSize < MIN_SIZE || (argc > 2 && !bJSON && 0 != strcmp( argv[ 2 ], "csv" )) || (argc > 3 && 0 != (argc - 3) % 2) )
+	{
+		printf( "Usage: bench_sim [max size >= %d] [csv|json] [option value ...]\n", MIN_SIZE );
+		return 1;
+	}
+
+	for ( int i = 3; i + 1 < argc; i += 2 )
+	{
+		sOptions.push_back( argv[ i ] );
+		sOptions.push_back( argv[ i + 1 ] );
+		sOptionText += (sOptionText.empty() ? "" : " ") + string( argv[ i ] ) + " " + argv[ i + 1 ];
+	}
+
+	for ( int iSize = MIN_SIZE; iSize <= iMaxSize; iSize *= 2 )
+	{
+		int iNumMasses = iSize * iSize * iSize;
+		int iLength, iHeight;
+		sheetSize( iNumMasses, iLength, iHeight );
+
+		vRuns.push_back( { "cube", CUBE, iSize, iSize, iSize } );
+		vRuns.push_back( { "cloth", CLOTH, iLength, iHeight, 1 } );
+		vRuns.push_back( { "chain", CHAIN, iNumMasses, 1, 1 } );
+		vRuns.push_back( { "flag", FLAG, iLength, iHeight, 1 } );
+	}
+
+	if ( iMaxSize >= LARGE_CLOTH_FROM )
+		vRuns.push_back( { "cloth", CLOTH, LARGE_CLOTH_SIZE, LARGE_CLOTH_SIZE, 1 } );
+
+	if ( bJSON )
+		printf( "[\n" );
+	else
+		printf( "topology,length,height,depth,masses,springs,substeps,init_ms,ns_per_spring,ns_per_mass,options\n" );
+
+	for ( unsigned int r = 0; r < vRuns.size(); ++r )
+	{
+		const BenchRun& sRun = vRuns[ r ];
+
+		fprintf( stderr, "%s %dx%dx%d...\n", sRun.sTopology, sRun.iLength, sRun.iHeight, sRun.iDepth );
+		BenchResult sResult = runBenchmark( sRun, sOptions );
+
+		if ( bJSON )
+			printf( "  { \"topology\": \"%s\", \"length\": %d, \"height\": %d, \"depth\": %d, \"masses\": %u, \"springs\": %u, "
+					"\"substeps\": %llu, \"init_ms\": %.3f, \"ns_per_spring\": %.4f, \"ns_per_mass\": %.4f, \"options\": \"%s\" }%s\n",
+					sRun.sTopology, sRun.iLength, sRun.iHeight, sRun.iDepth, sResult.iNumMasses, sResult.iNumSprings,
+					sResult.iSubsteps, sResult.fInitMs, sResult.fNsPerSpring, sResult.fNsPerMass, sOptionText.c_str(),
+					(r + 1 < vRuns.size()) ? "," : "" );
+		else
+			printf( "%s,%d,%d,%d,%u,%u,%llu,%.3f,%.4f,%.4f,%s\n", sRun.sTopology, sRun.iLength, sRun.iHeight, sRun.iDepth,
+					sResult.iNumMasses, sResult.iNumSprings, sResult.iSubsteps, sResult.fInitMs, sResult.fNsPerSpring,
+					sResult.fNsPerMass, sOptionText.c_str() );
+		fflush( stdout );
+	}
+
+	if ( bJSON )
+		printf( "]\n" );
+
+	return 0;
+}
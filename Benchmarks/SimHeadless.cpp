@@ -0,0 +1,194 @@
+// Headless simulation runner.
+//	Loads the mass_spring and plane blocks of a scene file, steps the systems as fast as it can without a
+//	GL context and reports the throughput and checksums of the final state (every system's, in scene order).  Identical checksums mean
+//	bitwise identical positions and velocities, so runs can be compared across builds and machines.
+//	Exits with 1 if the scene couldn't be loaded or the state stopped being finite.
+//
+//	Usage: sim_headless <scene file> [steps] [option value ...]
+//		steps: number of updates (frames) to run, each is update_loop_count substeps (default 1000)
+//		option value: extra mass_spring options (threads 4, integrator xpbd, ...), applied after the scene's
+//		restore <file>: picks every system up from a snapshot before the first step instead of from its lattice
+//		save <file>: writes a snapshot of every system after the last step (see MassSpringSystem::getSnapshotName)
+//		record <file>: records every system's positions after each step to a trajectory, named as snapshots are,
+//			and reports its size and the quantization error of its last frame
+#include "HeadlessScene.h"
+#include "TrajectoryReader.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+using namespace glm;
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_STEPS 1000
+#define FNV_OFFSET_BASIS 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+// 64-bit FNV-1a hash of the bytes of every vector in vData
+static unsigned long long checksum( const aligned_vector< vec3 >& vData )
+{
+	const unsigned char* pBytes = reinterpret_cast< const unsigned char* >( vData.data() );
+	unsigned long long iHash = FNV_OFFSET_BASIS;
+
+	for ( size_t i = 0; i < vData.size() * sizeof( vec3 ); ++i )
+		iHash = (iHash ^ pBytes[ i ]) * FNV_PRIME;
+
+	return iHash;
+}
+
+// Mean of the vectors (accumulated in double) and whether every component is finite
+static bool meanFinite( const aligned_vector< vec3 >& vData, double fMean[ 3 ] )
+{
+	bool bFinite = true;
+
+	fMean[ 0 ] = fMean[ 1 ] = fMean[ 2 ] = 0.0;
+	for ( unsigned int i = 0; i < vData.size(); ++i )
+	{
+		for ( int j = 0; j < 3; ++j )
+		{
+			bFinite &= (0 != std::isfinite( vData[ i ][ j ] ));
+			fMean[ j ] += vData[ i ][ j ];
+		}
+	}
+
+	for ( int j = 0; j < 3 && !vData.empty(); ++j )
+		fMean[ j ] /= (double)vData.size();
+
+	return bFinite;
+}
+
+int main( int argc, char* argv[] )
+{
+	int iSteps = (argc > 2) ? atoi( argv[ 2 ] ) : DEFAULT_STEPS;
+	vector< string > sOptions;
+	string sRestore, sSave, sRecord;
+	HeadlessScene sScene;
+	double fPositionMean[ 3 ], fVelocityMean[ 3 ];
+
+	if ( argc < 2 || iSteps < 1 || (argc > 3 && 0 != (argc - 3) % 2) )
+	{
+		printf( "Usage: sim_headless <scene file> [steps >= 1] [option value ...]\n" );
+		return 1;
+	}
+
+	for ( int i = 3; i + 1 < argc; i += 2 )
+	{
+		if ( string( "restore" ) == argv[ i ] )
+			sRestore = argv[ i + 1 ];
+		else if ( string( "save" ) == argv[ i ] )
+			sSave = argv[ i + 1 ];
+		else if ( string( "record" ) == argv[ i ] )
+			sRecord = argv[ i + 1 ];
+		else
+		{
+			sOptions.push_back( argv[ i ] );
+			sOptions.push_back( argv[ i + 1 ] );
+		}
+	}
+
+	chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+	if ( !sScene.loadFromFile( argv[ 1 ], sOptions ) )
+		return 1;
+
+	for ( unsigned int s = 0; s < sScene.getNumSystems() && !sRestore.empty(); ++s )
+		if ( !sScene.getSystem( s )->loadSnapshot( MassSpringSystem::getSnapshotName( sRestore, s ) ) )
+			return 1;
+	double fInitTime = chrono::duration< double >( chrono::steady_clock::now() - tStart ).count();
+
+	unsigned int iNumMasses = 0, iNumSprings = 0, iNumActive = 0;
+	int iNumThreads = 1;
+	bool bDeterministic = false;
+
+	for ( unsigned int s = 0; s < sScene.getNumSystems(); ++s )
+	{
+		iNumMasses += sScene.getSystem( s )->getNumMasses();
+		iNumSprings += sScene.getSystem( s )->getNumSprings();
+		iNumThreads = std::max( iNumThreads, sScene.getSystem( s )->getThreadCount() );
+		bDeterministic |= sScene.getSystem( s )->isDeterministic();
+	}
+
+	printf( "%s: %u systems, %u masses, %u springs, %u planes, %d threads%s, initialized in %.3f s\n", argv[ 1 ],
+			sScene.getNumSystems(), iNumMasses, iNumSprings, sScene.getNumPlanes(), iNumThreads,
+			bDeterministic ? " (deterministic)" : "", fInitTime );
+
+	// Recording is part of the timed loop: it should only cost the copy of each frame
+	vector< TrajectoryRecorder > vRecorders( sRecord.empty() ? 0 : sScene.getNumSystems() );
+
+	for ( unsigned int s = 0; s < vRecorders.size(); ++s )
+		if ( !vRecorders[ s ].open( MassSpringSystem::getSnapshotName( sRecord, s ), sScene.getSystem( s )->getNumMasses() ) )
+			return 1;
+
+	tStart = chrono::steady_clock::now();
+	for ( int i = 0; i < iSteps; ++i )
+	{
+		sScene.update();
+		for ( unsigned int s = 0; s < vRecorders.size(); ++s )
+			vRecorders[ s ].record( sScene.getSystem( s )->getPositions() );
+	}
+	double fTime = chrono::duration< double >( chrono::steady_clock::now() - tStart ).count();
+
+	// Every system's state, in scene order
+	aligned_vector< vec3 > vPositions, vVelocities;
+	unsigned long long iSubsteps = 0, iSpringSteps = 0;
+
+	for ( unsigned int s = 0; s < sScene.getNumSystems(); ++s )
+	{
+		MassSpringSystem* pSystem = sScene.getSystem( s );
+
+		vPositions.insert( vPositions.end(), pSystem->getPositions().begin(), pSystem->getPositions().end() );
+		vVelocities.insert( vVelocities.end(), pSystem->getVelocities().begin(), pSystem->getVelocities().end() );
+		iSubsteps += pSystem->getStepCount();
+		iSpringSteps += (unsigned long long)pSystem->getNumSprings() * pSystem->getStepCount();
+		iNumActive += pSystem->getNumActiveMasses();
+	}
+
+	bool bFinite = meanFinite( vPositions, fPositionMean ) & meanFinite( vVelocities, fVelocityMean );
+
+	for ( unsigned int s = 0; s < sScene.getNumSystems() && !sSave.empty(); ++s )
+		bFinite &= sScene.getSystem( s )->saveSnapshot( MassSpringSystem::getSnapshotName( sSave, s ) );
+
+	printf( "steps         %d (%llu substeps) in %.3f s\n", iSteps, iSubsteps, fTime );
+	printf( "steps/sec     %.1f\n", iSteps / fTime );
+	printf( "substeps/sec  %.1f\n", iSubsteps / fTime );
+	printf( "springs/sec   %.4g\n", (double)iSpringSteps / fTime );
+	printf( "position      checksum %016llx  mean %.6f %.6f %.6f\n", checksum( vPositions ),
+			fPositionMean[ 0 ], fPositionMean[ 1 ], fPositionMean[ 2 ] );
+	printf( "velocity      checksum %016llx  mean %.6f %.6f %.6f\n", checksum( vVelocities ),
+			fVelocityMean[ 0 ], fVelocityMean[ 1 ], fVelocityMean[ 2 ] );
+	printf( "active        %u of %u masses awake\n", iNumActive, iNumMasses );
+
+	// Reads the last frame of each trajectory back, after the seek through its index
+	for ( unsigned int s = 0; s < vRecorders.size(); ++s )
+	{
+		MassSpringSystem* pSystem = sScene.getSystem( s );
+		aligned_vector< vec3 > vFrame;
+		float fMaxError = 0.0f;
+
+		bFinite &= vRecorders[ s ].close();
+		TrajectoryReader sReader( MassSpringSystem::getSnapshotName( sRecord, s ) );
+		if ( !sReader.readFrame( sReader.getNumFrames() - 1, vFrame ) )
+		{
+			bFinite = false;
+			continue;
+		}
+
+		for ( unsigned int i = 0; i < vFrame.size(); ++i )
+			for ( int j = 0; j < 3; ++j )
+				fMaxError = std::max( fMaxError, std::abs( vFrame[ i ][ j ] - pSystem->getPositions()[ i ][ j ] ) );
+
+		// A dropped last frame leaves an earlier one at the end, the error is then against the wrong state
+		printf( "trajectory    %llu frames (%llu dropped), %.1f bytes/frame (%.1fx smaller than raw), last frame max error %g\n",
+				sReader.getNumFrames(), vRecorders[ s ].getFramesDropped(), (double)vRecorders[ s ].getBytesWritten() / sReader.getNumFrames(),
+				(double)sReader.getNumFrames() * pSystem->getNumMasses() * sizeof( vec3 ) / vRecorders[ s ].getBytesWritten(),
+				fMaxError );
+	}
+
+	if ( !bFinite )
+		printf( "Error: the state is no longer finite.\n" );
+
+	return bFinite ? 0 : 1;
+}
@@ -0,0 +1,177 @@
+// Microbenchmark for the spring force kernels.
+//	Builds a jittered cube lattice with the same springs as MassSpringSystem::initialize, then times the
+//	original spring loop (length + two normalizes + per-spring damping), and each kernel the CPU supports.
+//	Every kernel is checked against the scalar kernel with SPRING_KERNEL_TOLERANCE.
+//
+//	Usage: bench_kernels [size] [iterations]
+#include "SpringKernels.h"
+#include "AlignedAllocator.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace std;
+using namespace glm;
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_SIZE 32
+#define DEFAULT_ITERATIONS 200
+#define SPRING_K 1000.0f
+#define DAMPING_COEFF 0.0001f
+#define JITTER 0.1f
+
+struct BenchSystem
+{
+	aligned_vector< vec3 > m_vPosition, m_vVelocity, m_vForce;
+	aligned_vector< unsigned int > m_iMass1, m_iMass2;
+	aligned_vector< float > m_fRestLength;
+};
+
+// Connects two masses with a spring at rest at their lattice distance
+static void addSpring( BenchSystem& sSystem, unsigned int iMass1, unsigned int iMass2 )
+{
+	sSystem.m_iMass1.push_back( iMass1 );
+	sSystem.m_iMass2.push_back( iMass2 );
+	sSystem.m_fRestLength.push_back( length( sSystem.m_vPosition[ iMass1 ] - sSystem.m_vPosition[ iMass2 ] ) );
+}
+
+// iSize^3 lattice connected to every neighbour in the 26-neighbourhood, then jittered so the springs are stretched.
+static void buildCube( BenchSystem& sSystem, int iSize )
+{
+	srand( 1 );
+
+	for ( int z = 0; z < iSize; ++z )
+		for ( int y = 0; y < iSize; ++y )
+			for ( int x = 0; x < iSize; ++x )
+			{
+				sSystem.m_vPosition.push_back( vec3( (float)x, (float)y, (float)z ) );
+				sSystem.m_vVelocity.push_back( vec3( (float)(rand() % 100) / 100.0f ) );
+				sSystem.m_vForce.push_back( vec3( 0.0f ) );
+			}
+
+	for ( int z = 0; z < iSize; ++z )
+		for ( int y = 0; y < iSize; ++y )
+			for ( int x = 0; x < iSize; ++x )
+				for ( int dz = 0; dz <= 1; ++dz )
+					for ( int dy = -1; dy <= 1; ++dy )
+						for ( int dx = -1; dx <= 1; ++dx )
+						{
+							// Only half of the neighbourhood so every pair is added once
+							if ( (0 == dz && (dy < 0 || (0 == dy && dx <= 0)))
+								 || x + dx < 0 || x + dx >= iSize || y + dy < 0 || y + dy >= iSize || z + dz >= iSize )
+								continue;
+
+							addSpring( sSystem, (z * iSize + y) * iSize + x, ((z + dz) * iSize + y + dy) * iSize + x + dx );
+						}
+
+	for ( unsigned int i = 0; i < sSystem.m_vPosition.size(); ++i )
+		sSystem.m_vPosition[ i ] += vec3( (float)(rand() % 201 - 100), (float)(rand() % 201 - 100), (float)(rand() % 201 - 100) ) * (JITTER / 100.0f);
+}
+
+// The spring loop as it was before the kernels: both directions normalized, damping per spring end point.
+static void accumulateOriginal( BenchSystem& sSystem )
+{
+	for ( unsigned int s = 0; s < sSystem.m_fRestLength.size(); ++s )
+	{
+		unsigned int iPoint1 = sSystem.m_iMass1[ s ];
+		unsigned int iPoint2 = sSystem.m_iMass2[ s ];
+		vec3 vD12 = sSystem.m_vPosition[ iPoint2 ] - sSystem.m_vPosition[ iPoint1 ];
+		vec3 vD21 = -vD12;
+		float fSpring = SPRING_K * (length( vD12 ) - sSystem.m_fRestLength[ s ]);
+		vec3 vF12 = fSpring * normalize( vD12 );
+		vec3 vF21 = fSpring * normalize( vD21 );
+
+		sSystem.m_vForce[ iPoint1 ] += vF12 - (sSystem.m_vVelocity[ iPoint1 ] * DAMPING_COEFF);
+		sSystem.m_vForce[ iPoint2 ] += vF21 - (sSystem.m_vVelocity[ iPoint2 ] * DAMPING_COEFF);
+	}
+}
+
+// Runs a kernel over every spring; the scalar result is left in the force array.
+static void runKernel( BenchSystem& sSystem, SpringForceKernel pKernel )
+{
+	pKernel( sSystem.m_iMass1.data(), sSystem.m_iMass2.data(), sSystem.m_fRestLength.data(),
+			 0, sSystem.m_fRestLength.size(), sSystem.m_vPosition.data(), sSystem.m_vForce.data(), SPRING_K );
+}
+
+// Average time of one pass in nanoseconds per spring
+template< typename Pass >
+static double timePass( BenchSystem& sSystem, int iIterations, Pass pPass )
+{
+	pPass();	// warm up
+
+	chrono::high_resolution_clock::time_point tStart = chrono::high_resolution_clock::now();
+	for ( int i = 0; i < iIterations; ++i )
+		pPass();
+	chrono::duration< double, nano > tElapsed = chrono::high_resolution_clock::now() - tStart;
+
+	return tElapsed.count() / ((double)iIterations * sSystem.m_fRestLength.size());
+}
+
+int main( int argc, char* argv[] )
+{
+	int iSize = (argc > 1) ? atoi( argv[ 1 ] ) : DEFAULT_SIZE;
+	int iIterations = (argc > 2) ? atoi( argv[ 2 ] ) : DEFAULT_ITERATIONS;
+	BenchSystem sSystem;
+	bool bPassed = true;
+
+	if ( iSize < 2 || iIterations < 1 )
+	{
+		printf( "Usage: bench_kernels [size >= 2] [iterations >= 1]\n" );
+		return 1;
+	}
+
+	buildCube( sSystem, iSize );
+	unsigned int iNumMasses = sSystem.m_vPosition.size();
+	unsigned int iNumSprings = sSystem.m_fRestLength.size();
+	printf( "%d^3 cube: %u masses, %u springs, %d iterations\n", iSize, iNumMasses, iNumSprings, iIterations );
+
+	// Reference forces and the tolerance scale of each mass: k * longest attached spring
+	vector< float > fScale( iNumMasses, 0.0f );
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		float fLength = SPRING_K * length( sSystem.m_vPosition[ sSystem.m_iMass2[ s ] ] - sSystem.m_vPosition[ sSystem.m_iMass1[ s ] ] );
+		fScale[ sSystem.m_iMass1[ s ] ] = fmax( fScale[ sSystem.m_iMass1[ s ] ], fLength );
+		fScale[ sSystem.m_iMass2[ s ] ] = fmax( fScale[ sSystem.m_iMass2[ s ] ], fLength );
+	}
+
+	sSystem.m_vForce.assign( iNumMasses, vec3( 0.0f ) );
+	runKernel( sSystem, SpringKernels::accumulateScalar );
+	aligned_vector< vec3 > vReference( sSystem.m_vForce );
+
+	double fOriginal = timePass( sSystem, iIterations, [ &sSystem ]() { accumulateOriginal( sSystem ); } );
+	printf( "%-10s %8.3f ns/spring\n", "original", fOriginal );
+
+	for ( int k = 0; k < SpringKernels::MAX_KERNELS; ++k )
+	{
+		SpringKernels::eKernelType eType = (SpringKernels::eKernelType)k;
+
+		if ( !SpringKernels::isSupported( eType ) )
+		{
+			printf( "%-10s not supported on this CPU\n", SpringKernels::getName( eType ) );
+			continue;
+		}
+
+		SpringForceKernel pKernel = SpringKernels::getKernel( eType );
+		float fMaxError = 0.0f;
+
+		// Accuracy against the scalar kernel
+		sSystem.m_vForce.assign( iNumMasses, vec3( 0.0f ) );
+		runKernel( sSystem, pKernel );
+		for ( unsigned int m = 0; m < iNumMasses; ++m )
+		{
+			vec3 vError = abs( sSystem.m_vForce[ m ] - vReference[ m ] ) / fScale[ m ];
+			fMaxError = fmax( fMaxError, fmax( vError.x, fmax( vError.y, vError.z ) ) );
+		}
+		bPassed &= (fMaxError <= SPRING_KERNEL_TOLERANCE);
+
+		double fTime = timePass( sSystem, iIterations, [ &sSystem, pKernel ]() { runKernel( sSystem, pKernel ); } );
+		printf( "%-10s %8.3f ns/spring  %5.2fx original  max error %.2e (%s)\n", SpringKernels::getName( eType ),
+				fTime, fOriginal / fTime, fMaxError, (fMaxError <= SPRING_KERNEL_TOLERANCE) ? "ok" : "FAILED" );
+	}
+
+	return bPassed ? 0 : 1;
+}
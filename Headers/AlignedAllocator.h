@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#define CACHE_LINE_SIZE 64
+
+//////////////////////////////////////////////////////////////////
+// Name: AlignedAllocator.h
+// Class: STL Allocator that aligns the start of every allocation to a
+//			given boundary (default: a cache line).  Used for the large
+//			simulation arrays so they can be streamed and vectorized.
+//////////////////////////////////
+template< typename T, size_t ALIGNMENT = CACHE_LINE_SIZE >
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template< typename U >
+	struct rebind { typedef AlignedAllocator< U, ALIGNMENT > other; };
+
+	AlignedAllocator() { }
+	template< typename U >
+	AlignedAllocator( const AlignedAllocator< U, ALIGNMENT >& pCopy ) { }
+
+	// Allocate an aligned block large enough for iCount elements.
+	T* allocate( size_t iCount )
+	{
+		void* pReturn = nullptr;
+
+		if ( iCount > 0 )
+		{
+#ifdef _WIN32
+			pReturn = _aligned_malloc( iCount * sizeof( T ), ALIGNMENT );
+#else
+			if ( 0 != posix_memalign( &pReturn, ALIGNMENT, iCount * sizeof( T ) ) )
+				pReturn = nullptr;
+#endif
+			if ( nullptr == pReturn )
+				throw std::bad_alloc();
+		}
+
+		return static_cast< T* >( pReturn );
+	}
+
+	// Release a block previously returned by allocate.
+	void deallocate( T* pBlock, size_t iCount )
+	{
+#ifdef _WIN32
+		_aligned_free( pBlock );
+#else
+		free( pBlock );
+#endif
+	}
+
+	bool operator==( const AlignedAllocator& pRHS ) const { return true; }
+	bool operator!=( const AlignedAllocator& pRHS ) const { return false; }
+};
+
+// Short-hand for a cache-line aligned vector.
+template< typename T >
+using aligned_vector = std::vector< T, AlignedAllocator< T > >;
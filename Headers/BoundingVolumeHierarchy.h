@@ -0,0 +1,150 @@
+#pragma once
+#include "stdafx.h"
+
+#define BVH_MAX_DEPTH 64		// Traversal stack size, the median split keeps the depth near log2(items)
+#define BVH_EPSILON 1e-4f		// Overlap slack, so flat boxes (planes) and rays along a face aren't missed
+
+//////////////////////////////////////////////////////////////////
+// Name: BoundingVolumeHierarchy.h
+// Class: Axis aligned bounding box tree over a set of items (scene objects, planes) used as the collision
+//			broadphase.  Items are identified by their index in the box arrays given to build().  The tree
+//			is built with median splits along the longest axis and can be refit in place when items move.
+//			Queries only read the tree, so they can run from several threads at once.
+//////////////////////////////////
+class BoundingVolumeHierarchy
+{
+public:
+	BoundingVolumeHierarchy() {}
+
+	// Builds the tree over the boxes vMin[i]..vMax[i]
+	void build( const vector< vec3 >& vMin, const vector< vec3 >& vMax );
+
+	// Updates the boxes of the same items without rebuilding the tree (items moved, none added or removed)
+	void refit( const vector< vec3 >& vMin, const vector< vec3 >& vMax );
+
+	// Calls fVisit( index ) for every item whose box overlaps vMin..vMax
+	template< typename Visit >
+	void query( const vec3& vMin, const vec3& vMax, Visit fVisit ) const;
+
+	// Distance from vPos to the closest box of an item fAccept( index ) is true for, FLT_MAX without any
+	template< typename Accept >
+	float getDistance( const vec3& vPos, Accept fAccept ) const;
+
+	unsigned int size() const { return m_iItems.size(); }
+	void clear() { m_vNodes.clear(); m_iItems.clear(); m_vItemMin.clear(); m_vItemMax.clear(); }
+
+	// Box swept by a ray from vStart to vStart + vRay
+	static void getRayBounds( const vec3& vStart, const vec3& vRay, vec3& vMin, vec3& vMax )
+	{
+		vMin = min( vStart, vStart + vRay );
+		vMax = max( vStart, vStart + vRay );
+	}
+
+	// Box swept by every ray of a batch
+	static void getRayBounds( const vec3* pStart, const vec3* pRay, unsigned int iCount, vec3& vMin, vec3& vMax )
+	{
+		vec3 vRayMin, vRayMax;
+
+		vMin = vec3( FLT_MAX );
+		vMax = vec3( -FLT_MAX );
+		for ( unsigned int i = 0; i < iCount; ++i )
+		{
+			getRayBounds( pStart[ i ], pRay[ i ], vRayMin, vRayMax );
+			vMin = min( vMin, vRayMin );
+			vMax = max( vMax, vRayMax );
+		}
+	}
+
+private:
+	// Nodes are stored depth first: the left child directly follows its parent.
+	struct Node
+	{
+		vec3 vMin, vMax;
+		unsigned int iFirst, iCount;	// Leaf: range in m_iItems
+		unsigned int iRight;			// Inner (iCount == 0): index of the right child
+	};
+
+	vector< Node > m_vNodes;
+	vector< unsigned int > m_iItems;
+	vector< vec3 > m_vItemMin, m_vItemMax;	// Box of each item, for the distance to a single item of a leaf
+
+	unsigned int buildNode( const vector< vec3 >& vMin, const vector< vec3 >& vMax, unsigned int iFirst, unsigned int iCount, unsigned int iDepth );
+	static bool overlaps( const Node& sNode, const vec3& vMin, const vec3& vMax )
+	{
+		return sNode.vMin.x <= vMax.x + BVH_EPSILON && sNode.vMax.x + BVH_EPSILON >= vMin.x
+			&& sNode.vMin.y <= vMax.y + BVH_EPSILON && sNode.vMax.y + BVH_EPSILON >= vMin.y
+			&& sNode.vMin.z <= vMax.z + BVH_EPSILON && sNode.vMax.z + BVH_EPSILON >= vMin.z;
+	}
+	static float getDistance2( const vec3& vPos, const vec3& vMin, const vec3& vMax )
+	{
+		vec3 vOutside = max( max( vMin - vPos, vPos - vMax ), vec3( 0.0f ) );
+		return dot( vOutside, vOutside );
+	}
+};
+
+// Iterative traversal with a fixed stack so queries don't allocate.
+template< typename Visit >
+void BoundingVolumeHierarchy::query( const vec3& vMin, const vec3& vMax, Visit fVisit ) const
+{
+	unsigned int iStack[ BVH_MAX_DEPTH ];
+	unsigned int iTop = 0;
+
+	if ( !m_vNodes.empty() )
+		iStack[ iTop++ ] = 0;
+
+	while ( iTop > 0 )
+	{
+		const Node& sNode = m_vNodes[ iStack[ --iTop ] ];
+
+		if ( !overlaps( sNode, vMin, vMax ) )
+			continue;
+
+		if ( sNode.iCount > 0 )
+		{
+			for ( unsigned int i = sNode.iFirst; i < sNode.iFirst + sNode.iCount; ++i )
+				fVisit( m_iItems[ i ] );
+		}
+		else
+		{
+			iStack[ iTop++ ] = sNode.iRight;
+			iStack[ iTop++ ] = (unsigned int)(&sNode - m_vNodes.data()) + 1;
+		}
+	}
+}
+
+// Same traversal as query, skipping the nodes further away than the closest box found so far.  The distance
+//	is taken BVH_EPSILON closer, like the overlap test.
+template< typename Accept >
+float BoundingVolumeHierarchy::getDistance( const vec3& vPos, Accept fAccept ) const
+{
+	unsigned int iStack[ BVH_MAX_DEPTH ];
+	unsigned int iTop = 0;
+	float fClosest2 = FLT_MAX;
+
+	if ( !m_vNodes.empty() )
+		iStack[ iTop++ ] = 0;
+
+	while ( iTop > 0 )
+	{
+		const Node& sNode = m_vNodes[ iStack[ --iTop ] ];
+
+		if ( getDistance2( vPos, sNode.vMin, sNode.vMax ) >= fClosest2 )
+			continue;
+
+		if ( sNode.iCount > 0 )
+		{
+			for ( unsigned int i = sNode.iFirst; i < sNode.iFirst + sNode.iCount; ++i )
+			{
+				if ( fAccept( m_iItems[ i ] ) )
+					fClosest2 = std::min( fClosest2, getDistance2( vPos, m_vItemMin[ m_iItems[ i ] ], m_vItemMax[ m_iItems[ i ] ] ) );
+			}
+		}
+		else
+		{
+			iStack[ iTop++ ] = sNode.iRight;
+			iStack[ iTop++ ] = (unsigned int)(&sNode - m_vNodes.data()) + 1;
+		}
+	}
+
+	return (FLT_MAX == fClosest2) ? FLT_MAX : std::max( sqrt( fClosest2 ) - BVH_EPSILON, 0.0f );
+}
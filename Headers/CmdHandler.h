@@ -49,6 +49,10 @@ private:
 	bool exec_SetThreshold();
 	bool exec_SetThresholdMin();
 	bool exec_SetThresholdMax();
+	bool exec_SetThreads();
+	bool exec_SetSimRate();
+	bool exec_Snapshot( bool bRestore );
+	bool exec_Record();
 	void outputHelpList();
 
 	bool checkRange(float fVal, float fMIN, float fMAX);
@@ -76,6 +80,12 @@ private:
 		SET_THRESHOLD,
 		SET_MIN_THRESHOLD,
 		SET_MAX_THRESHOLD,
+		SET_THREADS,
+		SET_SIM_RATE,
+		SAVE_SNAPSHOT,
+		RESTORE_SNAPSHOT,
+		RECORD,
+		STOP_RECORD,
 		NUM_CMDS
 	};
 
@@ -0,0 +1,50 @@
+#pragma once
+#include "stdafx.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: CollisionEnvironment.h
+// Class: Interface for whatever a MassSpringSystem collides against.  The Environment Manager
+//			answers with the objects of the loaded scene; the headless runner with the planes
+//			of its scene file, without any of the rendering behind them.
+//////////////////////////////////
+class CollisionEnvironment
+{
+public:
+	virtual ~CollisionEnvironment() {}
+
+	// Casts vRay from vPos against every object.  Returns the distance along the normalized ray to the
+	//	closest intersection (FLT_MAX if there is none) and sets vIntersectingNormal to its normal.
+	virtual float checkCollision( const vec3& vPos, const vec3& vRay, vec3& vIntersectingNormal ) = 0;
+
+	// Batched checkCollision: casts pRay[i] from pPos[i] for every i < iCount and sets pT[i] and pNormal[i]
+	//	(pNormal[i] is left as is without a hit), and pObject[i] to a key of the object that was hit, which
+	//	stays the same for as long as the object exists.  Environments override it to test each object
+	//	against the whole batch at once instead of once per ray; the default can't tell objects apart and
+	//	reports every hit as object 0.
+	virtual void checkCollisions( const vec3* pPos, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+								  unsigned int* pObject )
+	{
+		for ( unsigned int i = 0; i < iCount; ++i )
+		{
+			pT[ i ] = checkCollision( pPos[ i ], pRay[ i ], pNormal[ i ] );
+			pObject[ i ] = 0;
+		}
+	}
+
+	// Distance from vPos to the bounds of the closest object, leaving out the objects keyed by
+	//	pIgnore[0..iIgnoreCount).  Until a point has moved that far, no ray from it can hit one of the
+	//	other objects, so it doesn't need to be cast.  The default of 0 casts every ray.
+	virtual float getClearance( const vec3& vPos, const unsigned int* pIgnore, unsigned int iIgnoreCount ) { return 0.0f; }
+
+	// Counts the times the objects have moved, been added or removed; sleeping masses measure their clearance
+	//	again when it changes.  Static environments keep the default.
+	virtual unsigned int getChangeCount() const { return 0; }
+
+	// Box around the bounds, before and after, of every object that moved, was added or was removed by the
+	//	last change counted.  Sleeping masses further than they can wake from it are left alone.  The default
+	//	can't tell and covers everything.
+	virtual void getChangedBounds( vec3& vMin, vec3& vMax ) const { vMin = vec3( -FLT_MAX ); vMax = vec3( FLT_MAX ); }
+
+	// False once the object keyed iObject has been removed; contacts with it no longer hold anything up.
+	virtual bool hasObject( unsigned int iObject ) const { return true; }
+};
@@ -3,19 +3,24 @@
 #include "Object3D.h"
 #include "Light.h"
 #include "MassSpringSystem.h"
+#include "MassSpringRenderer.h"
+#include "CollisionEnvironment.h"
+#include "BoundingVolumeHierarchy.h"
+#include "SimulationThread.h"
+#include "TrajectoryRecorder.h"
 
 // Environment Manager
 // Manages all 3D objects in an environment
 // Written by: James Cot�
-class EnvironmentManager
+class EnvironmentManager : public CollisionEnvironment
 {
 public:
 	static EnvironmentManager* getInstance();
 	~EnvironmentManager();
 
 	void initializeEnvironment(string sFileName);
-	void initializeMassSpringSystem(vector< string > sData, int iLength);
-	void pause() { m_bPause = !m_bPause; }
+	void addMassSpringSystem(vector< string > sData, int iLength);
+	void pause();
 
 	// Clears the Environment so a new one can be loaded.
 	void purgeEnvironment();
@@ -23,7 +28,13 @@ public:
 	void killLight( long lID );
 	void listEnvironment();
 	void renderEnvironment( const vec3& vCamLookAt );
-	float checkCollision( const vec3& vPos, const vec3& vRay, vec3& vIntersectingNormal);
+	float checkCollision( const vec3& vPos, const vec3& vRay, vec3& vIntersectingNormal );
+	void checkCollisions( const vec3* pPos, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						  unsigned int* pObject );
+	float getClearance( const vec3& vPos, const unsigned int* pIgnore, unsigned int iIgnoreCount );
+	unsigned int getChangeCount() const { return m_iColliderChanges; }
+	void getChangedBounds( vec3& vMin, vec3& vMax ) const { vMin = m_vChangedMin; vMax = m_vChangedMax; }
+	bool hasObject( unsigned int iObject ) const;
 
 	// Texture Manipulation
 	void switchTexture( const string* sTexLocation, long lObjID );
@@ -35,6 +46,12 @@ public:
 	// Get Camera Look At if Focus
 	vec3 getLookAt();
 	void updateMassSpring();
+	void setMassSpringThreads( int iNumThreads );
+	void setSimulationRate( float fRate );
+	void saveMassSpring( const string& sFileName );
+	void restoreMassSpring( const string& sFileName );
+	void recordMassSpring( const string& sFileName );
+	void stopRecording();
 
 	// Edge Threshold Getters/Setters
 	void setMinThreshold( float fMin ) { m_fMinEdgeThreshold = fMin; }
@@ -51,7 +68,29 @@ private:
 	vector<Object3D*>	m_pObjects;
 	vector<Light*>		m_pLights;
 	Object* getObject( long lID );
-	MassSpringSystem* m_pSpringSystem;
+	vector< MassSpringSystem* > m_pSpringSystems;		// Every mass_spring block of the scene
+	vector< MassSpringRenderer* > m_pSpringRenderers;	// One per system, same order
+
+	// Simulation Thread: steps the systems and the animated objects at a fixed rate while the renderers
+	//	draw their published positions and frames.  m_mSimulation is held for every frame stepped; the
+	//	objects and the broadphase only change while holding it.
+	SimulationThread m_sSimThread;
+	mutex m_mSimulation;
+	void stepMassSpring();
+	void animateObjects();
+
+	// Trajectory Recording: one recorder per system while recording, same order
+	vector< TrajectoryRecorder* > m_pRecorders;
+
+	// Collision Broadphase over every object with bounds, rebuilt when objects are added or removed
+	//	and refit when any of them follows an Animation Track.
+	BoundingVolumeHierarchy m_sCollisionBVH;
+	vector< Object3D* > m_pColliders;
+	vector< vec3 > m_vColliderMin, m_vColliderMax;
+	bool m_bCollidersDirty, m_bCollidersAnimated;
+	unsigned int m_iColliderChanges;		// Builds, and refits that moved an object
+	vec3 m_vChangedMin, m_vChangedMax;		// Around what the last of them changed
+	void updateColliders();
 
 	// Edge Threshold Implementation
 	float m_fMinEdgeThreshold, m_fMaxEdgeThreshold;
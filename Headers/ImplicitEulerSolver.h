@@ -0,0 +1,56 @@
+#pragma once
+#include "stdafx.h"
+#include "AlignedAllocator.h"
+
+class MassSpringSystem;
+
+//////////////////////////////////////////////////////////////////
+// Name: ImplicitEulerSolver.h
+// Class: Backward Euler step for a MassSpringSystem (Baraff & Witkin, linearized):
+//			(M + h*C - h^2*K) dv = h * (f + h*K*v)
+//			solved with a Jacobi preconditioned conjugate gradient.  The matrix is never
+//			assembled; each product gathers the spring Jacobians around every mass.
+//////////////////////////////////
+class ImplicitEulerSolver
+{
+public:
+	ImplicitEulerSolver( MassSpringSystem* pSystem );
+	~ImplicitEulerSolver();
+
+	// Builds the per-mass spring adjacency; call whenever the topology changes.
+	void initialize();
+
+	// Advances the system by fDeltaT with one linear solve.
+	void step( float fDeltaT );
+
+	// Solver Settings
+	void setMaxIterations( unsigned int iMaxIterations ) { m_iMaxIterations = iMaxIterations; }
+	void setTolerance( float fTolerance ) { m_fTolerance = fTolerance; }
+	unsigned int getMaxIterations() const { return m_iMaxIterations; }
+	float getTolerance() const { return m_fTolerance; }
+	unsigned int getLastIterations() const { return m_iLastIterations; }
+
+	// Velocity change of the last solve, the next solve starts from it.  Saved with snapshots.
+	aligned_vector< vec3 >& getDeltaV() { return m_vDeltaV; }
+
+private:
+	MassSpringSystem* m_pSystem;
+	unsigned int m_iMaxIterations, m_iLastIterations;
+	float m_fTolerance;
+
+	// Per Spring: elastic force on its first mass and stiffness block -df/dx (clamped to be positive semi-definite)
+	aligned_vector< vec3 > m_vSpringForce;
+	aligned_vector< mat3 > m_mSpringStiffness;
+
+	// Per Mass solver vectors
+	aligned_vector< vec3 > m_vDeltaV, m_vResidual, m_vDirection, m_vProduct, m_vPreconditioner, m_vPrecResidual;
+	vector< double > m_vBlockSums;		// Partial sums of the dot products of deterministic systems
+
+	void computeSprings( int iNumThreads );
+	void assembleForces( float fDeltaT, int iNumThreads );
+	void multiply( const vec3* pIn, vec3* pOut, float fDeltaT, int iNumThreads );
+	void applyStiffness( unsigned int iMass, const vec3* pIn, vec3& vOut ) const;
+	float getMassDamping( unsigned int iMass, float fDeltaT ) const;
+	float solve( float fDeltaT, int iNumThreads );
+	double dotProduct( const vec3* pA, const vec3* pB, int iCount, int iNumThreads );
+};
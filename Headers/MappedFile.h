@@ -0,0 +1,32 @@
+#pragma once
+#include "stdafx.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: MappedFile.h
+// Class: Read-only memory mapping of a whole file, unmapped when the object goes away.
+//			The file's contents are paged in as they're read, no copy is made up front.
+//////////////////////////////////
+class MappedFile
+{
+public:
+	MappedFile( const string& sFileName );
+	~MappedFile();
+
+	// nullptr if the file couldn't be opened or mapped (or is empty)
+	const char* getData() const { return m_pData; }
+	size_t getSize() const { return m_iSize; }
+	bool isOpen() const { return nullptr != m_pData; }
+
+private:
+	MappedFile( const MappedFile& sCopy );
+	MappedFile& operator=( const MappedFile& sCopy );
+
+	const char* m_pData;
+	size_t m_iSize;
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_iFile;
+#endif
+};
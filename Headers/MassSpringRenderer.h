@@ -0,0 +1,40 @@
+#pragma once
+#include "stdafx.h"
+#include "ShaderManager.h"
+
+class MassSpringSystem;
+
+//////////////////////////////////////////////////////////////////
+// Name: MassSpringRenderer.h
+// Class: Draws a MassSpringSystem: the masses as points and the springs as lines.  Owns every
+//			GL handle so the system itself can be stepped without a GL context.
+//			The springs are uploaded once as an index buffer over the masses; only the
+//			positions are streamed every frame, into a ring of RING_FRAMES regions of one
+//			buffer so the GPU can still be drawing the previous frames while the next is written.
+//////////////////////////////////
+class MassSpringRenderer
+{
+public:
+	MassSpringRenderer( const MassSpringSystem* pSystem );
+	~MassSpringRenderer();
+
+	// Uploads the system's latest published positions and draws them
+	void draw( const vec3& vCamLookAt );
+
+private:
+	static const unsigned int RING_FRAMES = 3;
+
+	const MassSpringSystem* m_pSystem;
+	ShaderManager* m_pShdrMngr;
+	GLuint m_iVertexArray, m_iVertexBuffer, m_iIndicesBuffer;
+	unsigned int m_iNumMasses, m_iNumIndices;
+
+	// Position Ring: with persistent mapping the buffer stays mapped at m_pMapped and each region is
+	//	fenced until the GPU is done drawing from it.  Otherwise the buffer is orphaned every frame.
+	bool m_bPersistent;
+	void* m_pMapped;
+	GLsync m_pFences[ RING_FRAMES ];
+	unsigned int m_iRingFrame;
+
+	unsigned int uploadPositions();
+};
@@ -1,6 +1,17 @@
 #pragma once
 #include "stdafx.h"
-#include "ShaderManager.h"
+#include "CollisionEnvironment.h"
+#include "AlignedAllocator.h"
+#include "SpringKernels.h"
+#include "ImplicitEulerSolver.h"
+#include "XPBDSolver.h"
+#include "ProjectiveDynamicsSolver.h"
+#include "SelfCollision.h"
+#include "TripleBuffer.h"
+
+#define MAX_SPRING_COLORS 64		// Colors tracked per mass (bits in a 64-bit mask)
+#define SERIAL_SPRING_COLOR MAX_SPRING_COLORS	// Bucket for springs that couldn't be colored
+#define MAX_MASS_CONTACTS 4			// Contacts kept per mass, a mass touches a few objects at once at most
 
 enum SpringType
 {
@@ -12,22 +23,94 @@ enum SpringType
 	MAX_TYPES
 };
 
+// Optional ordering applied to the masses and springs after the lattice is built.
+enum MassOrdering
+{
+	ORDER_LATTICE = 0,	// x-major order the lattice is generated in
+	ORDER_MORTON,		// Z-order curve over the lattice coordinates
+	ORDER_BFS,			// Breadth-first over the spring graph from the first mass
+	MAX_ORDERINGS
+};
+
+// Time integration scheme used by update()
+enum IntegratorType
+{
+	EXPLICIT_EULER = 0,	// Semi-implicit (symplectic) Euler, needs a small delta_t to stay stable
+	IMPLICIT_EULER,		// Backward Euler with a conjugate gradient solve per step
+	XPBD,				// Position based: springs and collisions as constraints
+	PROJECTIVE_DYNAMICS,	// Local spring projections and a prefactored global solve
+	MAX_INTEGRATORS
+};
 
 class MassSpringSystem
 {
+	friend class ImplicitEulerSolver;
+	friend class XPBDSolver;
+	friend class ProjectiveDynamicsSolver;
+	friend class SelfCollision;
+	friend class MassSpringRenderer;
+
 public:
 	MassSpringSystem( float fK, float fRestLength, float fMass,
 					  float fDamp_Coeff, float fDelta_T, unsigned int iLoopCount,
 					  float fCollision_K, float fCollision_Damp );
 	~MassSpringSystem();
 
-	// Overridden intersect function
-	void draw( const vec3& vCamLookAt, bool m_bPause );
+	// Builds a system from the parameters of a scene file's mass_spring block (see scene2.txt).
+	//	Returns nullptr if there aren't enough of them.
+	static MassSpringSystem* createFromScene( const vector< string >& sData );
+
 	void update();
 
+	// Updates every system of a scene by a frame, spread over a team of threads (see the source)
+	static void updateSystems( const vector< MassSpringSystem* >& pSystems );
+
 	const vec3& getCenter();
 
 	void initialize( int iLength, int iHeight, int iDepth, SpringType eType );
+	bool setOption( const string& sName, const string& sValue );
+
+	// Collision: every mass is tested against pEnvironment's objects, nullptr for none
+	void setEnvironment( CollisionEnvironment* pEnvironment ) { m_pEnvironment = pEnvironment; }
+
+	// State
+	unsigned int getNumMasses() const { return m_sMasses.size(); }
+	unsigned int getNumSprings() const { return m_sSprings.size(); }
+	const aligned_vector< vec3 >& getPositions() const { return m_sMasses.m_vPosition; }
+	const aligned_vector< vec3 >& getVelocities() const { return m_sMasses.m_vVelocity; }
+	unsigned long long getStepCount() const { return m_iStepCount; }	// Substeps taken since initialize
+
+	// Published Positions: a copy of the positions made by publishPositions between updates, for a
+	//	thread that draws the system while another updates it.  Only one thread may read them.
+	void publishPositions();
+	const aligned_vector< vec3 >& getPublishedPositions() const { return m_sPublished.acquire(); }
+
+	// Snapshots: the complete state of the system (parameters, topology, masses, contacts, sleeping islands
+	//	and the solver's warm start) in a versioned binary file, so a settled system can be picked up again
+	//	without simulating it from initialize.  Restoring replaces the system's state; its thread count,
+	//	spring kernel and environment are kept.  Both return false on failure, leaving the system as it was.
+	bool saveSnapshot( const string& sFileName );
+	bool loadSnapshot( const string& sFileName );
+
+	// File of system iSystem of a scene's snapshot: sFileName for the first, sFileName.1, .2, ... for the rest
+	static string getSnapshotName( const string& sFileName, unsigned int iSystem )
+	{ return (0 == iSystem) ? sFileName : sFileName + "." + to_string( iSystem ); }
+
+	// Threading
+	void setThreadCount( int iNumThreads );
+	int getThreadCount() const { return m_iNumThreads; }
+
+	// Deterministic: every update gives bitwise the same result for any thread count, at some cost (see the
+	//	deterministic option)
+	bool isDeterministic() const { return m_bDeterministic; }
+
+	// Spring Force Kernel
+	bool setKernel( SpringKernels::eKernelType eType );
+	SpringKernels::eKernelType getKernel() const { return m_eKernel; }
+
+	// Sleeping: wakes every island at the start of the next update, e.g. after moving masses by hand
+	void wake();
+	unsigned int getNumActiveMasses() const { return m_vActiveMasses.size(); }
 	
 private:
 	// Only Accessable by Object Factory
@@ -35,71 +118,341 @@ private:
 	float m_fK, m_fRestLength, m_fMass;
 	float m_fDeltaT, m_fDamping_Coeff, m_fCollisionK, m_fCollisionDamp;
 	unsigned int m_iLoopCount;
-	ShaderManager* m_vShdrMngr;
-	GLuint m_iVertexArray, m_iVertexBuffer, m_iIndicesBuffer, m_iNormalBuffer;
+	MassOrdering m_eOrdering;
+	vec3 m_vStartPos;
+	int m_iNumThreads;
+	bool m_bDeterministic;
+	SpringKernels::eKernelType m_eKernel;
+	SpringForceKernel m_pSpringKernel;
+	IntegratorType m_eIntegrator;
+	ImplicitEulerSolver* m_pImplicitSolver;
+	XPBDSolver* m_pXPBDSolver;
+	ProjectiveDynamicsSolver* m_pProjectiveSolver;
+	SelfCollision* m_pSelfCollision;
+	bool m_bSelfCollision;
+	CollisionEnvironment* m_pEnvironment;
+	unsigned long long m_iStepCount;
 	vec3 m_vCenter;
+	mutable TripleBuffer< aligned_vector< vec3 > > m_sPublished;	// Reader side swaps slots, even from const accessors
+
+	// Flags stored per Point Mass
+	enum eMassFlags
+	{
+		MASS_FIXED = 1 << 0,
+		MASS_COLLIDING = 1 << 1,
+		MASS_SLEEPING = 1 << 2
+	};
 
 	// Point Mass Data Structure
-	struct PointMass
+	//	Structure of Arrays: every attribute of the masses is stored in its own contiguous,
+	//	cache-line aligned array so the integration loop streams through memory in order.
+	struct PointMasses
 	{
-		// Private PointMass Variables
-		float m_fMass;
-		vec3 m_vPosition, m_vVelocity, m_vForce;
-		vec3 m_vCollisionIntersection, m_vCollisionNormal;
-		bool m_bColliding;
-		bool m_bFixed;
-
-		// Constructors (Default, Copy, equal Operator)
-		PointMass(float fMass, const vec3& vPos, bool bFixed)
-			: m_fMass( fMass ), m_vPosition( vPos ), m_vVelocity( 0.0f ), m_vForce( 0.0f ), m_bFixed( bFixed ),
-				m_bColliding(false), m_vCollisionIntersection(0.0f), m_vCollisionNormal(0.0f)
-		{ }
-		PointMass( const PointMass* pCopy )
+		// Per-Mass Attributes, all indexed by the same mass index.
+		aligned_vector< vec3 > m_vPosition, m_vVelocity, m_vForce;
+		aligned_vector< float > m_fInvMass;
+		aligned_vector< unsigned char > m_iFlags;
+
+		// Number of masses stored
+		unsigned int size() const { return m_vPosition.size(); }
+		bool empty() const { return m_vPosition.empty(); }
+
+		// Flag Accessors
+		bool isFixed( unsigned int iIndex ) const { return 0 != (m_iFlags[ iIndex ] & MASS_FIXED); }
+		bool isColliding( unsigned int iIndex ) const { return 0 != (m_iFlags[ iIndex ] & MASS_COLLIDING); }
+		bool isSleeping( unsigned int iIndex ) const { return 0 != (m_iFlags[ iIndex ] & MASS_SLEEPING); }
+		void setFlag( unsigned int iIndex, eMassFlags eFlag, bool bValue )
+		{
+			if ( bValue )
+				m_iFlags[ iIndex ] |= eFlag;
+			else
+				m_iFlags[ iIndex ] &= ~eFlag;
+		}
+
+		// Pins a mass in place.  A fixed mass has no inverse mass, nothing can move it.
+		void fix( unsigned int iIndex )
 		{
-			*this = pCopy;
+			m_fInvMass[ iIndex ] = 0.0f;
+			m_iFlags[ iIndex ] |= MASS_FIXED;
 		}
-		PointMass* operator=( const PointMass* pCopy )
+
+		// Appends a new mass at rest and returns its index.
+		unsigned int add( float fMass, const vec3& vPos, bool bFixed )
 		{
-			this->m_fMass = pCopy->m_fMass;
-			this->m_vPosition = pCopy->m_vPosition;
-			this->m_vVelocity = pCopy->m_vVelocity;
-			this->m_vForce = pCopy->m_vForce;
-			this->m_bFixed = pCopy->m_bFixed;
+			m_vPosition.push_back( vPos );
+			m_vVelocity.push_back( vec3( 0.0f ) );
+			m_vForce.push_back( vec3( 0.0f ) );
+			m_fInvMass.push_back( bFixed ? 0.0f : 1.0f / fMass );
+			m_iFlags.push_back( bFixed ? MASS_FIXED : 0 );
 
-			return this;
+			return m_vPosition.size() - 1;
 		}
 
+		// Pre-allocate space for iCount masses
+		void reserve( unsigned int iCount )
+		{
+			m_vPosition.reserve( iCount );
+			m_vVelocity.reserve( iCount );
+			m_vForce.reserve( iCount );
+			m_fInvMass.reserve( iCount );
+			m_iFlags.reserve( iCount );
+		}
+
+		void clear()
+		{
+			m_vPosition.clear();
+			m_vVelocity.clear();
+			m_vForce.clear();
+			m_fInvMass.clear();
+			m_iFlags.clear();
+		}
 	};
 
 	// Spring Data Structure
-	struct Spring
+	//	Compressed topology: each spring is a pair of mass indices and a rest length,
+	//	stored in parallel contiguous arrays.
+	struct Springs
 	{
-		// Variables
-		PointMass *pPoint1, *pPoint2;
-		float m_fRestLength;
+		aligned_vector< unsigned int > m_iMass1, m_iMass2;
+		aligned_vector< float > m_fRestLength;
 
-		// Constructor
-		Spring( PointMass* pMass1, PointMass* pMass2 )
+		// Number of springs stored
+		unsigned int size() const { return m_fRestLength.size(); }
+		bool empty() const { return m_fRestLength.empty(); }
+
+		// Connects two masses with a spring at rest at their current distance.
+		void add( const PointMasses& sMasses, unsigned int iMass1, unsigned int iMass2 )
+		{
+			m_iMass1.push_back( iMass1 );
+			m_iMass2.push_back( iMass2 );
+			m_fRestLength.push_back( length( sMasses.m_vPosition[ iMass1 ] - sMasses.m_vPosition[ iMass2 ] ) );
+		}
+
+		// Copies spring iSpring of sSprings.
+		void add( const Springs& sSprings, unsigned int iSpring )
+		{
+			m_iMass1.push_back( sSprings.m_iMass1[ iSpring ] );
+			m_iMass2.push_back( sSprings.m_iMass2[ iSpring ] );
+			m_fRestLength.push_back( sSprings.m_fRestLength[ iSpring ] );
+		}
+
+		// Pre-allocate space for iCount springs
+		void reserve( unsigned int iCount )
 		{
-			pPoint1 = pMass1;
-			pPoint2 = pMass2;
-			m_fRestLength = length( pPoint1->m_vPosition - pPoint2->m_vPosition );
+			m_iMass1.reserve( iCount );
+			m_iMass2.reserve( iCount );
+			m_fRestLength.reserve( iCount );
 		}
-		
-		// Destructor -> clear pointers
-		~Spring()
+
+		void clear()
 		{
-			pPoint1 = pPoint2 = nullptr;
+			m_iMass1.clear();
+			m_iMass2.clear();
+			m_fRestLength.clear();
 		}
 	};
 	
+	// Spring Adjacency
+	//	Compressed list of the springs around each mass: entries [m_vOffsets[m], m_vOffsets[m + 1])
+	//	of m_vSpring and m_vMass are the springs attached to mass m and the mass at their other end.
+	struct SpringAdjacency
+	{
+		vector< unsigned int > m_vOffsets, m_vSpring, m_vMass;
+
+		void build( const Springs& sSprings, unsigned int iNumMasses );
+		unsigned int getCount( unsigned int iMass ) const { return m_vOffsets[ iMass + 1 ] - m_vOffsets[ iMass ]; }
+	};
+
 	// Data Vectors
-	vector< Spring* > m_vSprings;
-	vector< PointMass* > m_vMasses;
-	vector< vec3 > m_vPositions, m_vNormals;
-	vector< int > m_vIndices;
+	Springs m_sSprings;
+	SpringAdjacency m_sAdjacency;	// Only built for the integrators that gather per mass and for self collision
+	PointMasses m_sMasses;
+
+	// Batched Collision Queries (explicit integrator): each thread gathers the masses of its range [iBegin, iEnd)
+	//	that look for a new collision into [iBegin, iBegin + count) of these arrays and queries them all at once.
+	struct CollisionQueries
+	{
+		aligned_vector< vec3 > m_vStart, m_vRay, m_vNormal;
+		aligned_vector< float > m_fT;
+		aligned_vector< unsigned int > m_iMass, m_iObject;
+
+		void resize( unsigned int iCount )
+		{
+			m_vStart.resize( iCount );
+			m_vRay.resize( iCount );
+			m_vNormal.resize( iCount );
+			m_fT.resize( iCount );
+			m_iMass.resize( iCount );
+			m_iObject.resize( iCount );
+		}
+	} m_sQueries;
+
+	// Contact Cache
+	//	Up to MAX_MASS_CONTACTS contacts per mass, at most one per object (keyed as the environment reports
+	//	them): the point where the mass hit the object and the unit normal there.  Contacts are kept across
+	//	substeps and frames until the mass leaves them.  Contact c of mass m is entry m * MAX_MASS_CONTACTS + c.
+	//	The clearance of a mass is the distance from m_vClearanceOrigin to the bounds of the closest object it
+	//	isn't touching, refreshed every frame; until the mass has moved that far none of its rays can reach a
+	//	new object, so it skips the collision queries.
+	struct ContactCache
+	{
+		aligned_vector< unsigned char > m_iCount;
+		aligned_vector< unsigned int > m_iObject;
+		aligned_vector< vec3 > m_vPoint, m_vNormal;
+		aligned_vector< vec3 > m_vClearanceOrigin;
+		aligned_vector< float > m_fClearance;
+
+		unsigned int getCount( unsigned int iMass ) const { return m_iCount[ iMass ]; }
+		unsigned int getEntry( unsigned int iMass, unsigned int iContact ) const { return iMass * MAX_MASS_CONTACTS + iContact; }
+
+		bool hasObject( unsigned int iMass, unsigned int iObject ) const
+		{
+			for ( unsigned int c = 0; c < m_iCount[ iMass ]; ++c )
+				if ( m_iObject[ getEntry( iMass, c ) ] == iObject )
+					return true;
+
+			return false;
+		}
+
+		// Appends a contact, a mass touching MAX_MASS_CONTACTS objects already ignores any more (returns false).
+		bool add( unsigned int iMass, unsigned int iObject, const vec3& vPoint, const vec3& vNormal )
+		{
+			bool bReturn = m_iCount[ iMass ] < MAX_MASS_CONTACTS;
+
+			if ( bReturn )
+			{
+				unsigned int iEntry = getEntry( iMass, m_iCount[ iMass ]++ );
+
+				m_iObject[ iEntry ] = iObject;
+				m_vPoint[ iEntry ] = vPoint;
+				m_vNormal[ iEntry ] = vNormal;
+			}
+
+			return bReturn;
+		}
+
+		// Removes a contact, keeping the others in order.  The mass has to look for new contacts again.
+		void remove( unsigned int iMass, unsigned int iContact )
+		{
+			for ( unsigned int c = iContact + 1; c < m_iCount[ iMass ]; ++c )
+			{
+				unsigned int iEntry = getEntry( iMass, c );
+
+				m_iObject[ iEntry - 1 ] = m_iObject[ iEntry ];
+				m_vPoint[ iEntry - 1 ] = m_vPoint[ iEntry ];
+				m_vNormal[ iEntry - 1 ] = m_vNormal[ iEntry ];
+			}
+			--m_iCount[ iMass ];
+			m_fClearance[ iMass ] = 0.0f;
+		}
+
+		// Empty cache for iCount masses
+		void resize( unsigned int iCount )
+		{
+			m_iCount.assign( iCount, 0 );
+			m_iObject.resize( iCount * MAX_MASS_CONTACTS );
+			m_vPoint.resize( iCount * MAX_MASS_CONTACTS );
+			m_vNormal.resize( iCount * MAX_MASS_CONTACTS );
+			m_vClearanceOrigin.resize( iCount );
+			m_fClearance.assign( iCount, 0.0f );
+		}
+	} m_sContacts;
 
 	// Checks Collision 
-	void checkCollision( PointMass& pMass );
+	unsigned int checkCollision( unsigned int iMass, const vec3& vContactRay, const vec3& vRay );
+	unsigned int resolveCollision( unsigned int iMass, const vec3& vContactRay, const vec3& vRay, float fT,
+								   unsigned int iObject, const vec3& vNormal );
+	bool needsQuery( unsigned int iMass, const vec3& vStart, const vec3& vRay ) const;
+	void updateClearance();
+	void applyMassForces( unsigned int iMass );
+	void integrateMassForces( unsigned int iMass, float fDeltaT );
+
+	// Position Based Contacts (XPBD and Projective Dynamics): vStart is the mass's position at the start of the step
+	bool findContact( unsigned int iMass, const vec3& vStart );
+	void updateContact( unsigned int iMass, const vec3& vStart );
+	bool projectContact( unsigned int iMass, const vec3& vStart );
+
+	// Rebuilds what the update derives from the masses and springs (damping, step bounds, islands, adjacency,
+	//	self collision and solver buffers) after initialize or a snapshot has set them.
+	void prepareUpdate();
+
+	// Snapshot Layout: a header then every array of the state, in a fixed order (see the source)
+	struct SnapshotHeader;
+	struct SnapshotSection
+	{
+		void* pData;
+		unsigned long long iBytes;
+	};
+	void getSnapshotSections( const SnapshotHeader& sHeader, SnapshotSection* pSections );
+	static const char* checkSnapshotArrays( const SnapshotHeader& sHeader, const char* pData );
+
+	// Locality Reordering
+	void reorderMasses( int iLength, int iHeight, int iDepth );
+	void applyMassOrder( const vector< unsigned int >& vNewToOld );
+	void permuteSprings( const vector< unsigned int >& vNewToOld );
+
+	// Sleeping Islands
+	//	Islands are the groups of masses connected by springs.  An island whose kinetic energy and change in
+	//	strain energy over a frame (both per unit of its free mass) stay under m_fSleepEnergy for m_iSleepFrames
+	//	frames goes to sleep: its masses stop and drop out of the active lists until an awake mass collides with
+	//	one of them, an object moves close to one of them or one they rest on moves, or wake() is called.  Each
+	//	sleeping island keeps the bounds of its masses, so only those near a change of the environment look at
+	//	it.  The explicit integrator puts islands to sleep one by one; the other integrators solve the whole
+	//	system at once, so it only sleeps once every island is quiet.
+	struct Islands
+	{
+		aligned_vector< unsigned int > m_iMassIsland;	// Island of each mass
+		vector< float > m_fMass, m_fKinetic, m_fStrain, m_fPrevStrain;
+		vector< unsigned int > m_iQuietFrames;
+		vector< unsigned char > m_bSleeping, m_bWake, m_bNearChange;
+		vector< vec3 > m_vMin, m_vMax;					// Bounds of the masses of each sleeping island
+
+		unsigned int size() const { return m_fMass.size(); }
+		void build( const Springs& sSprings, const PointMasses& sMasses );
+		void fit( const PointMasses& sMasses );
+	} m_sIslands;
+	bool m_bSleep;
+	float m_fSleepEnergy;
+	unsigned int m_iSleepFrames, m_iEnvironmentChanges;	// Change count of the environment last looked at
+	void wakeIslands();
+	void sleepIslands();
+
+	// Active Set (explicit integrator): the free masses of the awake islands in mass order, and their springs
+	//	(except those between two fixed masses) by color.  Rebuilt whenever an island falls asleep or wakes.
+	aligned_vector< unsigned int > m_vActiveMasses;
+	Springs m_sActiveSprings;
+	vector< unsigned int > m_vActiveColorOffsets;
+	void buildActiveSet();
+
+	// Parallel Update
+	vector< unsigned int > m_vColorOffsets;	// Start of each spring color in the spring arrays (+ end)
+	aligned_vector< float > m_fMassDamping;	// Damping coefficient * number of springs on each mass
+	void colorSprings();
+	void computeMassDamping();
+	void accumulateSpringForces( unsigned int iBegin, unsigned int iEnd );
+	void integrateMasses( unsigned int iBegin, unsigned int iEnd, float fDeltaT );
+	void step( float fDeltaT );
+	void stepExplicit( unsigned int iSteps, float fDeltaT );
+
+	// Adaptive Substepping
+	bool m_bAdaptiveSteps;
+	float m_fStepTolerance, m_fFrameBudget;		// Position error per substep (fraction of the shortest spring), wall-clock ms per frame
+	float m_fAdaptiveDeltaT;					// Size of the next substep
+	float m_fStableDeltaT, m_fStableContactDeltaT, m_fMinRestLength;
+	unsigned int m_iStepLogFrames;
+	aligned_vector< vec3 > m_vStepVelocity;		// Velocities at the end of the previous substep
+
+	// Substep counts reported every m_iStepLogFrames frames
+	struct StepLog
+	{
+		unsigned int iFrames, iSteps, iMinSteps, iMaxSteps, iOverBudget;
+		float fMinDeltaT, fMaxDeltaT;
+	} m_sStepLog;
+
+	void computeStepBounds();
+	void updateAdaptive();
+	float estimateStep( float fDeltaT );
+	void logSteps( unsigned int iSteps, float fMinDeltaT, float fMaxDeltaT, bool bOverBudget );
+	void resetStepLog();
 };
 
@@ -2,6 +2,8 @@
 #include "stdafx.h"
 #include "TriMesh.h"
 #include "ShaderManager.h"
+#include "MeshBVH.h"
+#include "MeshSDF.h"
 
 //////////////////////////////////////////////////////////////////
 // Name: Mesh.h
@@ -21,6 +23,12 @@ public:
 	// Gets the file name, only the MeshManager can set this variable.
 	const string& getFileName() { return m_sFileName; }
 
+	// Collision BVH over the triangles in the mesh's own space, shared by every MeshObject of this file.
+	const MeshBVH* getBVH() const { return m_pBVH; }
+
+	// Optional signed distance field for constant cost collisions, nullptr unless requested through the MeshManager.
+	const MeshSDF* getSDF() const { return m_pSDF; }
+
 	void drawMesh( );
 
 private:
@@ -32,6 +40,9 @@ private:
 
 	// Private Methods
 	bool genMesh( const string& sFileName );
+	void buildBVH();
+	void buildSDF( unsigned int iResolution );
+	void getVertices( vector< vec3 >& vVertices ) const;
 
 	// Indices for Faces of Mesh and Additional Buffer Addresses on the GPU for
 	//	Indices and Normals
@@ -43,6 +54,8 @@ private:
 
 	// Mesh Object contains vertices, normals and indices of Mesh
 	trimesh::TriMesh* m_pMesh;
+	MeshBVH* m_pBVH;
+	MeshSDF* m_pSDF;
 
 	// Friend Class: Object_Factory to create Meshes.
 	friend class MeshManager;
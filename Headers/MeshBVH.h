@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+
+#define MESH_BVH_STACK_SIZE 64		// Traversal stack, the build stops splitting before the tree gets deeper
+
+//////////////////////////////////////////////////////////////////
+// Name: MeshBVH.h
+// Class: Bounding volume hierarchy over the triangles of a mesh for segment queries in the mesh's own
+//			space.  Built once per Mesh (MeshManager) and shared by every MeshObject using it.  Nodes take
+//			32 bytes (two per cache line) and triangles are stored in leaf order as a vertex and two
+//			edges, so a query streams through memory and tests triangles without touching the index list.
+//////////////////////////////////
+class MeshBVH
+{
+public:
+	// vVertices and iIndices (3 per triangle) as they're stored in the Mesh
+	MeshBVH( const vector< vec3 >& vVertices, const vector< unsigned int >& iIndices );
+
+	// Closest triangle hit by the segment vStart..vStart + vRay.  fT is the hit's fraction of vRay (0 to 1)
+	//	and vNormal the triangle's (unnormalized) normal.  Returns false without a hit.
+	bool intersect( const vec3& vStart, const vec3& vRay, float& fT, vec3& vNormal ) const;
+
+	// Bounding box of the whole mesh
+	void getBounds( vec3& vMin, vec3& vMax ) const;
+
+	unsigned int getNumTriangles() const { return m_vTriangles.size(); }
+	unsigned int getNumNodes() const { return m_vNodes.size(); }
+
+private:
+	// Nodes are stored depth first: the left child directly follows its parent.
+	struct Node
+	{
+		float fMin[ 3 ];
+		unsigned int iOffset;	// Leaf: first triangle, Inner: index of the right child
+		float fMax[ 3 ];
+		unsigned int iCount;	// Leaf: number of triangles, 0 for inner nodes
+	};
+
+	// Triangle as its first vertex and the two edges leaving it (Moller-Trumbore)
+	struct Triangle
+	{
+		vec3 vVertex, vEdge1, vEdge2;
+	};
+
+	vector< Node > m_vNodes;
+	vector< Triangle > m_vTriangles;
+
+	// Build data, only used while building
+	struct BuildTriangle
+	{
+		vec3 vMin, vMax, vCentroid;
+		unsigned int iIndex;
+	};
+
+	unsigned int buildNode( vector< BuildTriangle >& vBuild, unsigned int iFirst, unsigned int iCount, unsigned int iDepth );
+	float entryDistance( const Node& sNode, const vec3& vStart, const vec3& vInvRay, float fMaxT ) const;
+};
@@ -11,7 +11,7 @@ public:
 	~MeshManager();
 
 	// Methods:
-	Mesh* loadMesh( const string &sFileName, long lID );
+	Mesh* loadMesh( const string &sFileName, long lID, unsigned int iSDFResolution = 0 );
 	void unloadMesh( const string &sFileName, long lID );
 private:
 	// Singleton Implementation
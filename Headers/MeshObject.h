@@ -18,14 +18,17 @@ public:
 	void draw( const vec3& vCamLookAt, float fMinThreshold, float fMaxThreshold, bool m_bPause );
 	string getType() { return "MeshObject"; }
 	string getDebugOutput();
-	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal ) { return false; /*Not Implemented*/ }
+	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal );
+	bool getBounds( vec3& vMin, vec3& vMax );
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject );
 
 	mat4 getFreNetFrames();
 
 private:
 	// Private Constructor and Copy Constructor to restrict usage to Object_Factory
 	MeshObject( const glm::vec3* pPosition, const string* sFileName, long lID, 
-				const string* sTexName, const Anim_Track* pAnimTrack );
+				const string* sTexName, const Anim_Track* pAnimTrack, unsigned int iSDFResolution = 0 );
 	MeshObject( const MeshObject* pCopy );
 
 	// Indices for Faces of MeshObject and Additional Buffer Addresses on the GPU for
@@ -37,6 +40,11 @@ private:
 	// Inherited from Parent
 	void calculateUVs();
 
+	// Collision: rays are taken into the mesh's space with the inverse of the model matrix
+	mat4 getModelMatrix( const mat4& mFrame ) const;
+	bool intersect( const mat4& mInverse, const mat3& mNormalMatrix, const vec3& vStart, const vec3& vRay,
+					float& fT, vec3& vIntersectingNormal ) const;
+
 	// Friend Class: Object_Factory to create Meshes.
 	friend class Object_Factory;
 };
@@ -0,0 +1,55 @@
+#pragma once
+#include "stdafx.h"
+
+#define MESH_SDF_BRICK 8			// Cells per brick edge, bricks store (MESH_SDF_BRICK + 1)^3 samples
+#define MESH_SDF_BAND 4				// Narrow band half width in cells, distances are only stored this close to the surface
+#define MESH_SDF_BRICK_SAMPLES ((MESH_SDF_BRICK + 1) * (MESH_SDF_BRICK + 1) * (MESH_SDF_BRICK + 1))
+#define MESH_SDF_NO_BRICK -1		// Brick away from the surface, not stored
+
+//////////////////////////////////////////////////////////////////
+// Name: MeshSDF.h
+// Class: Narrow band signed distance field of a mesh in the mesh's own space, stored in sparse bricks of
+//			samples so only cells near the surface take memory.  Queries are a brick lookup and a trilinear
+//			interpolation, so their cost doesn't depend on the triangle count.  Distances are positive
+//			outside (the side the face normals point to) and negative inside.  Built once per Mesh and
+//			cached to disk by the Mesh beside its .ply.
+//////////////////////////////////
+class MeshSDF
+{
+public:
+	MeshSDF() : m_fCellSize( 0.0f ), m_iResolution( 0 ), m_iNumTriangles( 0 ), m_iMeshHash( 0 )
+	{ m_iBricksPerAxis[ 0 ] = m_iBricksPerAxis[ 1 ] = m_iBricksPerAxis[ 2 ] = 0; }
+
+	// Samples the distance to the triangles of vVertices/iIndices (3 per triangle) on a grid with iResolution
+	//	cells along the longest side of the mesh's bounds.
+	void build( const vector< vec3 >& vVertices, const vector< unsigned int >& iIndices, unsigned int iResolution );
+
+	// Cache file: binary, only read back if it was built at the same resolution from the same vertices and
+	//	indices.
+	bool save( const string& sFileName ) const;
+	bool load( const string& sFileName, unsigned int iResolution, const vector< vec3 >& vVertices,
+			   const vector< unsigned int >& iIndices );
+
+	// Distance and its gradient (unnormalized) at vPoint.  Returns false outside the band.
+	bool sample( const vec3& vPoint, float& fDistance, vec3& vGradient ) const;
+
+	// Crossing of the surface from outside to inside by the segment vStart..vStart + vRay.  fT is the fraction
+	//	of vRay (0 to 1) to the crossing and vNormal the outward gradient there.  Returns false without a crossing.
+	bool intersect( const vec3& vStart, const vec3& vRay, float& fT, vec3& vNormal ) const;
+
+	bool empty() const { return m_fSamples.empty(); }
+	unsigned int getResolution() const { return m_iResolution; }
+	unsigned int getNumBricks() const { return m_fSamples.size() / MESH_SDF_BRICK_SAMPLES; }
+
+private:
+	vec3 m_vOrigin;						// Position of sample (0, 0, 0)
+	float m_fCellSize;
+	unsigned int m_iResolution, m_iNumTriangles;
+	unsigned long long m_iMeshHash;		// Of the vertices and indices built from
+	int m_iBricksPerAxis[ 3 ];
+	vector< int > m_iBricks;			// Index of each brick's samples / MESH_SDF_BRICK_SAMPLES
+	vector< float > m_fSamples;			// Samples of every stored brick, x fastest
+
+	float getSample( int iBrick, int iX, int iY, int iZ ) const
+	{ return m_fSamples[ iBrick * MESH_SDF_BRICK_SAMPLES + (iZ * (MESH_SDF_BRICK + 1) + iY) * (MESH_SDF_BRICK + 1) + iX ]; }
+};
@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include "TextureManager.h"
 #include "Anim_Track.h"
+#include "TripleBuffer.h"
 
 class Object
 {
@@ -17,11 +18,18 @@ public:
 
 	mat4 getFreNetFrames();
 
+	// Animation: animate moves the object a frame along its Animation Track and publishes its Frenet frame.
+	//	It's called with the simulation's frames, so the collisions see the same motion; the render thread
+	//	draws the frame last published.
+	virtual void animate();
+	const mat4& getPublishedFrame() const { return m_sPublishedFrame.acquire(); }
+
 	void switchTexture( const string* sTexLoc );
 
 	// Getters/Setters
 	long ID() const { return m_lID; }								// Get ID for the object																	
 	const glm::vec3& getPosition() { return m_pPosition; }			// Retrieve the Position of the Light
+	bool isAnimated() const { return nullptr != m_pAnimTrack; }		// Moves along an Animation Track
 
 protected:
 	vec3 m_pPosition;
@@ -29,6 +37,7 @@ protected:
 	Texture* m_pTexture;
 
 	Anim_Track* m_pAnimTrack;
+	mutable TripleBuffer< mat4 > m_sPublishedFrame;	// Reader side swaps slots, even from const accessors
 
 	// Protected Constructor, Only available to children and Object Factory
 	Object( const vec3* pPos, long lID, 
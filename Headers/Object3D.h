@@ -21,6 +21,17 @@ public:
 	virtual string getDebugOutput() = 0;
 	virtual bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal) = 0;
 
+	// World space bounding box for the collision broadphase.  Objects without a collision test return false
+	//	and are left out of it; anything that implements isCollision needs to override this as well.
+	virtual bool getBounds( vec3& vMin, vec3& vMax ) { return false; }
+
+	// Batched isCollision: tests every ray i < iCount and keeps a hit in pT[i] and pNormal[i] if it's closer
+	//	than pT[i] (and not behind the ray), setting pObject[i] to iObject (the key the caller knows this object
+	//	by).  Objects with a collision test should override it with a loop that vectorizes; the default calls
+	//	isCollision per ray.
+	virtual void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+								unsigned int* pObject, unsigned int iObject );
+
 protected:
 	// Protected Variables
 	vector<vec3> m_pVertices;
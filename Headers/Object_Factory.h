@@ -28,6 +28,7 @@ private:
 	static Object_Factory* m_pInstance;
 	string m_sTextureProperty, m_sMeshProperty;
 	Anim_Track* m_pAnimProperty;
+	unsigned int m_iSDFProperty;		// Distance field resolution of the next mesh, 0 for none
 
 	long m_lNextID;
 	long getNewID() { return ++m_lNextID; }
@@ -42,6 +43,7 @@ private:
 
 		m_pAnimProperty = nullptr;
 		m_sMeshProperty = m_sTextureProperty = "";
+		m_iSDFProperty = 0;
 	}
 	void saveProperties( string& sTextureProperty, string& sMeshProperty, Anim_Track* pAnimTrackProp )
 	{
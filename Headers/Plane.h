@@ -1,5 +1,6 @@
 #pragma once
 #include "Object3D.h"
+#include "PlaneCollider.h"
 class Plane :
 	public Object3D
 {
@@ -15,6 +16,10 @@ public:
 	// Overridden Debug Output
 	string getDebugOutput();
 	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal);
+	bool getBounds( vec3& vMin, vec3& vMax ) { m_sCollider.getBounds( vMin, vMax ); return true; }
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject )
+		{ m_sCollider.findCollisions( pStart, pRay, iCount, pT, pNormal, pObject, iObject ); }
 
 private:
 	Plane( const vec3* pPosition, const vector<vec3>* pCorners, long lID, const string* sTexName, bool bUseEB, const Anim_Track* pAnimTrack );
@@ -22,7 +27,7 @@ private:
 
 	// Normal of the Plane.
 	vec3 m_pNormal;	
-	float m_fD;
+	PlaneCollider m_sCollider;
 	EdgeBuffer* m_pEdgeBuffer;
 
 	// Inherited from Parent
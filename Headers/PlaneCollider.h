@@ -0,0 +1,41 @@
+#pragma once
+#include "stdafx.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: PlaneCollider.h
+// Class: Geometry of a Plane (a quad given by 4 corners) and its ray intersection test, without
+//			any of the rendering so the simulation can collide against planes without a GL context.
+//////////////////////////////////
+class PlaneCollider
+{
+public:
+	// Corners are relative to vPosition; anything other than 4 corners gives the default 2x2 quad.
+	PlaneCollider( const vec3& vPosition, const vector< vec3 >& vCorners );
+
+	bool isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal ) const;
+
+	// Batched isCollision, keeps the closest hit of each ray in pT and pNormal, tagged iObject in pObject
+	//	(see Object3D::findCollisions)
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject ) const;
+
+	// World space bounding box of the corners
+	void getBounds( vec3& vMin, vec3& vMax ) const;
+
+	// Getters
+	const vector< vec3 >& getCorners() const { return m_vCorners; }	// World space
+	const vec3& getNormal() const { return m_vNormal; }
+
+private:
+	vector< vec3 > m_vCorners;
+	vec3 m_vNormal;
+	float m_fD;
+
+	// Edges of the quad's triangles (v1,v2,v3) and (v2,v4,v3): in-plane unit normals pointing inside and
+	//	their offsets, a point is inside a triangle if dot( point, normal ) >= offset for its 3 edges.
+	vec3 m_vEdgeNormal[ 6 ];
+	float m_fEdgeOffset[ 6 ];
+
+	void setEdge( unsigned int iEdge, const vec3& vFrom, const vec3& vTo, const vec3& vOpposite );
+	bool isInside( const vec3& vPoint ) const;
+};
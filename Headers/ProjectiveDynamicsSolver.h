@@ -0,0 +1,70 @@
+#pragma once
+#include "stdafx.h"
+#include "AlignedAllocator.h"
+#include "SparseCholesky.h"
+
+class MassSpringSystem;
+
+//////////////////////////////////////////////////////////////////
+// Name: ProjectiveDynamicsSolver.h
+// Class: Projective Dynamics step for a MassSpringSystem (Bouaziz et al. 2014, Liu et al. 2013).
+//			Every spring is projected onto its rest length (local step, in parallel), then all
+//			positions are solved at once from (M / h^2 + k * L) x = M / h^2 * y + k * J * d
+//			(global step).  The system matrix only depends on the masses, k and h, so it is
+//			factored once and every iteration is just two triangular solves.  Fixed masses
+//			aren't unknowns, their springs move to the right hand side.  Masses pushed out of
+//			a collision pull towards their contact point with the collision stiffness in the
+//			global step, which is then solved by conjugate gradient preconditioned by the factor.
+//////////////////////////////////
+class ProjectiveDynamicsSolver
+{
+public:
+	ProjectiveDynamicsSolver( MassSpringSystem* pSystem );
+	~ProjectiveDynamicsSolver();
+
+	// Orders the unknowns and factors the system matrix for the current delta_t; call whenever the topology changes.
+	void initialize();
+
+	// Advances the system by fDeltaT; refactors first if fDeltaT or the spring constant changed.
+	void step( float fDeltaT );
+
+	// Solver Settings
+	void setIterations( unsigned int iIterations ) { m_iIterations = iIterations; }
+	unsigned int getIterations() const { return m_iIterations; }
+	size_t getFactorNonZeros() const { return m_sFactor.getNonZeros(); }
+
+private:
+	MassSpringSystem* m_pSystem;
+	unsigned int m_iIterations;
+	float m_fFactoredDeltaT, m_fFactoredK;
+	SparseCholesky m_sFactor;
+
+	// Row of each mass in the system (-1 for fixed masses) and the mass of each row
+	vector< int > m_vRow;
+	vector< unsigned int > m_vRowMass;
+
+	// Per Mass: position at the start of the step and the inertial target y = x + h * v + h^2 * f / m
+	aligned_vector< vec3 > m_vPrevPosition, m_vInertial;
+
+	// Per Spring: the spring's direction scaled to its rest length (local step result)
+	aligned_vector< vec3 > m_vProjection;
+
+	// Per Row: 1 if the mass was pushed out of a collision by the last contact projection
+	vector< unsigned char > m_vContact;
+	int m_iNumContacts;
+
+	// Global step solution and the contact solve's vectors, interleaved xyz per row
+	vector< double > m_vSolution, m_vResidual, m_vDirection, m_vPrecResidual, m_vProduct;
+	vector< double > m_vBlockSums;		// Partial sums of the dot products of deterministic systems
+
+	void orderRows();
+	void dissect( vector< unsigned int >& vMasses, unsigned int iBegin, unsigned int iEnd, vector< unsigned char >& vLeft ) const;
+	bool factor( float fDeltaT );
+	void predict( float fDeltaT, int iNumThreads );
+	void projectSprings( int iNumThreads );
+	void solveGlobal( float fDeltaT, int iNumThreads );
+	void solveContacts( float fDeltaT, int iNumThreads );
+	void multiply( const double* pIn, double* pOut, float fDeltaT, int iNumThreads ) const;
+	void projectContacts( int iNumThreads );
+	double dotProduct( const double* pA, const double* pB, int iCount, int iNumThreads );
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "AlignedAllocator.h"
+
+class MassSpringSystem;
+
+//////////////////////////////////////////////////////////////////
+// Name: SelfCollision.h
+// Class: Particle-particle collisions within a MassSpringSystem.  Masses are binned every substep into a
+//			uniform grid of cells hashed into a fixed size table (sized from the mass count, not the space
+//			the system covers) with a parallel, stable counting sort.  Pairs closer than the collision distance
+//			push apart with the same penalty model as collisions against the environment (Collision_K,
+//			Collision_Damping_Coeff); pairs already connected by a spring are skipped.
+//////////////////////////////////
+class SelfCollision
+{
+public:
+	SelfCollision( MassSpringSystem* pSystem );
+	~SelfCollision();
+
+	// Sizes the hash table and per mass buffers; call whenever the topology changes (after the adjacency is built).
+	void initialize();
+
+	// Rebuilds the hash from the current positions and adds the collision force of every free mass.
+	//	Uses orphaned work sharing: call it from every thread of a parallel region, or from outside of one.
+	void accumulateForces();
+
+	// Distance two masses are kept apart, 0 for half the shortest spring
+	void setDistance( float fDistance ) { m_fDistance = fDistance; }
+	float getDistance() const { return m_fCellSize; }
+	unsigned int getTableSize() const { return m_iTableMask + 1; }
+
+private:
+	MassSpringSystem* m_pSystem;
+	float m_fDistance, m_fCellSize;
+	unsigned int m_iTableMask;
+
+	// Bucket b holds masses m_iSorted[m_iCellStart[b], m_iCellStart[b + 1]), in increasing order
+	aligned_vector< unsigned int > m_iMassBucket, m_iSorted;
+	aligned_vector< unsigned long long > m_iMassCell, m_iSortedCell;	// Packed cell of each mass, in mass and bucket order
+	aligned_vector< unsigned int > m_iCellStart, m_iCellFill;
+
+	// Masses grouped by block of buckets, in mass order, and where each chunk of masses writes its own
+	//	to each block (block-major)
+	aligned_vector< unsigned int > m_iBlockMasses;
+	vector< unsigned int > m_iChunkOffset, m_iBlockStart;
+
+	ivec3 getCell( const vec3& vPosition ) const;
+	unsigned int hashCell( int iX, int iY, int iZ ) const
+	{ return ((unsigned int)iX * 73856093u ^ (unsigned int)iY * 19349663u ^ (unsigned int)iZ * 83492791u) & m_iTableMask; }
+
+	// 21 bits per axis: cells that wrap onto the same key are too far apart to collide
+	static unsigned long long packCell( int iX, int iY, int iZ )
+	{ return ((unsigned long long)(iX & 0x1fffff) << 42) | ((unsigned long long)(iY & 0x1fffff) << 21) | (unsigned long long)(iZ & 0x1fffff); }
+	bool isConnected( unsigned int iMass1, unsigned int iMass2 ) const;
+	vec3 getForce( unsigned int iMass ) const;
+};
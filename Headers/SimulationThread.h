@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////
+// Name: SimulationThread.h
+// Class: Steps a simulation on its own thread at a fixed rate, independently of the
+//			render loop.  Frames the thread falls behind on are dropped rather than
+//			caught up, so a slow step slows the simulation down instead of snowballing.
+//			While paused it only steps when a single step is requested.
+//////////////////////////////////
+class SimulationThread
+{
+public:
+	SimulationThread();
+	~SimulationThread();
+
+	// Starts calling pStep fRate times a second, stopping the previous thread first.
+	void start( const function< void() >& pStep, float fRate );
+	void stop();
+	bool isRunning() const { return m_pThread.joinable(); }
+
+	// Rate in frames per second
+	void setRate( float fRate );
+	float getRate() const { return m_fRate; }
+
+	void setPaused( bool bPaused );
+	bool isPaused() const { return m_bPaused; }
+
+	// Steps one more frame as soon as possible, paused or not.
+	void requestStep();
+
+	// Frames stepped since start
+	unsigned long long getFrameCount() const { return m_iFrameCount; }
+
+private:
+	thread m_pThread;
+	function< void() > m_pStep;
+	mutex m_mWait;
+	condition_variable m_cvWake;		// Signalled on stop, pause and step requests
+	atomic< float > m_fRate;
+	atomic< bool > m_bStop, m_bPaused;
+	atomic< unsigned int > m_iRequestedSteps;
+	atomic< unsigned long long > m_iFrameCount;
+
+	void run();
+	void wake();
+};
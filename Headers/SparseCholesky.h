@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+//////////////////////////////////////////////////////////////////
+// Name: SparseCholesky.h
+// Class: Sparse Cholesky factorization A = L * L^T of a symmetric positive definite matrix.
+//			The matrix is given as its upper triangle in compressed columns and should already
+//			be in a fill reducing order.  The nonzeros of L are found from the elimination tree
+//			so both the factorization and the triangular solves only touch the nonzeros of L
+//			(up-looking algorithm, Davis: Direct Methods for Sparse Linear Systems, 2006).
+//////////////////////////////////
+class SparseCholesky
+{
+public:
+	SparseCholesky();
+	~SparseCholesky();
+
+	// Factors the iSize x iSize matrix whose column c has the entries vValues[ i ] in rows vRows[ i ] <= c
+	//	for i in [vColumnOffsets[ c ], vColumnOffsets[ c + 1 ]).  Duplicate entries are summed.
+	//	Returns false if the matrix isn't positive definite.
+	bool factor( unsigned int iSize, const std::vector< unsigned int >& vColumnOffsets,
+				 const std::vector< unsigned int >& vRows, const std::vector< double >& vValues );
+
+	// Solves A x = b in place for iNumRHS right hand sides stored interleaved: pX[ i * iNumRHS + r ].
+	void solve( double* pX, unsigned int iNumRHS ) const;
+
+	bool isFactored() const { return !m_vValues.empty(); }
+	unsigned int size() const { return m_iSize; }
+	size_t getNonZeros() const { return m_vValues.size(); }
+	void clear();
+
+private:
+	unsigned int m_iSize;
+
+	// L in compressed columns, the diagonal is the first entry of every column
+	std::vector< unsigned int > m_vColumnOffsets, m_vRows;
+	std::vector< double > m_vValues;
+
+	unsigned int reach( unsigned int iRow, const std::vector< unsigned int >& vColumnOffsets, const std::vector< unsigned int >& vRows,
+						const std::vector< int >& vParent, std::vector< int >& vFlag, std::vector< unsigned int >& vStack ) const;
+};
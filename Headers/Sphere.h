@@ -1,5 +1,6 @@
 #pragma once
 #include "Object3D.h"
+#include "SphereCollider.h"
 
 
 class Sphere :
@@ -11,13 +12,20 @@ public:
 	// Overridden draw
 	void draw( const vec3& vCamLookAt, float fMinThreshold, float fMaxThreshold, bool m_bPause );
 
+	// Moves the collider along with the track
+	void animate();
+
 	// Overridden Type Output
 	string getType() { return "Sphere"; }
 
 	// Overridden Debug Output
 	string getDebugOutput();
 
-	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal) { return false; /*Not Implemented*/ }
+	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal);
+	bool getBounds( vec3& vMin, vec3& vMax ) { m_sCollider.getBounds( vMin, vMax ); return true; }
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject )
+		{ m_sCollider.findCollisions( pStart, pRay, iCount, pT, pNormal, pObject, iObject ); }
 	
 private:
 	// Constructor for Spheres
@@ -35,6 +43,7 @@ private:
 
 	// Private Sphere Variables
 	float m_fRadius;
+	SphereCollider m_sCollider;
 
 	// Inherited from Parent
 	void calculateUVs();
@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: SphereCollider.h
+// Class: Geometry of a Sphere (center and radius) and its swept point test, without any of the
+//			rendering so the simulation can collide against spheres without a GL context.
+//////////////////////////////////
+class SphereCollider
+{
+public:
+	SphereCollider( const vec3& vCenter, float fRadius );
+
+	// The segment vStart..vStart + vRay entering the sphere from outside, solved exactly so a point moving
+	//	any distance over a step can't pass through it.  fT is the distance along the normalized ray.
+	bool isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal ) const;
+
+	// Batched isCollision, keeps the closest hit of each ray in pT and pNormal, tagged iObject in pObject
+	//	(see Object3D::findCollisions)
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject ) const;
+
+	// World space bounding box of the sphere
+	void getBounds( vec3& vMin, vec3& vMax ) const { vMin = m_vCenter - vec3( m_fRadius ); vMax = m_vCenter + vec3( m_fRadius ); }
+
+	// Getters/Setters
+	void setCenter( const vec3& vCenter ) { m_vCenter = vCenter; }		// Animated Spheres move it every frame
+	const vec3& getCenter() const { return m_vCenter; }
+	float getRadius() const { return m_fRadius; }
+
+private:
+	vec3 m_vCenter;
+	float m_fRadius;
+};
@@ -0,0 +1,55 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Largest allowed difference between a vectorized kernel and the scalar kernel, per mass and
+//	force component, relative to k * (longest spring attached to that mass).  The vectorized
+//	kernels use one approximate reciprocal square root refined by a Newton-Raphson step
+//	(~22 bits), so the elastic force of each spring differs by at most a few ulps of k * |d|.
+#define SPRING_KERNEL_TOLERANCE 1e-5f
+
+// Springs per iteration of the widest kernel.  A range cut into pieces at multiples of it from its start
+//	is vectorized in the same groups, with the same scalar remainder, as the whole range in one call.
+#define SPRING_KERNEL_MAX_WIDTH 16
+
+// Signature shared by every spring force kernel:
+//	Adds the elastic force of springs [iBegin, iEnd) to both of their masses.
+typedef void (*SpringForceKernel)( const unsigned int* pMass1, const unsigned int* pMass2,
+								   const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+								   const glm::vec3* pPosition, glm::vec3* pForce, float fK );
+
+//////////////////////////////////////////////////////////////////
+// Name: SpringKernels.h
+// Class: Scalar and vectorized (AVX2: 8 springs, AVX-512: 16 springs) implementations
+//			of the spring force pass, selected at runtime by CPU feature detection.
+//////////////////////////////////
+class SpringKernels
+{
+public:
+	enum eKernelType
+	{
+		SCALAR_KERNEL = 0,
+		AVX2_KERNEL,
+		AVX512_KERNEL,
+		MAX_KERNELS
+	};
+
+	// Kernel Selection
+	static bool isSupported( eKernelType eType );
+	static eKernelType getBestKernel();
+	static SpringForceKernel getKernel( eKernelType eType );
+	static const char* getName( eKernelType eType );
+
+	// Kernels
+	static void accumulateScalar( const unsigned int* pMass1, const unsigned int* pMass2,
+								  const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+								  const glm::vec3* pPosition, glm::vec3* pForce, float fK );
+	static void accumulateAVX2( const unsigned int* pMass1, const unsigned int* pMass2,
+								const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+								const glm::vec3* pPosition, glm::vec3* pForce, float fK );
+	static void accumulateAVX512( const unsigned int* pMass1, const unsigned int* pMass2,
+								  const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+								  const glm::vec3* pPosition, glm::vec3* pForce, float fK );
+
+private:
+	SpringKernels() { }
+};
@@ -0,0 +1,44 @@
+#pragma once
+#include "stdafx.h"
+#include "TrajectoryRecorder.h"
+#include "MappedFile.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: TrajectoryReader.h
+// Class: Reads back the frames of a file written by TrajectoryRecorder, in any order.  A frame
+//			is found through the chunk index and decoded from the first frame of its chunk;
+//			reading the frames of a chunk in order decodes each of them once.
+//////////////////////////////////
+class TrajectoryReader
+{
+public:
+	TrajectoryReader( const string& sFileName );
+
+	// False if the file isn't a trajectory or none of its chunks could be found
+	bool isOpen() const { return !m_vIndex.empty(); }
+	unsigned int getNumMasses() const { return m_sHeader.iNumMasses; }
+	unsigned long long getNumFrames() const { return m_iNumFrames; }
+
+	// Decodes frame iFrame into vPositions.  False if there's no such frame or its chunk is corrupt.
+	bool readFrame( unsigned long long iFrame, aligned_vector< vec3 >& vPositions );
+
+private:
+	TrajectoryReader( const TrajectoryReader& sCopy );
+	TrajectoryReader& operator=( const TrajectoryReader& sCopy );
+
+	MappedFile m_sFile;
+	TrajectoryRecorder::FileHeader m_sHeader;
+	vector< TrajectoryRecorder::IndexEntry > m_vIndex;
+	unsigned long long m_iNumFrames;
+
+	// Decoding position: the quantized values of frame m_iFrame of chunk m_iChunk, and where the next
+	//	frame's encoding starts in the file.
+	unsigned int m_iChunk;
+	unsigned long long m_iFrame;
+	size_t m_iNextFrameOffset;
+	vector< unsigned short > m_vQuantized;
+
+	bool readIndex();
+	void scanChunks();
+	bool decodeFrame( size_t iEnd, bool bFirst );
+};
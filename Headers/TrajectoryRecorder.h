@@ -0,0 +1,102 @@
+#pragma once
+#include "stdafx.h"
+#include "AlignedAllocator.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+//////////////////////////////////////////////////////////////////
+// Name: TrajectoryRecorder.h
+// Class: Streams the positions of a system, one frame at a time, to a compressed file for
+//			offline analysis (see TrajectoryReader).  Frames are grouped in chunks: every
+//			position of a chunk is quantized to 16 bits per axis within the chunk's bounding
+//			box, the first frame is stored as is and the others as the change from the frame
+//			before, in as few bytes as the change needs.  record only copies the frame; the
+//			encoding and writing are done on the recorder's own thread.  Chunks and the queue
+//			of frames waiting for the writer each hold at most BUFFER_BYTES of raw frames; frames
+//			recorded while the queue is full are dropped rather than waited for.
+//////////////////////////////////
+class TrajectoryRecorder
+{
+public:
+	TrajectoryRecorder();
+	~TrajectoryRecorder();
+
+	// Creates the file and starts the writer thread for frames of iNumMasses positions.  Chunks are shortened
+	//	from iChunkFrames to fit BUFFER_BYTES.
+	bool open( const string& sFileName, unsigned int iNumMasses, unsigned int iChunkFrames = DEFAULT_CHUNK_FRAMES );
+
+	// Queues a copy of the frame and returns; frames of another size than the file's are refused, and frames
+	//	that find the queue full are dropped and counted.  Never waits for the writer.
+	bool record( const aligned_vector< vec3 >& vPositions );
+
+	// Writes the frames still queued and the chunk index, then closes the file.  False if anything
+	//	couldn't be written.
+	bool close();
+	bool isOpen() const { return m_pThread.joinable(); }
+
+	unsigned long long getFrameCount() const { return m_iFrameCount; }		// Frames recorded
+	unsigned long long getFramesDropped() const { return m_iFramesDropped; }	// Frames lost to a full queue
+	unsigned long long getBytesWritten() const { return m_iBytesWritten; }
+
+	// File Format: a FileHeader, the chunks, each a ChunkHeader followed by its encoded frames, then an
+	//	IndexEntry per chunk and the Footer.  A file that wasn't closed has no index; its chunks are
+	//	found by walking them from the header.  Everything is in native byte order.
+	static const unsigned int DEFAULT_CHUNK_FRAMES = 64;
+	static const unsigned long long BUFFER_BYTES = 64ULL << 20;	// Raw frames per chunk, and again per queue
+	static const unsigned int FILE_MAGIC = 0x5254534du;	// "MSTR"
+	static const unsigned int CHUNK_MAGIC = 0x4b4e4843u;	// "CHNK"
+	static const unsigned int INDEX_MAGIC = 0x58444e49u;	// "INDX"
+	static const unsigned int VERSION = 1;
+
+	struct FileHeader
+	{
+		unsigned int iMagic, iVersion, iHeaderSize, iNumMasses, iChunkFrames;
+	};
+	struct ChunkHeader
+	{
+		unsigned int iMagic, iNumFrames;
+		unsigned long long iFirstFrame, iBytes;		// iBytes of encoded frames follow the header
+		float fMin[ 3 ], fStep[ 3 ];				// Position = fMin + quantized value * fStep, per axis
+	};
+	struct IndexEntry
+	{
+		unsigned long long iFirstFrame, iOffset;	// iOffset of the ChunkHeader from the start of the file
+	};
+	struct Footer
+	{
+		unsigned int iMagic, iNumChunks;
+		unsigned long long iNumFrames, iIndexOffset;
+	};
+
+private:
+	TrajectoryRecorder( const TrajectoryRecorder& sCopy );
+	TrajectoryRecorder& operator=( const TrajectoryRecorder& sCopy );
+
+	string m_sFileName;
+	ofstream m_sFile;
+	unsigned int m_iNumMasses, m_iChunkFrames, m_iMaxQueued;
+
+	// Frames handed from record to the writer thread.  Written frames go back on the free list, so
+	//	recording doesn't allocate once the first chunks are out.
+	thread m_pThread;
+	mutex m_mQueue;
+	condition_variable m_cvQueue;
+	deque< aligned_vector< vec3 > > m_vQueued;
+	vector< aligned_vector< vec3 > > m_vFree;
+	bool m_bClosing;
+	atomic< unsigned long long > m_iFrameCount, m_iFramesDropped, m_iBytesWritten;
+
+	// Writer thread only
+	vector< aligned_vector< vec3 > > m_vChunk;
+	vector< unsigned short > m_vQuantized, m_vPrevQuantized;
+	vector< unsigned char > m_vEncoded;
+	vector< IndexEntry > m_vIndex;
+	unsigned long long m_iFramesWritten;
+
+	void run();
+	void writeChunk();
+	void write( const void* pData, size_t iBytes );
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "Object3D.h"
+#include "TriangleCollider.h"
 
 #define P1 0
 #define P2 1
@@ -20,7 +21,11 @@ public:
 	// Overridden Debug Output
 	string getDebugOutput();
 
-	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal) { return false; /*Not Implemented*/ }
+	bool isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal);
+	bool getBounds( vec3& vMin, vec3& vMax ) { m_sCollider.getBounds( vMin, vMax ); return true; }
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject )
+		{ m_sCollider.findCollisions( pStart, pRay, iCount, pT, pNormal, pObject, iObject ); }
 
 private:
 	// Only Accessable by Object Factory
@@ -29,6 +34,8 @@ private:
 			  long lID, const string* sTexName, const Anim_Track* pAnimTrack );
 	Triangle( const Triangle* pNewTriangle );  // Protected Copy Constructor
 
+	TriangleCollider m_sCollider;
+
 	// Inherited from Parent
 	void calculateUVs();
 
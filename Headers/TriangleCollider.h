@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+
+//////////////////////////////////////////////////////////////////
+// Name: TriangleCollider.h
+// Class: Geometry of a Triangle and its swept point test, without any of the rendering so the
+//			simulation can collide against triangles without a GL context.  Triangles have no
+//			thickness, so they're two sided: the segment can cross them from either side.
+//////////////////////////////////
+class TriangleCollider
+{
+public:
+	// World space vertices; anything other than 3 vertices gives the default triangle.
+	TriangleCollider( const vector< vec3 >& vVertices );
+
+	// The segment vStart..vStart + vRay crossing the triangle.  fT is the distance along the normalized ray and
+	//	the normal faces the start of the ray.
+	bool isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal ) const;
+
+	// Batched isCollision, keeps the closest hit of each ray in pT and pNormal, tagged iObject in pObject
+	//	(see Object3D::findCollisions)
+	void findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+						unsigned int* pObject, unsigned int iObject ) const;
+
+	// World space bounding box of the vertices
+	void getBounds( vec3& vMin, vec3& vMax ) const { vMin = m_vMin; vMax = m_vMax; }
+
+	// Getters
+	const vector< vec3 >& getVertices() const { return m_vVertices; }
+	const vec3& getNormal() const { return m_vNormal; }
+
+private:
+	vector< vec3 > m_vVertices;
+	vec3 m_vNormal;
+	float m_fD;
+	vec3 m_vMin, m_vMax;
+
+	// In-plane unit normals of the edges pointing inside and their offsets, a point of the plane is inside
+	//	if dot( point, normal ) >= offset for all 3 edges.
+	vec3 m_vEdgeNormal[ 3 ];
+	float m_fEdgeOffset[ 3 ];
+
+	bool isInside( const vec3& vPoint ) const;
+
+	// Box of the segment vStart..vEnd against the triangle's, branch free so it vectorizes
+	bool overlapsBounds( const vec3& vStart, const vec3& vEnd ) const
+	{
+		return (std::min( vStart.x, vEnd.x ) <= m_vMax.x) & (std::max( vStart.x, vEnd.x ) >= m_vMin.x)
+			 & (std::min( vStart.y, vEnd.y ) <= m_vMax.y) & (std::max( vStart.y, vEnd.y ) >= m_vMin.y)
+			 & (std::min( vStart.z, vEnd.z ) <= m_vMax.z) & (std::max( vStart.z, vEnd.z ) >= m_vMin.z);
+	}
+};
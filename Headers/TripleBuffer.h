@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+
+//////////////////////////////////////////////////////////////////
+// Name: TripleBuffer.h
+// Class: Lock-free handoff of a value from one writer thread to one reader thread.
+//			The writer fills the back slot and publishes it by swapping it with the
+//			middle slot; the reader swaps the middle slot for its front slot when a
+//			newer value is there.  Neither side ever waits on the other: the writer
+//			always has a slot the reader isn't using, and the reader always has the
+//			latest complete value.
+//////////////////////////////////
+template< typename T >
+class TripleBuffer
+{
+public:
+	TripleBuffer() : m_iMiddle( 1 ), m_iBack( 2 ), m_iFront( 0 ) { }
+
+	// Writer: the slot to fill, then publish() hands it to the reader.
+	T& getBack() { return m_pSlots[ m_iBack ]; }
+	void publish() { m_iBack = m_iMiddle.exchange( m_iBack | FRESH_BIT, std::memory_order_acq_rel ) & INDEX_MASK; }
+
+	// Reader: the latest published value, the same one until something newer is published.
+	const T& acquire()
+	{
+		if ( m_iMiddle.load( std::memory_order_relaxed ) & FRESH_BIT )
+			m_iFront = m_iMiddle.exchange( m_iFront, std::memory_order_acq_rel ) & INDEX_MASK;
+		return m_pSlots[ m_iFront ];
+	}
+
+	// Writer and reader threads must both be stopped.
+	void fill( const T& sValue ) { m_pSlots[ 0 ] = m_pSlots[ 1 ] = m_pSlots[ 2 ] = sValue; }
+
+private:
+	static const unsigned int INDEX_MASK = 3;
+	static const unsigned int FRESH_BIT = 4;	// Set on the middle slot by publish, cleared by acquire
+
+	T m_pSlots[ 3 ];
+	std::atomic< unsigned int > m_iMiddle;
+	unsigned int m_iBack;		// Only touched by the writer
+	unsigned int m_iFront;		// Only touched by the reader
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "AlignedAllocator.h"
+
+class MassSpringSystem;
+
+//////////////////////////////////////////////////////////////////
+// Name: XPBDSolver.h
+// Class: Extended Position Based Dynamics step for a MassSpringSystem (Macklin et al. 2016).
+//			Springs are compliant distance constraints (compliance = 1 / k), fixed masses have
+//			infinite mass and collisions are inequality constraints against the contact plane.
+//			Constraints are projected with Gauss-Seidel (in place, one spring color at a time)
+//			or Jacobi (every spring at once, corrections averaged per mass).
+//////////////////////////////////
+class XPBDSolver
+{
+public:
+	enum eIterationType
+	{
+		GAUSS_SEIDEL = 0,
+		JACOBI,
+		MAX_ITERATION_TYPES
+	};
+
+	XPBDSolver( MassSpringSystem* pSystem );
+	~XPBDSolver();
+
+	// Sizes the per spring and per mass buffers; call whenever the topology changes.
+	void initialize();
+
+	// Advances the system by fDeltaT.
+	void step( float fDeltaT );
+
+	// Solver Settings
+	void setIterations( unsigned int iIterations ) { m_iIterations = iIterations; }
+	void setIterationType( eIterationType eType ) { m_eIterationType = eType; }
+	unsigned int getIterations() const { return m_iIterations; }
+	eIterationType getIterationType() const { return m_eIterationType; }
+
+private:
+	MassSpringSystem* m_pSystem;
+	unsigned int m_iIterations;
+	eIterationType m_eIterationType;
+
+	// Per Mass: position at the start of the step and inverse mass (0 for fixed masses)
+	aligned_vector< vec3 > m_vPrevPosition;
+	aligned_vector< float > m_fWeight;
+
+	// Per Spring: accumulated Lagrange multiplier and the latest Jacobi correction (delta lambda * gradient)
+	aligned_vector< float > m_fLambda;
+	aligned_vector< vec3 > m_vCorrection;
+
+	void predict( float fDeltaT, int iNumThreads );
+	void projectSpring( unsigned int iSpring, float fCompliance );
+	void solveGaussSeidel( float fCompliance, int iNumThreads );
+	void solveJacobi( float fCompliance, int iNumThreads );
+};
@@ -20,16 +20,20 @@
 #include <glm/ext.hpp>
 #include "EnvSpec.h"
 
-#ifdef USING_LINUX
+#include <string>
 #include <string.h>
+
+// HEADLESS: simulation only builds (make sim_headless) that don't link against OpenGL or GLFW
+#ifndef HEADLESS
+#ifdef USING_LINUX
 #define GLFW_INCLUDE_GLCOREARB
 #define GL_GLEXT_PROTOTYPES
 #endif
 #ifdef USING_WINDOWS
-#include <string>
 #include <GL/glew.h>
 #endif
 #include <GLFW/glfw3.h>
+#endif
 
 #define ERR_CODE -1
 
@@ -37,6 +41,7 @@
 using namespace std;
 using namespace glm;
 
+#ifndef HEADLESS
 // From Boilerplate code,
 // Shouldn't need to modify this.
 // Accessible anywhere stdafx.h is included and GL Error Checking is required.
@@ -64,3 +69,4 @@ inline bool CheckGLErrors()
 	}
 	return error;
 }
+#endif
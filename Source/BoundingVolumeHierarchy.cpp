@@ -0,0 +1,107 @@
+#include "BoundingVolumeHierarchy.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define BVH_LEAF_SIZE 2			// Most items tested together in a leaf
+
+// Builds the tree from scratch over every box.
+void BoundingVolumeHierarchy::build( const vector< vec3 >& vMin, const vector< vec3 >& vMax )
+{
+	m_vNodes.clear();
+	m_iItems.resize( vMin.size() );
+	m_vItemMin = vMin;
+	m_vItemMax = vMax;
+
+	for ( unsigned int i = 0; i < m_iItems.size(); ++i )
+		m_iItems[ i ] = i;
+
+	if ( !m_iItems.empty() )
+	{
+		m_vNodes.reserve( 2 * m_iItems.size() );
+		buildNode( vMin, vMax, 0, m_iItems.size(), 1 );
+	}
+}
+
+// Splits m_iItems[iFirst, iFirst + iCount) at the median centroid along the longest axis of the centroids.
+//	Returns the index of the new node.
+unsigned int BoundingVolumeHierarchy::buildNode( const vector< vec3 >& vMin, const vector< vec3 >& vMax,
+												 unsigned int iFirst, unsigned int iCount, unsigned int iDepth )
+{
+	unsigned int iNode = m_vNodes.size();
+	Node sNode;
+	vec3 vCentroidMin( FLT_MAX ), vCentroidMax( -FLT_MAX );
+
+	sNode.vMin = vec3( FLT_MAX );
+	sNode.vMax = vec3( -FLT_MAX );
+	for ( unsigned int i = iFirst; i < iFirst + iCount; ++i )
+	{
+		unsigned int iItem = m_iItems[ i ];
+		vec3 vCentroid = (vMin[ iItem ] + vMax[ iItem ]) * 0.5f;
+
+		sNode.vMin = min( sNode.vMin, vMin[ iItem ] );
+		sNode.vMax = max( sNode.vMax, vMax[ iItem ] );
+		vCentroidMin = min( vCentroidMin, vCentroid );
+		vCentroidMax = max( vCentroidMax, vCentroid );
+	}
+
+	sNode.iFirst = iFirst;
+	sNode.iRight = 0;
+
+	// Leaf: few enough items (or deep enough that the traversal stack could overflow)
+	if ( iCount <= BVH_LEAF_SIZE || iDepth + 2 >= BVH_MAX_DEPTH )
+	{
+		sNode.iCount = iCount;
+		m_vNodes.push_back( sNode );
+		return iNode;
+	}
+
+	// Longest axis of the centroids
+	vec3 vExtent = vCentroidMax - vCentroidMin;
+	int iAxis = (vExtent.x >= vExtent.y && vExtent.x >= vExtent.z) ? 0 : (vExtent.y >= vExtent.z ? 1 : 2);
+	unsigned int iHalf = iCount / 2;
+
+	nth_element( m_iItems.begin() + iFirst, m_iItems.begin() + iFirst + iHalf, m_iItems.begin() + iFirst + iCount,
+				 [ &vMin, &vMax, iAxis ]( unsigned int iA, unsigned int iB )
+				 { return vMin[ iA ][ iAxis ] + vMax[ iA ][ iAxis ] < vMin[ iB ][ iAxis ] + vMax[ iB ][ iAxis ]; } );
+
+	sNode.iCount = 0;
+	m_vNodes.push_back( sNode );
+
+	buildNode( vMin, vMax, iFirst, iHalf, iDepth + 1 );
+	unsigned int iRight = buildNode( vMin, vMax, iFirst + iHalf, iCount - iHalf, iDepth + 1 );
+	m_vNodes[ iNode ].iRight = iRight;
+
+	return iNode;
+}
+
+// Children are stored after their parent, so walking the nodes backwards refits every child before its parent.
+void BoundingVolumeHierarchy::refit( const vector< vec3 >& vMin, const vector< vec3 >& vMax )
+{
+	m_vItemMin = vMin;
+	m_vItemMax = vMax;
+
+	for ( int n = (int)m_vNodes.size() - 1; n >= 0; --n )
+	{
+		Node& sNode = m_vNodes[ n ];
+
+		if ( sNode.iCount > 0 )
+		{
+			sNode.vMin = vec3( FLT_MAX );
+			sNode.vMax = vec3( -FLT_MAX );
+			for ( unsigned int i = sNode.iFirst; i < sNode.iFirst + sNode.iCount; ++i )
+			{
+				sNode.vMin = min( sNode.vMin, vMin[ m_iItems[ i ] ] );
+				sNode.vMax = max( sNode.vMax, vMax[ m_iItems[ i ] ] );
+			}
+		}
+		else
+		{
+			const Node& sLeft = m_vNodes[ n + 1 ];
+			const Node& sRight = m_vNodes[ sNode.iRight ];
+
+			sNode.vMin = min( sLeft.vMin, sRight.vMin );
+			sNode.vMax = max( sLeft.vMax, sRight.vMax );
+		}
+	}
+}
@@ -31,7 +31,13 @@ const char CmdHandler::cCommands[NUM_CMDS][CMD_SIZE] = { "-help",
 														 "r",
 														 "threshold",
 														 "threshold_min",	
-														 "threshold_max"	};
+														 "threshold_max",
+														 "threads",
+														 "sim_rate",
+														 "save",
+														 "restore",
+														 "record",
+														 "record_stop" };
 
 CmdHandler* CmdHandler::m_pInstance = nullptr;
 
@@ -139,6 +145,21 @@ void CmdHandler::process_Input( )
 			bEvaluating = exec_SetThresholdMin();
 		else if ( !strcmp( c_FirstWord, cCommands[ SET_MAX_THRESHOLD ] ) )
 			bEvaluating = exec_SetThresholdMax();
+		else if ( !strcmp( c_FirstWord, cCommands[ SET_THREADS ] ) )
+			bEvaluating = exec_SetThreads();
+		else if ( !strcmp( c_FirstWord, cCommands[ SET_SIM_RATE ] ) )
+			bEvaluating = exec_SetSimRate();
+		else if ( !strcmp( c_FirstWord, cCommands[ SAVE_SNAPSHOT ] ) )
+			bEvaluating = exec_Snapshot( false );
+		else if ( !strcmp( c_FirstWord, cCommands[ RESTORE_SNAPSHOT ] ) )
+			bEvaluating = exec_Snapshot( true );
+		else if ( !strcmp( c_FirstWord, cCommands[ RECORD ] ) )
+			bEvaluating = exec_Record();
+		else if ( !strcmp( c_FirstWord, cCommands[ STOP_RECORD ] ) )
+		{
+			m_pEnvMngr->stopRecording();
+			bEvaluating = false;
+		}
 		else
 			cout << "Unknown Command: \"" << c_FirstWord << ".\"" << endl;
 	}
@@ -209,7 +230,25 @@ void CmdHandler::outputHelpList()
 		<< "\t\t-- 1 parameter: floating point value for the minimum threshold.  Between the range of 0.0 and 360.0\n\n"
 		<< "\t- \"threshold_max\"\n"
 		<< "\t\t-- changes the max threshold of the inside edges\n"
-		<< "\t\t-- 1 parameter: floating point value for the maximum threshold.  Between the range of 0.0 and 360.0\n\n";
+		<< "\t\t-- 1 parameter: floating point value for the maximum threshold.  Between the range of 0.0 and 360.0\n\n"
+		<< "\t- \"threads\"\n"
+		<< "\t\t-- sets the number of threads used to update the mass spring systems\n"
+		<< "\t\t-- 1 parameter: integer number of threads >= 0.  0 uses every available hardware thread\n\n"
+		<< "\t- \"sim_rate\"\n"
+		<< "\t\t-- sets how many frames per second the mass spring systems are stepped, independently of the render rate\n"
+		<< "\t\t-- 1 parameter: floating point frames per second > 0.0.  Default 60.0\n\n"
+		<< "\t- \"save\"\n"
+		<< "\t\t-- saves the complete state of the mass spring systems to a binary snapshot\n"
+		<< "\t\t-- 1 parameter: file name.  With several systems, the second goes to <file name>.1, the third to <file name>.2 and so on\n\n"
+		<< "\t- \"restore\"\n"
+		<< "\t\t-- restores the mass spring systems from a snapshot written by \"save\"\n"
+		<< "\t\t-- 1 parameter: file name given to \"save\"\n\n"
+		<< "\t- \"record\"\n"
+		<< "\t\t-- records the positions of the mass spring systems after every frame to a compressed trajectory\n"
+		<< "\t\t-- 1 parameter: file name, one per system as with \"save\"\n\n"
+		<< "\t- \"record_stop\"\n"
+		<< "\t\t-- finishes the trajectories being recorded\n"
+		<< "\t\t-- no parameters\n\n";
 }
 
 void CmdHandler::handleKeyBoardInput(int cKey, int iAction, int iMods)
@@ -620,6 +659,95 @@ bool CmdHandler::exec_SetThresholdMax()
 	return bReturnVal;
 }
 
+// Sets the number of threads the Mass Spring Systems update with.
+bool CmdHandler::exec_SetThreads()
+{
+	char c_Num[ MAX_INPUT_SIZE ] = {};
+	char* pEnd;
+	long lTempVal;
+	int iErr = get_Next_Word( c_Num, MAX_INPUT_SIZE );
+	bool bReturnVal = false;
+
+	if ( ERR_CODE != iErr )
+	{
+		lTempVal = strtol( c_Num, &pEnd, NUM_BASE );
+		if ( checkRange( (float)lTempVal, 0.0f, FLT_MAX ) )
+			m_pEnvMngr->setMassSpringThreads( (int)lTempVal );
+	}
+	else
+	{
+		cout << "Error reading in value: \"" << c_Num << "\".\n";
+		bReturnVal = true;
+	}
+
+	return bReturnVal;
+}
+
+// Sets the rate the simulation thread steps the Mass Spring Systems at.
+bool CmdHandler::exec_SetSimRate()
+{
+	char c_Num[ MAX_INPUT_SIZE ] = {};
+	char* p_End;
+	float fTempVal;
+	bool bReturnVal = false;
+	int iErr = get_Next_Word( c_Num, MAX_INPUT_SIZE );
+
+	if ( ERR_CODE != iErr )
+	{
+		fTempVal = strtof( c_Num, &p_End );
+		if ( checkRange( fTempVal, FLT_MIN, FLT_MAX ) )
+			m_pEnvMngr->setSimulationRate( fTempVal );
+	}
+	else
+	{
+		cout << "Error reading in value: \"" << c_Num << "\".\n";
+		bReturnVal = true;
+	}
+
+	return bReturnVal;
+}
+
+// Saves or restores a snapshot of the Mass Spring Systems.
+bool CmdHandler::exec_Snapshot( bool bRestore )
+{
+	char c_FileName[ MAX_INPUT_SIZE ] = {};
+	bool bReturnVal = false;
+	int iErr = get_Next_Word( c_FileName, MAX_INPUT_SIZE );
+
+	if ( ERR_CODE != iErr && iErr > 0 )
+	{
+		if ( bRestore )
+			m_pEnvMngr->restoreMassSpring( string( c_FileName ) );
+		else
+			m_pEnvMngr->saveMassSpring( string( c_FileName ) );
+	}
+	else
+	{
+		cout << "Error reading in file name: \"" << c_FileName << "\".\n";
+		bReturnVal = true;
+	}
+
+	return bReturnVal;
+}
+
+// Starts recording a trajectory of the Mass Spring Systems.
+bool CmdHandler::exec_Record()
+{
+	char c_FileName[ MAX_INPUT_SIZE ] = {};
+	bool bReturnVal = false;
+	int iErr = get_Next_Word( c_FileName, MAX_INPUT_SIZE );
+
+	if ( ERR_CODE != iErr && iErr > 0 )
+		m_pEnvMngr->recordMassSpring( string( c_FileName ) );
+	else
+	{
+		cout << "Error reading in file name: \"" << c_FileName << "\".\n";
+		bReturnVal = true;
+	}
+
+	return bReturnVal;
+}
+
 // Checks the range of a floating point value between a given Min and Max.
 // Returns true if value is in range
 //         false otherwise
@@ -633,4 +761,4 @@ bool CmdHandler::checkRange(float fVal, float fMIN, float fMAX)
 			<< fMAX << "." << endl;
 
 	return !bNotInRange;
-}
\ No newline at end of file
+}
\ No newline at end of file
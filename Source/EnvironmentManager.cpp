@@ -3,7 +3,7 @@
 
 #define INTERSECTION_EPSILON 1e-4	// Minimum intersect distance (so we don't intersect with ourselves)
 #define MAX_REFLECTIONS	800
-#define MAX_SPRING_PARAMS 12
+#define QUERY_GROUP 64				// Rays of a batch looked up in the broadphase together
 
 // Initialize Static Instance Variable
 EnvironmentManager* EnvironmentManager::m_pInstance = nullptr;
@@ -15,7 +15,11 @@ EnvironmentManager::EnvironmentManager()
 	m_fMaxEdgeThreshold = 360.0f;
 	m_bPause = false;
 
-	m_pSpringSystem = nullptr;
+	m_bCollidersDirty = true;
+	m_bCollidersAnimated = false;
+	m_iColliderChanges = 0;
+	m_vChangedMin = vec3( FLT_MAX );
+	m_vChangedMax = vec3( -FLT_MAX );
 }
 
 // Gets the instance of the environment manager.
@@ -39,76 +43,187 @@ void EnvironmentManager::initializeEnvironment(string sFileName)
 
 	purgeEnvironment();
 	pObjFctry->loadFromFile(sFileName);
+
+	// The systems step on their own thread from here on
+	if ( !m_pSpringSystems.empty() )
+	{
+		m_sSimThread.setPaused( m_bPause );
+		m_sSimThread.start( [ this ]() { stepMassSpring(); }, m_sSimThread.getRate() );
+	}
 }
 
-void EnvironmentManager::initializeMassSpringSystem(vector< string > sData, int iLength)
+// Adds a Mass Spring System built from a mass_spring block to the scene; it collides against this environment.
+//	Every mass_spring block of a scene adds its own system.
+void EnvironmentManager::addMassSpringSystem(vector< string > sData, int iLength)
 {
-	// Local Variables
-	SpringType eType = SpringType::SPRING;
+	MassSpringSystem* pNewSystem = MassSpringSystem::createFromScene(sData);
 
-	if (iLength == MAX_SPRING_PARAMS)
+	if (nullptr != pNewSystem)
 	{
-		if (nullptr != m_pSpringSystem)
-			delete m_pSpringSystem;
-
-		int iLength = stoi(sData[0]);
-		int iDepth = stoi(sData[1]);
-		int iHeight = stoi(sData[2]);
-
-		// Ensure minimum of 1
-		if (iLength < 1)
-			iLength = 1;
-		if (iDepth < 1)
-			iDepth = 1;
-		if (iHeight < 1)
-			iHeight = 1;
-
-		// Get type of Mass Spring
-		if ("cube" == sData[11])
-			eType = SpringType::CUBE;
-		else if ("cloth" == sData[11])
-			eType = SpringType::CLOTH;
-		else if ("chain" == sData[11])
-			eType = SpringType::CHAIN;
-		else if ("flag" == sData[11])
-			eType = SpringType::FLAG;
-
-		// Generate new System
-		m_pSpringSystem = new MassSpringSystem(stof(sData[3]/*K*/),
-			stof(sData[4]/*RestLength*/),
-			stof(sData[5]/*Mass*/),
-			stof(sData[6]/*damping_coeff*/),
-			stof(sData[7]/*delta_t*/),
-			stoi(sData[8]/*Loop_Count*/),
-			stof(sData[9]/*Collision_K*/),
-			stof(sData[10]/*Collision_Damping_Coeff*/));
-		m_pSpringSystem->initialize(iLength, iHeight, iDepth, eType);
+		pNewSystem->setEnvironment(this);
+		m_pSpringSystems.push_back(pNewSystem);
+		m_pSpringRenderers.push_back(new MassSpringRenderer(pNewSystem));
 	}
-	else
-		cout << "Error: Not enough parameters for Spring System initialization.\n";
 }
 
-// Get Look at if an object is focued.
+// Get Look at if an object is focued: the first Mass Spring System.
 vec3 EnvironmentManager::getLookAt()
 {
 	vec3 vReturn = vec3(0.0);
 
-	if (nullptr != m_pSpringSystem)
-		vReturn = m_pSpringSystem->getCenter();
+	if (!m_pSpringSystems.empty())
+		vReturn = m_pSpringSystems.front()->getCenter();
 
 	return vReturn;
 }
 
+// Pauses or resumes the Mass Spring Systems and the animated objects.
+void EnvironmentManager::pause()
+{
+	m_bPause = !m_bPause;
+	m_sSimThread.setPaused( m_bPause );
+}
+
+// Steps every Mass Spring System by a frame, paused or not: on the simulation thread once it's running.
 void EnvironmentManager::updateMassSpring()
 {
-	if( nullptr != m_pSpringSystem )
-		m_pSpringSystem->update();
+	if ( m_sSimThread.isRunning() )
+		m_sSimThread.requestStep();
+	else
+		stepMassSpring();
+}
+
+// Updates every Mass Spring System by a frame and publishes their positions for the renderers.  The animated
+//	objects move first, then the broadphase is brought up to date once for all of the systems, which are then
+//	stepped at the same time (see MassSpringSystem::updateSystems).
+void EnvironmentManager::stepMassSpring()
+{
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
+	animateObjects();
+
+	if( !m_pSpringSystems.empty() )
+	{
+		updateColliders();
+		MassSpringSystem::updateSystems( m_pSpringSystems );
+
+		for ( unsigned int i = 0; i < m_pSpringSystems.size(); ++i )
+			m_pSpringSystems[ i ]->publishPositions();
+
+		for ( unsigned int i = 0; i < m_pRecorders.size(); ++i )
+			m_pRecorders[ i ]->record( m_pSpringSystems[ i ]->getPositions() );
+	}
+}
+
+// Moves every animated object a frame along its Animation Track; each publishes its frame for drawing.
+void EnvironmentManager::animateObjects()
+{
+	for ( unsigned int i = 0; i < m_pObjects.size(); ++i )
+	{
+		if ( nullptr != m_pObjects[ i ] && m_pObjects[ i ]->isAnimated() )
+			m_pObjects[ i ]->animate();
+	}
+}
+
+// Saves a snapshot of every Mass Spring System between two frames (see MassSpringSystem::getSnapshotName).
+void EnvironmentManager::saveMassSpring( const string& sFileName )
+{
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
+	for ( unsigned int i = 0; i < m_pSpringSystems.size(); ++i )
+		m_pSpringSystems[ i ]->saveSnapshot( MassSpringSystem::getSnapshotName( sFileName, i ) );
+
+	if ( m_pSpringSystems.empty() )
+		cout << "Error: No Mass Spring System loaded.\n";
+}
+
+// Restores every Mass Spring System from the snapshot saveMassSpring wrote.  The renderer of each system
+//	restored is rebuilt for its springs.  A recording ends first: the frames after the restore wouldn't
+//	follow from the ones before.
+void EnvironmentManager::restoreMassSpring( const string& sFileName )
+{
+	stopRecording();
+
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
+	for ( unsigned int i = 0; i < m_pSpringSystems.size(); ++i )
+	{
+		if ( m_pSpringSystems[ i ]->loadSnapshot( MassSpringSystem::getSnapshotName( sFileName, i ) ) )
+		{
+			delete m_pSpringRenderers[ i ];
+			m_pSpringRenderers[ i ] = new MassSpringRenderer( m_pSpringSystems[ i ] );
+		}
+	}
+
+	if ( m_pSpringSystems.empty() )
+		cout << "Error: No Mass Spring System loaded.\n";
+}
+
+// Starts recording the positions of every Mass Spring System after each frame, a trajectory per system named
+//	as snapshots are (see MassSpringSystem::getSnapshotName).  Replaces the recording in progress, if any.
+void EnvironmentManager::recordMassSpring( const string& sFileName )
+{
+	stopRecording();
+
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
+	for ( unsigned int i = 0; i < m_pSpringSystems.size(); ++i )
+	{
+		m_pRecorders.push_back( new TrajectoryRecorder() );
+		m_pRecorders.back()->open( MassSpringSystem::getSnapshotName( sFileName, i ),
+								   m_pSpringSystems[ i ]->getNumMasses() );
+	}
+
+	if ( m_pSpringSystems.empty() )
+		cout << "Error: No Mass Spring System loaded.\n";
+}
+
+// Finishes the trajectories being recorded.  The frames still queued are written out before this returns.
+void EnvironmentManager::stopRecording()
+{
+	vector< TrajectoryRecorder* > pRecorders;
+
+	// The recorders are closed without holding up the simulation thread
+	{
+		lock_guard< mutex > lSimulation( m_mSimulation );
+		pRecorders.swap( m_pRecorders );
+	}
+
+	for ( unsigned int i = 0; i < pRecorders.size(); ++i )
+	{
+		if ( pRecorders[ i ]->close() && pRecorders[ i ]->getBytesWritten() > 0 )
+			cout << "Recorded " << pRecorders[ i ]->getFrameCount() << " frames, "
+				 << pRecorders[ i ]->getBytesWritten() << " bytes.\n";
+		delete pRecorders[ i ];
+	}
+}
+
+// Frames per second the simulation thread steps the Mass Spring Systems at.
+void EnvironmentManager::setSimulationRate( float fRate )
+{
+	m_sSimThread.setRate( fRate );
+}
+
+// Sets the number of threads every Mass Spring System updates with; with several systems, the number
+//	of systems updated at once.
+void EnvironmentManager::setMassSpringThreads( int iNumThreads )
+{
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
+	for ( unsigned int i = 0; i < m_pSpringSystems.size(); ++i )
+		m_pSpringSystems[ i ]->setThreadCount( iNumThreads );
+
+	if ( m_pSpringSystems.empty() )
+		cout << "Error: No Mass Spring System loaded.\n";
 }
 
 // Adds object to back of List
 void EnvironmentManager::addObject( Object3D* pNewObject )
 {
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
 	m_pObjects.push_back( pNewObject );
+	m_bCollidersDirty = true;
 }
 
 // Adds a Light to back of List
@@ -120,6 +235,7 @@ void EnvironmentManager::addLight( Light* pNewLight )
 // Remove Object from List with given ID
 void EnvironmentManager::killObject( long lID )
 {
+	lock_guard< mutex > lSimulation( m_mSimulation );
 	unsigned int i = 0;
 
 	// Iterate to find Object
@@ -132,6 +248,7 @@ void EnvironmentManager::killObject( long lID )
 		swap( m_pObjects[i], m_pObjects.back() );
 		delete m_pObjects.back();
 		m_pObjects.pop_back();
+		m_bCollidersDirty = true;
 	}
 }
 
@@ -156,6 +273,9 @@ void EnvironmentManager::killLight( long lID )
 // Outputs all the objects in the environment for debugging.
 void EnvironmentManager::listEnvironment()
 {
+	// Animated objects are moved by the simulation thread
+	lock_guard< mutex > lSimulation( m_mSimulation );
+
 	cout << "Environment:" << endl;
 	for ( vector<Object3D*>::iterator pIter = m_pObjects.begin();
 		  pIter != m_pObjects.end();
@@ -173,6 +293,10 @@ void EnvironmentManager::listEnvironment()
 // Clears out the entire environment
 void EnvironmentManager::purgeEnvironment()
 {
+	// Nothing can be stepping the systems while they're deleted
+	m_sSimThread.stop();
+	stopRecording();
+
 	// Clean Up objects
 	for ( vector<Object3D*>::iterator pIter = m_pObjects.begin();
 		  pIter != m_pObjects.end();
@@ -194,12 +318,18 @@ void EnvironmentManager::purgeEnvironment()
 	// Clear the array of Dangling pointers
 	m_pObjects.clear();
 	m_pLights.clear();
+	m_pColliders.clear();
+	m_sCollisionBVH.clear();
+	m_bCollidersDirty = true;
 
-	if (nullptr != m_pSpringSystem)
-	{
-		delete m_pSpringSystem;
-		m_pSpringSystem = nullptr;
-	}
+	for ( unsigned int i = 0; i < m_pSpringRenderers.size(); ++i )
+		delete m_pSpringRenderers[ i ];
+
+	for ( unsigned int i = 0; i < m_pSpringSystems.size(); ++i )
+		delete m_pSpringSystems[ i ];
+
+	m_pSpringRenderers.clear();
+	m_pSpringSystems.clear();
 }
 
 // Fetch the Frenet Frame of the first MeshObject found (Hack for assignment)
@@ -213,7 +343,7 @@ mat4 EnvironmentManager::getFrenetFrame()
 	{
 		if ( !(*pObjIter)->getType().compare( "MeshObject" ) )
 		{
-			pReturnVal = (*pObjIter)->getFreNetFrames();
+			pReturnVal = (*pObjIter)->getPublishedFrame();
 			break;
 		}
 	}
@@ -228,6 +358,12 @@ void EnvironmentManager::renderEnvironment( const vec3& vCamLookAt )
 	ShaderManager* pShdrMngr = ShaderManager::getInstance();
 	vec3 pLightPosition;
 
+	// Animated objects move with the frames of the simulation thread and are drawn at the frame they last
+	//	published, so nothing here waits on a step.  Without the thread (no Mass Spring System), they move
+	//	with the frames drawn.
+	if ( !m_bPause && !m_sSimThread.isRunning() )
+		stepMassSpring();
+
 	// Calculate information for each Light in the scene (Current max = 1)
 	for (vector<Light*>::iterator pLightIter = m_pLights.begin();
 		pLightIter != m_pLights.end();
@@ -252,7 +388,9 @@ void EnvironmentManager::renderEnvironment( const vec3& vCamLookAt )
 
 	m_pLights[0]->draw( vCamLookAt, m_fMinEdgeThreshold, m_fMaxEdgeThreshold, m_bPause );
 
-	m_pSpringSystem->draw(vCamLookAt, m_bPause);
+	// The simulation thread updates the systems; draw what it last published
+	for ( unsigned int i = 0; i < m_pSpringRenderers.size(); ++i )
+		m_pSpringRenderers[ i ]->draw(vCamLookAt);
 }
 
 /*********************************************************************************\
@@ -311,24 +449,90 @@ Object* EnvironmentManager::getObject( long lID )
 	return pReturnObj;
 }
 
+// Brings the collision broadphase up to date with the objects.  Called before the Mass Spring System updates
+//	since the collision queries of its threads only read the tree.  A change is only counted when an object was
+//	added or removed or one of the animated objects actually moved, along with the box around the bounds it
+//	touched: the old bounds of every object and the new ones after a rebuild, those of the objects that moved
+//	after a refit.
+void EnvironmentManager::updateColliders()
+{
+	vec3 vMin, vMax, vChangedMin( FLT_MAX ), vChangedMax( -FLT_MAX );
+
+	if ( m_bCollidersDirty )
+	{
+		for ( unsigned int i = 0; i < m_pColliders.size(); ++i )
+		{
+			vChangedMin = min( vChangedMin, m_vColliderMin[ i ] );
+			vChangedMax = max( vChangedMax, m_vColliderMax[ i ] );
+		}
+
+		m_pColliders.clear();
+		m_vColliderMin.clear();
+		m_vColliderMax.clear();
+		m_bCollidersAnimated = false;
+
+		for ( vector< Object3D* >::const_iterator iter = m_pObjects.begin(); iter != m_pObjects.end(); ++iter )
+		{
+			if ( nullptr != (*iter) && (*iter)->getBounds( vMin, vMax ) )
+			{
+				m_pColliders.push_back( *iter );
+				m_vColliderMin.push_back( vMin );
+				m_vColliderMax.push_back( vMax );
+				m_bCollidersAnimated |= (*iter)->isAnimated();
+				vChangedMin = min( vChangedMin, vMin );
+				vChangedMax = max( vChangedMax, vMax );
+			}
+		}
+
+		m_sCollisionBVH.build( m_vColliderMin, m_vColliderMax );
+		m_bCollidersDirty = false;
+		m_vChangedMin = vChangedMin;
+		m_vChangedMax = vChangedMax;
+		++m_iColliderChanges;
+	}
+	else if ( m_bCollidersAnimated )
+	{
+		for ( unsigned int i = 0; i < m_pColliders.size(); ++i )
+		{
+			if ( m_pColliders[ i ]->isAnimated() && m_pColliders[ i ]->getBounds( vMin, vMax )
+				 && (vMin != m_vColliderMin[ i ] || vMax != m_vColliderMax[ i ]) )
+			{
+				vChangedMin = min( vChangedMin, min( vMin, m_vColliderMin[ i ] ) );
+				vChangedMax = max( vChangedMax, max( vMax, m_vColliderMax[ i ] ) );
+				m_vColliderMin[ i ] = vMin;
+				m_vColliderMax[ i ] = vMax;
+			}
+		}
+
+		// Nothing moved: a paused track or one that's holding still
+		if ( vChangedMin.x <= vChangedMax.x )
+		{
+			m_sCollisionBVH.refit( m_vColliderMin, m_vColliderMax );
+			m_vChangedMin = vChangedMin;
+			m_vChangedMax = vChangedMax;
+			++m_iColliderChanges;
+		}
+	}
+}
+
 // Given a Ray and starting position, check for a collision against all 3D objects in the environment.
-// Can be modified and sped up using simplified bounding for complex objects and graphing of objects for
-//	quicker culling of impossible collisions
+//	Only objects whose bounds overlap the box swept by the ray are tested (see updateColliders).
 float EnvironmentManager::checkCollision(const vec3& vPos, const vec3& vRay, vec3& vIntersectingNormal)
 {
 	// Local Variables
 	float fReturnT = FLT_MAX;
 	float fT;
 	vec3 vReturnNormal = vIntersectingNormal; // Save return normal in event no collision is detected
+	vec3 vRayMin, vRayMax;
+
+	BoundingVolumeHierarchy::getRayBounds( vPos, vRay, vRayMin, vRayMax );
 
-	// Iterate through and check collisions
-	for (vector< Object3D* >::const_iterator iter = m_pObjects.begin();
-		iter != m_pObjects.end();
-		++iter)
+	// Iterate through the candidates and check collisions
+	m_sCollisionBVH.query( vRayMin, vRayMax, [ & ]( unsigned int iCollider )
 	{
 		// Found a Collision? Returns a T value for the ray at point of intersection
 		// Also returns a normal of the intersection.
-		if ((*iter)->isCollision(vPos, vRay, fT, vIntersectingNormal))
+		if (m_pColliders[iCollider]->isCollision(vPos, vRay, fT, vIntersectingNormal))
 		{
 			// want the closest (first collision), do not want a collision behind the ray.
 			if (fT >= 0.0 && fT < fReturnT)
@@ -337,7 +541,7 @@ float EnvironmentManager::checkCollision(const vec3& vPos, const vec3& vRay, vec
 				vReturnNormal = vIntersectingNormal;
 			}
 		}
-	}
+	} );
 
 	// Return closest intersecting normal
 	vIntersectingNormal = vReturnNormal;
@@ -345,3 +549,51 @@ float EnvironmentManager::checkCollision(const vec3& vPos, const vec3& vRay, vec
 	// Return T
 	return fReturnT;
 }
+
+// Batched checkCollision: the batch is split into groups of QUERY_GROUP consecutive rays, and every object
+//	whose bounds overlap the box swept by a group tests all of the group's rays in one call, so the virtual
+//	dispatch happens once per object and group instead of once per ray.  Callers pass masses in their
+//	storage order, which keeps the rays of a group close together (see MassOrdering) and the box small
+//	enough to cull like a single ray.  Objects are keyed by their ID.
+void EnvironmentManager::checkCollisions( const vec3* pPos, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+										  unsigned int* pObject )
+{
+	vec3 vRayMin, vRayMax;
+
+	for ( unsigned int i = 0; i < iCount; ++i )
+		pT[ i ] = FLT_MAX;
+
+	for ( unsigned int iFirst = 0; iFirst < iCount; iFirst += QUERY_GROUP )
+	{
+		unsigned int iGroup = std::min( iCount - iFirst, (unsigned int)QUERY_GROUP );
+
+		BoundingVolumeHierarchy::getRayBounds( pPos + iFirst, pRay + iFirst, iGroup, vRayMin, vRayMax );
+		m_sCollisionBVH.query( vRayMin, vRayMax, [ & ]( unsigned int iCollider )
+		{
+			m_pColliders[ iCollider ]->findCollisions( pPos + iFirst, pRay + iFirst, iGroup, pT + iFirst, pNormal + iFirst,
+													   pObject + iFirst, (unsigned int)m_pColliders[ iCollider ]->ID() );
+		} );
+	}
+}
+
+// Objects are keyed by their ID, see checkCollisions.
+bool EnvironmentManager::hasObject( unsigned int iObject ) const
+{
+	for ( unsigned int i = 0; i < m_pColliders.size(); ++i )
+		if ( (unsigned int)m_pColliders[ i ]->ID() == iObject )
+			return true;
+
+	return false;
+}
+
+// Distance to the closest bounds in the broadphase of an object that isn't ignored.  Valid until the colliders
+//	are next updated, so for the rest of the frame.
+float EnvironmentManager::getClearance( const vec3& vPos, const unsigned int* pIgnore, unsigned int iIgnoreCount )
+{
+	return m_sCollisionBVH.getDistance( vPos, [ & ]( unsigned int iCollider )
+	{
+		unsigned int iObject = (unsigned int)m_pColliders[ iCollider ]->ID();
+
+		return find( pIgnore, pIgnore + iIgnoreCount, iObject ) == pIgnore + iIgnoreCount;
+	} );
+}
@@ -0,0 +1,294 @@
+#include "ImplicitEulerSolver.h"
+#include "MassSpringSystem.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_CG_ITERATIONS 100
+#define DEFAULT_CG_TOLERANCE 1e-3f		// Relative to the norm of the right hand side
+#define REDUCTION_BLOCK 1024			// Masses per partial sum of a deterministic dot product
+
+// Default Constructor
+ImplicitEulerSolver::ImplicitEulerSolver( MassSpringSystem* pSystem )
+{
+	m_pSystem = pSystem;
+	m_iMaxIterations = DEFAULT_CG_ITERATIONS;
+	m_iLastIterations = 0;
+	m_fTolerance = DEFAULT_CG_TOLERANCE;
+}
+
+// Destructor
+ImplicitEulerSolver::~ImplicitEulerSolver()
+{
+	m_pSystem = nullptr;
+}
+
+// Sizes the solver vectors; the system's spring adjacency has to be built already so every product
+//	can be computed as an independent gather per mass.
+void ImplicitEulerSolver::initialize()
+{
+	unsigned int iNumMasses = m_pSystem->m_sMasses.size();
+	unsigned int iNumSprings = m_pSystem->m_sSprings.size();
+
+	m_vSpringForce.assign( iNumSprings, vec3( 0.0f ) );
+	m_mSpringStiffness.assign( iNumSprings, mat3( 0.0f ) );
+	m_vDeltaV.assign( iNumMasses, vec3( 0.0f ) );
+	m_vResidual.assign( iNumMasses, vec3( 0.0f ) );
+	m_vDirection.assign( iNumMasses, vec3( 0.0f ) );
+	m_vProduct.assign( iNumMasses, vec3( 0.0f ) );
+	m_vPreconditioner.assign( iNumMasses, vec3( 0.0f ) );
+	m_vPrecResidual.assign( iNumMasses, vec3( 0.0f ) );
+	m_vBlockSums.assign( (iNumMasses + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK, 0.0 );
+}
+
+// Sum of a[i] . b[i] over the masses, accumulated in double.  The OpenMP reduction adds the threads' sums
+//	in whatever order they finish; deterministic systems sum fixed blocks of REDUCTION_BLOCK masses instead,
+//	then add the block sums in order on one thread.
+double ImplicitEulerSolver::dotProduct( const vec3* pA, const vec3* pB, int iCount, int iNumThreads )
+{
+	int iNumBlocks = (iCount + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+	double dSum = 0.0;
+
+	if ( m_pSystem->m_bDeterministic )
+	{
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int b = 0; b < iNumBlocks; ++b )
+		{
+			int iEnd = std::min( iCount, (b + 1) * REDUCTION_BLOCK );
+			double dBlockSum = 0.0;
+
+			for ( int i = b * REDUCTION_BLOCK; i < iEnd; ++i )
+				dBlockSum += dot( pA[ i ], pB[ i ] );
+			m_vBlockSums[ b ] = dBlockSum;
+		}
+
+		for ( int b = 0; b < iNumBlocks; ++b )
+			dSum += m_vBlockSums[ b ];
+	}
+	else
+	{
+		#pragma omp parallel for reduction( +: dSum ) num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int i = 0; i < iCount; ++i )
+			dSum += dot( pA[ i ], pB[ i ] );
+	}
+
+	return dSum;
+}
+
+// One backward Euler step:
+//	1. Elastic force and stiffness block of every spring at the current positions.
+//	2. Total force per mass (springs, damping, gravity, collision) and the right hand side.
+//	3. Preconditioned CG for the velocity change.
+//	4. v += dv, x += h * v.
+void ImplicitEulerSolver::step( float fDeltaT )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	int iNumThreads = m_pSystem->m_iNumThreads;
+	int iNumMasses = (int)sMasses.size();
+	vec3* pPosition = sMasses.m_vPosition.data();
+	vec3* pVelocity = sMasses.m_vVelocity.data();
+	vec3* pForce = sMasses.m_vForce.data();
+	const vec3* pDeltaV = m_vDeltaV.data();
+
+	computeSprings( iNumThreads );
+	assembleForces( fDeltaT, iNumThreads );
+	solve( fDeltaT, iNumThreads );
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		if ( !sMasses.isFixed( m ) )
+		{
+			pVelocity[ m ] += pDeltaV[ m ];
+			pPosition[ m ] += pVelocity[ m ] * fDeltaT;
+			pForce[ m ] = vec3( 0.0f );
+		}
+	}
+}
+
+// Elastic force on the first mass of each spring and its stiffness block:
+//	K = k * (n n^T + max(0, 1 - r / l) * (I - n n^T))
+//	The transverse term is dropped for compressed springs so K (and the system matrix) stays definite.
+void ImplicitEulerSolver::computeSprings( int iNumThreads )
+{
+	const MassSpringSystem::Springs& sSprings = m_pSystem->m_sSprings;
+	const vec3* pPosition = m_pSystem->m_sMasses.m_vPosition.data();
+	float fK = m_pSystem->m_fK;
+	int iNumSprings = (int)sSprings.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int s = 0; s < iNumSprings; ++s )
+	{
+		vec3 vD12 = pPosition[ sSprings.m_iMass2[ s ] ] - pPosition[ sSprings.m_iMass1[ s ] ];
+		float fLength = length( vD12 );
+
+		if ( fLength > 0.0f )
+		{
+			vec3 vDir = vD12 / fLength;
+			mat3 mDirDir = outerProduct( vDir, vDir );
+			float fTransverse = 1.0f - (sSprings.m_fRestLength[ s ] / fLength);
+
+			m_vSpringForce[ s ] = vDir * (fK * (fLength - sSprings.m_fRestLength[ s ]));
+			m_mSpringStiffness[ s ] = fK * (mDirDir + (fTransverse > 0.0f ? fTransverse : 0.0f) * (mat3( 1.0f ) - mDirDir));
+		}
+		else // No direction; stiffen isotropically
+		{
+			m_vSpringForce[ s ] = vec3( 0.0f );
+			m_mSpringStiffness[ s ] = mat3( fK );
+		}
+	}
+}
+
+// Gathers the spring forces onto each mass then adds damping, gravity and collision like the explicit
+//	integrator (any self collision force is already in the mass's force).  Fills the right hand side h * (f - h * K v) into the residual and the Jacobi preconditioner.
+//	Masses in contact also get the collision penalty in the matrix, otherwise its stiffness limits the step.
+//	The penalty is evaluated at the position predicted with the previous velocity change, so the K v term
+//	for it only corrects for that prediction.
+void ImplicitEulerSolver::assembleForces( float fDeltaT, int iNumThreads )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	const MassSpringSystem::ContactCache& sContacts = m_pSystem->m_sContacts;
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	const vec3* pVelocity = sMasses.m_vVelocity.data();
+	vec3* pForce = sMasses.m_vForce.data();
+	float fDeltaT2 = fDeltaT * fDeltaT;
+	int iNumMasses = (int)sMasses.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		vec3 vForce( 0.0f ), vStiffnessV, vDiagonal( 0.0f );
+
+		if ( sMasses.isFixed( m ) )
+		{
+			m_vResidual[ m ] = m_vPreconditioner[ m ] = m_vDeltaV[ m ] = vec3( 0.0f );
+			continue;
+		}
+
+		for ( unsigned int a = sAdjacency.m_vOffsets[ m ]; a < sAdjacency.m_vOffsets[ m + 1 ]; ++a )
+		{
+			unsigned int s = sAdjacency.m_vSpring[ a ];
+			const mat3& mK = m_mSpringStiffness[ s ];
+
+			vForce += (m_pSystem->m_sSprings.m_iMass1[ s ] == (unsigned int)m) ? m_vSpringForce[ s ] : -m_vSpringForce[ s ];
+			vDiagonal += vec3( mK[ 0 ][ 0 ], mK[ 1 ][ 1 ], mK[ 2 ][ 2 ] );
+		}
+
+		// New contacts are looked for along v * h; existing ones are kept until the mass itself is back out.
+		pForce[ m ] += vForce;		// On top of any self collision force
+		m_pSystem->applyMassForces( m );
+		unsigned int iKept = m_pSystem->checkCollision( m, vec3( 0.0f ), pVelocity[ m ] * fDeltaT );
+
+		applyStiffness( m, pVelocity, vStiffnessV );
+
+		for ( unsigned int c = 0; c < sContacts.getCount( m ); ++c )
+		{
+			const vec3& vNormal = sContacts.m_vNormal[ sContacts.getEntry( m, c ) ];
+
+			vDiagonal += m_pSystem->m_fCollisionK * (vNormal * vNormal);
+			if ( c < iKept )
+				vStiffnessV += vNormal * (m_pSystem->m_fCollisionK * dot( vNormal, pVelocity[ m ] ));
+		}
+
+		m_vResidual[ m ] = fDeltaT * (pForce[ m ] - fDeltaT * vStiffnessV);
+		m_vPreconditioner[ m ] = 1.0f / (vec3( getMassDamping( m, fDeltaT ) ) + fDeltaT2 * vDiagonal);
+	}
+}
+
+// Sum of K_s * (in[m] - in[other]) over the springs around a mass.
+void ImplicitEulerSolver::applyStiffness( unsigned int iMass, const vec3* pIn, vec3& vOut ) const
+{
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	vOut = vec3( 0.0f );
+
+	for ( unsigned int a = sAdjacency.m_vOffsets[ iMass ]; a < sAdjacency.m_vOffsets[ iMass + 1 ]; ++a )
+		vOut += m_mSpringStiffness[ sAdjacency.m_vSpring[ a ] ] * (pIn[ iMass ] - pIn[ sAdjacency.m_vMass[ a ] ]);
+}
+
+// Diagonal of M + h*C for a mass: its mass, spring damping and collision damping if colliding.
+float ImplicitEulerSolver::getMassDamping( unsigned int iMass, float fDeltaT ) const
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	float fDamping = m_pSystem->m_fMassDamping[ iMass ] + (sMasses.isColliding( iMass ) ? m_pSystem->m_fCollisionDamp : 0.0f);
+
+	return 1.0f / sMasses.m_fInvMass[ iMass ] + fDeltaT * fDamping;
+}
+
+// out = (M + h*C - h^2*K) in, with the rows of fixed masses filtered to 0.
+void ImplicitEulerSolver::multiply( const vec3* pIn, vec3* pOut, float fDeltaT, int iNumThreads )
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	const MassSpringSystem::ContactCache& sContacts = m_pSystem->m_sContacts;
+	float fDeltaT2 = fDeltaT * fDeltaT;
+	int iNumMasses = (int)sMasses.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		vec3 vStiffness;
+
+		if ( sMasses.isFixed( m ) )
+			pOut[ m ] = vec3( 0.0f );
+		else
+		{
+			applyStiffness( m, pIn, vStiffness );
+
+			// Collision penalty along each contact normal
+			for ( unsigned int c = 0; c < sContacts.getCount( m ); ++c )
+			{
+				const vec3& vNormal = sContacts.m_vNormal[ sContacts.getEntry( m, c ) ];
+				vStiffness += vNormal * (m_pSystem->m_fCollisionK * dot( vNormal, pIn[ m ] ));
+			}
+
+			pOut[ m ] = getMassDamping( m, fDeltaT ) * pIn[ m ] + fDeltaT2 * vStiffness;
+		}
+	}
+}
+
+// Jacobi preconditioned conjugate gradient for the velocity change.  Warm starts from the previous
+//	step's solution and stops once |r| <= tolerance * |b|.  Returns the final relative residual.
+float ImplicitEulerSolver::solve( float fDeltaT, int iNumThreads )
+{
+	int iNumMasses = (int)m_vDeltaV.size();
+	double dRHS, dResidual, dRZ, dAlpha, dBeta, dNewRZ;
+
+	// r = b - A * dv
+	dRHS = dotProduct( m_vResidual.data(), m_vResidual.data(), iNumMasses, iNumThreads );
+	multiply( m_vDeltaV.data(), m_vProduct.data(), fDeltaT, iNumThreads );
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		m_vResidual[ m ] -= m_vProduct[ m ];
+		m_vDirection[ m ] = m_vPrecResidual[ m ] = m_vPreconditioner[ m ] * m_vResidual[ m ];
+	}
+
+	dRZ = dotProduct( m_vResidual.data(), m_vPrecResidual.data(), iNumMasses, iNumThreads );
+	dResidual = dotProduct( m_vResidual.data(), m_vResidual.data(), iNumMasses, iNumThreads );
+	double dThreshold = (double)m_fTolerance * m_fTolerance * dRHS;
+
+	for ( m_iLastIterations = 0; m_iLastIterations < m_iMaxIterations && dResidual > dThreshold; ++m_iLastIterations )
+	{
+		multiply( m_vDirection.data(), m_vProduct.data(), fDeltaT, iNumThreads );
+		dAlpha = dRZ / dotProduct( m_vDirection.data(), m_vProduct.data(), iNumMasses, iNumThreads );
+
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int m = 0; m < iNumMasses; ++m )
+		{
+			m_vDeltaV[ m ] += (float)dAlpha * m_vDirection[ m ];
+			m_vResidual[ m ] -= (float)dAlpha * m_vProduct[ m ];
+			m_vPrecResidual[ m ] = m_vPreconditioner[ m ] * m_vResidual[ m ];
+		}
+
+		dResidual = dotProduct( m_vResidual.data(), m_vResidual.data(), iNumMasses, iNumThreads );
+		dNewRZ = dotProduct( m_vResidual.data(), m_vPrecResidual.data(), iNumMasses, iNumThreads );
+		dBeta = dNewRZ / dRZ;
+		dRZ = dNewRZ;
+
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int m = 0; m < iNumMasses; ++m )
+			m_vDirection[ m ] = m_vPrecResidual[ m ] + (float)dBeta * m_vDirection[ m ];
+	}
+
+	return (dRHS > 0.0) ? (float)sqrt( dResidual / dRHS ) : 0.0f;
+}
@@ -0,0 +1,70 @@
+#include "MappedFile.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Maps the whole file for reading.  Failure leaves the object empty (see isOpen).
+MappedFile::MappedFile( const string& sFileName )
+{
+	m_pData = nullptr;
+	m_iSize = 0;
+
+#ifdef _WIN32
+	LARGE_INTEGER iSize;
+
+	m_hMapping = nullptr;
+	m_hFile = CreateFileA( sFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+						   FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+
+	if ( INVALID_HANDLE_VALUE != m_hFile && GetFileSizeEx( m_hFile, &iSize ) && iSize.QuadPart > 0 )
+	{
+		m_hMapping = CreateFileMappingA( m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if ( nullptr != m_hMapping )
+		{
+			m_pData = static_cast< const char* >( MapViewOfFile( m_hMapping, FILE_MAP_READ, 0, 0, 0 ) );
+			m_iSize = (nullptr != m_pData) ? (size_t)iSize.QuadPart : 0;
+		}
+	}
+#else
+	struct stat sStat;
+
+	m_iFile = open( sFileName.c_str(), O_RDONLY );
+
+	if ( m_iFile >= 0 && 0 == fstat( m_iFile, &sStat ) && sStat.st_size > 0 )
+	{
+		void* pData = mmap( nullptr, (size_t)sStat.st_size, PROT_READ, MAP_PRIVATE, m_iFile, 0 );
+
+		if ( MAP_FAILED != pData )
+		{
+			m_pData = static_cast< const char* >( pData );
+			m_iSize = (size_t)sStat.st_size;
+		}
+	}
+#endif
+}
+
+// Destructor: Unmaps and closes the file
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if ( nullptr != m_pData )
+		UnmapViewOfFile( m_pData );
+	if ( nullptr != m_hMapping )
+		CloseHandle( m_hMapping );
+	if ( INVALID_HANDLE_VALUE != m_hFile )
+		CloseHandle( m_hFile );
+#else
+	if ( nullptr != m_pData )
+		munmap( const_cast< char* >( m_pData ), m_iSize );
+	if ( m_iFile >= 0 )
+		close( m_iFile );
+#endif
+	m_pData = nullptr;
+}
@@ -0,0 +1,185 @@
+#include "MassSpringRenderer.h"
+#include "MassSpringSystem.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define FENCE_TIMEOUT 1000000		// Nanoseconds waited on a ring region's fence between checks
+
+// Whether buffers can be given immutable storage and stay mapped while they're drawn from
+//	(GL 4.4 or ARB_buffer_storage).
+static bool supportsBufferStorage()
+{
+	GLint iMajor = 0, iMinor = 0, iNumExtensions = 0;
+	bool bReturn;
+
+	glGetIntegerv( GL_MAJOR_VERSION, &iMajor );
+	glGetIntegerv( GL_MINOR_VERSION, &iMinor );
+	bReturn = iMajor > 4 || (4 == iMajor && iMinor >= 4);
+
+	glGetIntegerv( GL_NUM_EXTENSIONS, &iNumExtensions );
+	for ( GLint i = 0; !bReturn && i < iNumExtensions; ++i )
+		bReturn = !strcmp( (const char*)glGetStringi( GL_EXTENSIONS, i ), "GL_ARB_buffer_storage" );
+
+	return bReturn;
+}
+
+// Default Constructor: the springs don't change once the system is initialized, so each is uploaded once
+//	as a line between the indices of its two masses.
+MassSpringRenderer::MassSpringRenderer( const MassSpringSystem* pSystem )
+{
+	const MassSpringSystem::Springs& sSprings = pSystem->m_sSprings;
+	vector< unsigned int > vIndices( 2 * sSprings.size() );
+	GLsizeiptr iRegionSize;
+
+	m_pSystem = pSystem;
+	m_pShdrMngr = ShaderManager::getInstance();
+	m_iNumMasses = pSystem->getNumMasses();
+	m_iNumIndices = vIndices.size();
+	m_pMapped = nullptr;
+	m_iRingFrame = 0;
+
+	for ( unsigned int r = 0; r < RING_FRAMES; ++r )
+		m_pFences[ r ] = nullptr;
+
+	for ( unsigned int s = 0; s < sSprings.size(); ++s )
+	{
+		vIndices[ 2 * s ] = sSprings.m_iMass1[ s ];
+		vIndices[ 2 * s + 1 ] = sSprings.m_iMass2[ s ];
+	}
+
+	// Generate Vertex Array
+	glGenVertexArrays( 1, &m_iVertexArray );
+
+	// Set up the Position Ring: RING_FRAMES regions mapped for as long as the renderer lives, or a single
+	//	region re-specified every frame without buffer storage.
+	iRegionSize = m_iNumMasses * sizeof( vec3 );
+	m_bPersistent = supportsBufferStorage();
+
+	glBindVertexArray( m_iVertexArray );
+	glGenBuffers( 1, &m_iVertexBuffer );
+	glBindBuffer( GL_ARRAY_BUFFER, m_iVertexBuffer );
+
+	if ( m_bPersistent )
+	{
+		GLbitfield iFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+		glBufferStorage( GL_ARRAY_BUFFER, RING_FRAMES * iRegionSize, nullptr, iFlags );
+		m_pMapped = glMapBufferRange( GL_ARRAY_BUFFER, 0, RING_FRAMES * iRegionSize, iFlags );
+
+		// Storage can't be re-specified once it's immutable, so orphaning needs a buffer of its own
+		if ( nullptr == m_pMapped )
+		{
+			cout << "Warning: Unable to map the Mass Spring positions, falling back to orphaning.\n";
+			glDeleteBuffers( 1, &m_iVertexBuffer );
+			glGenBuffers( 1, &m_iVertexBuffer );
+			glBindBuffer( GL_ARRAY_BUFFER, m_iVertexBuffer );
+			m_bPersistent = false;
+		}
+	}
+
+	if ( !m_bPersistent )
+		glBufferData( GL_ARRAY_BUFFER, iRegionSize, nullptr, GL_STREAM_DRAW );
+
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+	glEnableVertexAttribArray( 0 );
+	glBindVertexArray( 0 );
+
+	m_iIndicesBuffer = m_pShdrMngr->genIndicesBuffer(
+		m_iVertexArray,
+		vIndices.data(),
+		vIndices.size() * sizeof( unsigned int ),
+		GL_STATIC_DRAW );
+}
+
+// Destructor: Cleanup GL handles
+MassSpringRenderer::~MassSpringRenderer()
+{
+	// Lose reference to Shader Manager and the System
+	m_pShdrMngr = nullptr;
+	m_pSystem = nullptr;
+
+	for ( unsigned int r = 0; r < RING_FRAMES; ++r )
+		if ( nullptr != m_pFences[ r ] )
+			glDeleteSync( m_pFences[ r ] );
+
+	if ( nullptr != m_pMapped )
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, m_iVertexBuffer );
+		glUnmapBuffer( GL_ARRAY_BUFFER );
+		m_pMapped = nullptr;
+	}
+
+	// Delete GL handles
+	glDeleteBuffers( 1, &m_iIndicesBuffer );
+	glDeleteBuffers( 1, &m_iVertexBuffer );
+	glDeleteVertexArrays( 1, &m_iVertexArray );
+}
+
+// Copies the latest published positions into the next region of the ring and returns the index of its
+//	first vertex.  The region was last drawn from RING_FRAMES frames ago, so its fence has normally been
+//	signalled already.  Without persistent mapping (or when the mapping failed), the buffer is orphaned instead: the driver hands back
+//	fresh storage rather than waiting on the draws still reading the old one.
+unsigned int MassSpringRenderer::uploadPositions()
+{
+	const aligned_vector< vec3 >& vPublished = m_pSystem->getPublishedPositions();
+	GLsizeiptr iRegionSize = m_iNumMasses * sizeof( vec3 );
+	unsigned int iBaseVertex = 0;
+
+	if ( m_bPersistent )
+	{
+		GLsync& pFence = m_pFences[ m_iRingFrame ];
+
+		if ( nullptr != pFence )
+		{
+			while ( GL_TIMEOUT_EXPIRED == glClientWaitSync( pFence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT ) )
+				;
+			glDeleteSync( pFence );
+			pFence = nullptr;
+		}
+
+		iBaseVertex = m_iRingFrame * m_iNumMasses;
+		memcpy( (char*)m_pMapped + m_iRingFrame * iRegionSize, vPublished.data(), iRegionSize );
+	}
+	else
+	{
+		glBindBuffer( GL_ARRAY_BUFFER, m_iVertexBuffer );
+		glBufferData( GL_ARRAY_BUFFER, iRegionSize, nullptr, GL_STREAM_DRAW );
+		glBufferSubData( GL_ARRAY_BUFFER, 0, iRegionSize, vPublished.data() );
+	}
+
+	return iBaseVertex;
+}
+
+// Draws the Mass Spring System from its latest published positions, so it never waits on an update
+//	in progress.  The points and the lines both read the region just written.
+void MassSpringRenderer::draw( const vec3& vCamLookAt )
+{
+	unsigned int iBaseVertex = uploadPositions();
+
+	// Set up Shader
+	glBindVertexArray( m_iVertexArray );
+	glUseProgram( m_pShdrMngr->getProgram( ShaderManager::eShaderType::WORLD_SHDR ) );
+	vec3 WHITE(0.75);
+	vec3 BLACK(0.0, 0.75, 1.0);
+
+	// Set color and draw Masses
+	m_pShdrMngr->setUniformVec3(ShaderManager::eShaderType::WORLD_SHDR, "vColor", &BLACK);
+	glPointSize( 7.5f );
+	glDrawArrays( GL_POINTS, iBaseVertex, m_iNumMasses );
+	glPointSize( 1.0f );
+
+	// Set Color and Draw Lines
+	m_pShdrMngr->setUniformVec3(ShaderManager::eShaderType::WORLD_SHDR, "vColor", &WHITE);
+	glDrawElementsBaseVertex( GL_LINES, m_iNumIndices, GL_UNSIGNED_INT, nullptr, iBaseVertex );
+
+	// The region can be written again once these draws are done with it
+	if ( m_bPersistent )
+	{
+		m_pFences[ m_iRingFrame ] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+		m_iRingFrame = (m_iRingFrame + 1) % RING_FRAMES;
+	}
+
+	glUseProgram( 0 );
+	glBindVertexArray( 0 );
+}
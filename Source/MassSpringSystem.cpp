@@ -1,12 +1,35 @@
 #pragma once
 #include "MassSpringSystem.h"
-#include "EnvironmentManager.h"
+#include "MappedFile.h"
+#include <chrono>
+#include <climits>
+#include <cmath>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /***********\
  * DEFINES *
 \***********/
 #define DEFAULT_START_POS vec3( 0.0, 10.0f, 0.0f )
 #define GRAVITY -9.81
+#define MORTON_BITS 21				// Bits per axis that fit in a 64-bit Morton code
+#define LATTICE_SPRINGS_2D 4		// Max springs generated per mass for a single layer lattice
+#define LATTICE_SPRINGS_3D 13		// Max springs generated per mass for a multi-layer lattice
+#define DEFAULT_STEP_TOLERANCE 0.001f	// Adaptive substeps: position error per substep, fraction of the shortest spring
+#define DEFAULT_STEP_LOG_FRAMES 60	// Frames between adaptive substep reports
+#define STEP_CFL 0.25f				// Fraction of the shortest spring a mass may travel in one substep
+#define STEP_STABILITY 0.5f			// Fraction of the explicit stability limit 2 / omega taken per substep
+#define STEP_GROWTH 2.0f			// Largest change of the substep size from one substep to the next
+#define STEP_SHRINK 0.2f
+#define DEFAULT_SLEEP_ENERGY 1e-4f	// Kinetic energy (and change in strain energy) per unit mass an island sleeps under
+#define DEFAULT_SLEEP_FRAMES 30		// Frames an island has to stay under the sleep energy
+#define SLEEP_WAKE_DISTANCE 2.0f	// Sleeping masses wake once an object comes this many shortest springs close
+#define ENVIRONMENT_UNSEEN UINT_MAX	// Change count before the sleeping masses have looked at the environment
+#define SNAPSHOT_MAGIC 0x5353534du		// "MSSS" as written by a little-endian machine
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_ALIGNMENT 64			// Arrays start on a cache line of the file, as they do in memory
+#define MAX_SPRING_PARAMS 12			// l depth h k restLength mass damping_coeff delta_t update_loop_count Collision_K Collision_Damping_Coeff type
 
 const vec3 vGRAVITY = vec3(0.0f, GRAVITY, 0.0f);
 
@@ -24,71 +47,104 @@ MassSpringSystem::MassSpringSystem( float fK, float fRestLength, float fMass,
 	m_iLoopCount = iLoopCount;
 	m_fCollisionK = fCollision_K;
 	m_fCollisionDamp = fCollision_Damp;
-	m_vShdrMngr = ShaderManager::getInstance();
+	m_eOrdering = ORDER_LATTICE;
+	m_vStartPos = DEFAULT_START_POS;
+	m_iNumThreads = 1;
+	m_bDeterministic = false;
+	m_eKernel = SpringKernels::getBestKernel();
+	m_pSpringKernel = SpringKernels::getKernel( m_eKernel );
+	m_eIntegrator = EXPLICIT_EULER;
+	m_pImplicitSolver = new ImplicitEulerSolver( this );
+	m_pXPBDSolver = new XPBDSolver( this );
+	m_pProjectiveSolver = new ProjectiveDynamicsSolver( this );
+	m_pSelfCollision = new SelfCollision( this );
+	m_bSelfCollision = false;
+	m_bAdaptiveSteps = false;
+	m_fStepTolerance = DEFAULT_STEP_TOLERANCE;
+	m_fFrameBudget = 0.0f;
+	m_fAdaptiveDeltaT = m_fDeltaT;
+	m_fStableDeltaT = m_fStableContactDeltaT = FLT_MAX;
+	m_fMinRestLength = m_fRestLength;
+	m_iStepLogFrames = DEFAULT_STEP_LOG_FRAMES;
+	resetStepLog();
+	m_bSleep = false;
+	m_fSleepEnergy = DEFAULT_SLEEP_ENERGY;
+	m_iSleepFrames = DEFAULT_SLEEP_FRAMES;
+	m_iEnvironmentChanges = 0;
+	m_pEnvironment = nullptr;
+	m_iStepCount = 0;
+}
 
-	// Generate Vertex Array
-	glGenVertexArrays( 1, &m_iVertexArray );
+// Destructor: Cleanup any allocated memory
+MassSpringSystem::~MassSpringSystem()
+{
+	// Lose reference to the collision environment
+	m_pEnvironment = nullptr;
 
-	// Set up GL_Buffers
-	m_iVertexBuffer = m_vShdrMngr->genVertexBuffer(
-		m_iVertexArray,
-		0, 3,
-		m_vPositions.data(),
-		m_vPositions.size() * sizeof( vec3 ),
-		GL_DYNAMIC_DRAW );
+	delete m_pImplicitSolver;
+	delete m_pXPBDSolver;
+	delete m_pProjectiveSolver;
+	delete m_pSelfCollision;
 
-	m_iNormalBuffer = m_vShdrMngr->genVertexBuffer(
-		m_iVertexArray,
-		1, 3,
-		m_vNormals.data(),
-		m_vNormals.size() * sizeof( vec3 ),
-		GL_STATIC_DRAW );
+	// Clear Mass Arrays
+	m_sMasses.clear();
 
-	m_iIndicesBuffer = m_vShdrMngr->genIndicesBuffer(
-		m_iVertexArray,
-		m_vIndices.data(),
-		m_vIndices.size() * sizeof( unsigned int ),
-		GL_STATIC_DRAW );
+	// Free Spring Data Space
+	m_sSprings.clear();
 }
 
-// Destructor: Cleanup any allocated memory
-MassSpringSystem::~MassSpringSystem()
+// Parses a mass_spring block: l depth h k restLength mass damping_coeff delta_t update_loop_count
+//	Collision_K Collision_Damping_Coeff type [option value ...], then initializes the new system.
+MassSpringSystem* MassSpringSystem::createFromScene( const vector< string >& sData )
 {
-	// Lose reference to Shader Manager
-	m_vShdrMngr = nullptr;
-
-	// Delete GL handles
-	glDeleteBuffers( 1, &m_iNormalBuffer );
-	glDeleteBuffers( 1, &m_iIndicesBuffer );
-	glDeleteBuffers( 1, &m_iVertexBuffer );
-	glDeleteVertexArrays( 1, &m_iVertexArray );
+	// Local Variables
+	SpringType eType = SpringType::SPRING;
+	MassSpringSystem* pReturnSystem = nullptr;
 
-	// Delete Masses -> delete each one individually and clear vector of pointers
-	if (!m_vMasses.empty())
+	if (sData.size() >= MAX_SPRING_PARAMS)
 	{
-		for (vector< PointMass* >::iterator iter = m_vMasses.begin();
-			iter != m_vMasses.end();
-			++iter)
-			delete *iter;
+		int iLength = stoi(sData[0]);
+		int iDepth = stoi(sData[1]);
+		int iHeight = stoi(sData[2]);
 
-		m_vMasses.clear();
-	}
+		// Ensure minimum of 1
+		if (iLength < 1)
+			iLength = 1;
+		if (iDepth < 1)
+			iDepth = 1;
+		if (iHeight < 1)
+			iHeight = 1;
 
-	// Free Spring Data Space
-	if (!m_vSprings.empty())
-	{
-		for (vector< Spring* >::iterator iter = m_vSprings.begin();
-			iter != m_vSprings.end();
-			++iter)
-			delete *iter;
+		// Get type of Mass Spring
+		if ("cube" == sData[11])
+			eType = SpringType::CUBE;
+		else if ("cloth" == sData[11])
+			eType = SpringType::CLOTH;
+		else if ("chain" == sData[11])
+			eType = SpringType::CHAIN;
+		else if ("flag" == sData[11])
+			eType = SpringType::FLAG;
 
-		m_vSprings.clear();
+		// Generate new System
+		pReturnSystem = new MassSpringSystem(stof(sData[3]/*K*/),
+			stof(sData[4]/*RestLength*/),
+			stof(sData[5]/*Mass*/),
+			stof(sData[6]/*damping_coeff*/),
+			stof(sData[7]/*delta_t*/),
+			stoi(sData[8]/*Loop_Count*/),
+			stof(sData[9]/*Collision_K*/),
+			stof(sData[10]/*Collision_Damping_Coeff*/));
+
+		// Apply any optional "name value" pairs following the type
+		for (unsigned int i = MAX_SPRING_PARAMS; i + 1 < sData.size(); i += 2)
+			pReturnSystem->setOption(sData[i], sData[i + 1]);
+
+		pReturnSystem->initialize(iLength, iHeight, iDepth, eType);
 	}
+	else
+		cout << "Error: Not enough parameters for Spring System initialization.\n";
 
-	// Clear Vectors
-	m_vIndices.clear();
-	m_vPositions.clear();
-	m_vNormals.clear();
+	return pReturnSystem;
 }
 
 // Initialization function for the Mass Spring System
@@ -108,15 +164,19 @@ void MassSpringSystem::initialize( int iLength, int iHeight, int iDepth, SpringT
 	int iLxH = iLength * iHeight;
 	float fScaledMass = m_fMass / (iLxH * iDepth);
 	bool bFixed = false;
-	vec3 vStartPos = DEFAULT_START_POS;
+	vec3 vStartPos = m_vStartPos;
+
+	// Allocate all masses and springs up front so the arrays stay contiguous
+	m_sMasses.reserve( iLxH * iDepth );
+	m_sSprings.reserve( iLxH * iDepth * (iDepth > 1 ? LATTICE_SPRINGS_3D : LATTICE_SPRINGS_2D) );
 
 	// Store a center position for Camera to focus on.
-	m_vCenter = vec3(DEFAULT_START_POS.x + (((float)iLength / 2.0f) * m_fRestLength),
-					 DEFAULT_START_POS.y - (((float)iHeight / 2.0f) * m_fRestLength),
-					 DEFAULT_START_POS.z + (((float)iDepth / 2.0f) * m_fRestLength));
+	m_vCenter = vec3(m_vStartPos.x + (((float)iLength / 2.0f) * m_fRestLength),
+					 m_vStartPos.y - (((float)iHeight / 2.0f) * m_fRestLength),
+					 m_vStartPos.z + (((float)iDepth / 2.0f) * m_fRestLength));
 
 	if (eType == SpringType::SPRING || eType == SpringType::CHAIN)
-		m_vCenter = DEFAULT_START_POS;
+		m_vCenter = m_vStartPos;
 
 	// Generate PointMasses and Springs
 	for ( int z = 0; z < iDepth; ++z )
@@ -129,17 +189,17 @@ void MassSpringSystem::initialize( int iLength, int iHeight, int iDepth, SpringT
 			for ( int x = 0; x < iLength; ++x )
 			{
 				// Gen PointMass
-				m_vMasses.push_back( new PointMass( fScaledMass, vStartPos, bFixed ) );
+				m_sMasses.add( fScaledMass, vStartPos, bFixed );
 
 				if (eType == FLAG && !x && !z)
-					m_vMasses.back()->m_bFixed = true;
+					m_sMasses.fix( m_sMasses.size() - 1 );
 
 				int iLengthOffset = iTotalOffset + x;
 
 				// Create springs attached to this new point
 				//* Along the x-Chain
 				if (x)
-					m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - 1], m_vMasses[iLengthOffset]));
+					m_sSprings.add(m_sMasses, iLengthOffset - 1, iLengthOffset);
 				//*/
 
 				//* Along the y-chain
@@ -147,13 +207,13 @@ void MassSpringSystem::initialize( int iLength, int iHeight, int iDepth, SpringT
 				{
 					//* Cross along xy-plane
 					if (x)
-						m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLength - 1], m_vMasses[iLengthOffset]));
+						m_sSprings.add(m_sMasses, iLengthOffset - iLength - 1, iLengthOffset);
 					if ((x + 1) < iLength)
-						m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLength + 1], m_vMasses[iLengthOffset]));
+						m_sSprings.add(m_sMasses, iLengthOffset - iLength + 1, iLengthOffset);
 					//*/
 
 					//* Along Y-Axis
-					m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLength], m_vMasses[iLengthOffset]));
+					m_sSprings.add(m_sMasses, iLengthOffset - iLength, iLengthOffset);
 					//*/
 				}
 
@@ -164,38 +224,38 @@ void MassSpringSystem::initialize( int iLength, int iHeight, int iDepth, SpringT
 					{
 						//* Cross along 3D Diagonal front to back
 						if( x ) // along xy-diagonal
-							m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH - iLength - 1], m_vMasses[iLengthOffset]));
+							m_sSprings.add(m_sMasses, iLengthOffset - iLxH - iLength - 1, iLengthOffset);
 						if( iLength > (x + 1) )
-							m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH - iLength + 1], m_vMasses[iLengthOffset]));
+							m_sSprings.add(m_sMasses, iLengthOffset - iLxH - iLength + 1, iLengthOffset);
 						//*/
 					}
 
 					//* Along Z
-					m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH], m_vMasses[iLengthOffset]));
+					m_sSprings.add(m_sMasses, iLengthOffset - iLxH, iLengthOffset);
 					//*/
 
 					if( iHeight > ( y + 1 ) )
 					{
 						//* Cross along 3D Diagonal back to front
 						if( x )
-							m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH + iLength - 1], m_vMasses[iLengthOffset]));
+							m_sSprings.add(m_sMasses, iLengthOffset - iLxH + iLength - 1, iLengthOffset);
 						if( iLength > (x + 1) )
-							m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH + iLength + 1], m_vMasses[iLengthOffset]));
+							m_sSprings.add(m_sMasses, iLengthOffset - iLxH + iLength + 1, iLengthOffset);
 						//*/
 					}
 
 					//* Cross along xz-Plane
 					if (x) // along x
-						m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH - 1], m_vMasses[iLengthOffset]));
+						m_sSprings.add(m_sMasses, iLengthOffset - iLxH - 1, iLengthOffset);
 					if( iLength > (x + 1) )
-							m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH + 1], m_vMasses[iLengthOffset]));
+							m_sSprings.add(m_sMasses, iLengthOffset - iLxH + 1, iLengthOffset);
 					//*/
 
 					//* Cross along yz-Plane
 					if( iHeight > (y + 1) )
-						m_vSprings.push_back( new Spring( m_vMasses[iLengthOffset - iLxH + iLength], m_vMasses[iLengthOffset]));
+						m_sSprings.add(m_sMasses, iLengthOffset - iLxH + iLength, iLengthOffset);
 					if ( y )
-						m_vSprings.push_back(new Spring(m_vMasses[iLengthOffset - iLxH - iLength], m_vMasses[iLengthOffset]));
+						m_sSprings.add(m_sMasses, iLengthOffset - iLxH - iLength, iLengthOffset);
 					//*/
 				}
 
@@ -203,180 +263,1754 @@ void MassSpringSystem::initialize( int iLength, int iHeight, int iDepth, SpringT
 				vStartPos.x += m_fRestLength;
 			}
 			//cout << endl;
-			vStartPos.x = DEFAULT_START_POS.x;
+			vStartPos.x = m_vStartPos.x;
 			vStartPos.y -= m_fRestLength;
 		}
-		vStartPos.y = DEFAULT_START_POS.y;
+		vStartPos.y = m_vStartPos.y;
 		vStartPos.z += m_fRestLength;
 	}
 
 	// Apply Fixed Specifications
 	if( eType != CUBE )
-		m_vMasses.front()->m_bFixed = true;
+		m_sMasses.fix( 0 );
 	if (eType == CLOTH)
-		m_vMasses[iLength - 1]->m_bFixed = true;
+		m_sMasses.fix( iLength - 1 );
+
+	// Optionally lay masses and springs out for locality.
+	if ( ORDER_LATTICE != m_eOrdering )
+		reorderMasses( iLength, iHeight, iDepth );
+
+	// Group springs into independent sets for the parallel spring pass
+	colorSprings();
+	m_sContacts.resize( m_sMasses.size() );
+	prepareUpdate();
+	buildActiveSet();
+	m_sPublished.fill( m_sMasses.m_vPosition );
+	m_iStepCount = 0;
+}
+
+// Everything the update derives from the masses and springs.  Called by initialize and loadSnapshot.
+void MassSpringSystem::prepareUpdate()
+{
+	computeMassDamping();
+	computeStepBounds();
+	m_sQueries.resize( m_sMasses.size() );
+	m_sIslands.build( m_sSprings, m_sMasses );
+
+	if ( EXPLICIT_EULER != m_eIntegrator || m_bSelfCollision )
+		m_sAdjacency.build( m_sSprings, m_sMasses.size() );
+	if ( m_bSelfCollision )
+		m_pSelfCollision->initialize();
+	if ( IMPLICIT_EULER == m_eIntegrator )
+		m_pImplicitSolver->initialize();
+	else if ( XPBD == m_eIntegrator )
+		m_pXPBDSolver->initialize();
+	else if ( PROJECTIVE_DYNAMICS == m_eIntegrator )
+		m_pProjectiveSolver->initialize();
+}
+
+// Sets the number of threads used to update the system.  0 (or less) uses every available hardware thread.
+void MassSpringSystem::setThreadCount( int iNumThreads )
+{
+#ifdef _OPENMP
+	m_iNumThreads = (iNumThreads > 0) ? iNumThreads : omp_get_max_threads();
+#else
+	m_iNumThreads = 1;
+#endif
+}
+
+// Selects the spring force kernel.  Falls back to the best supported kernel if the CPU can't run
+//	the requested one; returns false in that case.
+bool MassSpringSystem::setKernel( SpringKernels::eKernelType eType )
+{
+	bool bReturnValue = SpringKernels::isSupported( eType );
+
+	if ( !bReturnValue )
+	{
+		cout << "Error: " << SpringKernels::getName( eType ) << " spring kernel is not supported on this CPU, using "
+			 << SpringKernels::getName( SpringKernels::getBestKernel() ) << ".\n";
+		eType = SpringKernels::getBestKernel();
+	}
+
+	m_eKernel = eType;
+	m_pSpringKernel = SpringKernels::getKernel( m_eKernel );
+
+	return bReturnValue;
 }
 
-// Draws the Mass Spring System
-void MassSpringSystem::draw( const vec3& vCamLookAt, bool m_bPause )
+// Sets an optional parameter of the system by name; specified as trailing "name value"
+//	pairs in the mass_spring block of a scene file.
+//	Options: order {lattice, morton, bfs} -> layout of masses and springs in memory (applied in initialize)
+//			 position x,y,z -> where the first mass of the lattice is generated (applied in initialize)
+//			 threads n -> number of threads to update with, 0 uses all hardware threads
+//			 deterministic {off, on} -> results don't depend on the thread count: the spring pass is split on fixed
+//				boundaries even on one thread, sums are reduced in a fixed order and the frame budget is ignored
+//			 kernel {auto, scalar, avx2, avx512} -> spring force kernel, auto picks the widest the CPU supports
+//			 integrator {explicit, implicit, xpbd, projective} -> time integration scheme (applied in initialize)
+//			 cg_iterations n -> max conjugate gradient iterations per implicit step
+//			 cg_tolerance f -> relative residual the implicit solve stops at
+//			 xpbd_iterations n -> constraint projection iterations per xpbd step
+//			 xpbd_solver {gauss_seidel, jacobi} -> how the xpbd constraints are iterated
+//			 pd_iterations n -> local/global iterations per projective dynamics step
+//			 timestep {fixed, adaptive} -> m_iLoopCount substeps of m_fDeltaT, or the same time in substeps sized to the state
+//			 step_tolerance f -> adaptive position error per substep as a fraction of the shortest spring
+//			 frame_budget ms -> adaptive wall-clock time per frame, 0 for no limit
+//			 step_log n -> frames between adaptive substep reports, 0 turns them off
+//			 self_collision {off, on} -> masses not connected by a spring collide with each other (applied in initialize)
+//			 self_collision_distance f -> distance masses are kept apart, 0 for half the shortest spring
+//			 sleep {off, on} -> islands of masses at rest stop being simulated until something wakes them
+//			 sleep_energy f -> kinetic energy per unit mass (and change in strain energy per frame) islands sleep under
+//			 sleep_frames n -> frames an island has to stay under the sleep energy before it sleeps
+// Returns false if the option or its value isn't recognized.
+bool MassSpringSystem::setOption( const string& sName, const string& sValue )
 {
-	// Only update if not paused
-	if( !m_bPause )
-		update();
+	bool bReturnValue = true;
 
-	// Set up Shader
-	glBindVertexArray( m_iVertexArray );
-	glUseProgram( m_vShdrMngr->getProgram( ShaderManager::eShaderType::WORLD_SHDR ) );
-	vec3 WHITE(0.75);
-	vec3 BLACK(0.0, 0.75, 1.0);
+	if ( "order" == sName )
+	{
+		if ( "lattice" == sValue )
+			m_eOrdering = ORDER_LATTICE;
+		else if ( "morton" == sValue )
+			m_eOrdering = ORDER_MORTON;
+		else if ( "bfs" == sValue )
+			m_eOrdering = ORDER_BFS;
+		else
+			bReturnValue = false;
+	}
+	else if ( "position" == sName )
+	{
+		vec3 vPosition;
+		char cEnd;
+
+		if ( (bReturnValue = (3 == sscanf( sValue.c_str(), "%f,%f,%f%c", &vPosition.x, &vPosition.y, &vPosition.z, &cEnd ))) )
+			m_vStartPos = vPosition;
+	}
+	else if ( "threads" == sName )
+	{
+		char* pEnd;
+		long lThreads = strtol( sValue.c_str(), &pEnd, 10 );
+
+		if ( (bReturnValue = ('\0' == *pEnd && lThreads >= 0)) )
+			setThreadCount( (int)lThreads );
+	}
+	else if ( "deterministic" == sName )
+	{
+		if ( "off" == sValue )
+			m_bDeterministic = false;
+		else if ( "on" == sValue )
+			m_bDeterministic = true;
+		else
+			bReturnValue = false;
+	}
+	else if ( "kernel" == sName )
+	{
+		if ( "auto" == sValue )
+			setKernel( SpringKernels::getBestKernel() );
+		else if ( "scalar" == sValue )
+			setKernel( SpringKernels::SCALAR_KERNEL );
+		else if ( "avx2" == sValue )
+			setKernel( SpringKernels::AVX2_KERNEL );
+		else if ( "avx512" == sValue )
+			setKernel( SpringKernels::AVX512_KERNEL );
+		else
+			bReturnValue = false;
+	}
+	else if ( "integrator" == sName )
+	{
+		if ( "explicit" == sValue )
+			m_eIntegrator = EXPLICIT_EULER;
+		else if ( "implicit" == sValue )
+			m_eIntegrator = IMPLICIT_EULER;
+		else if ( "xpbd" == sValue )
+			m_eIntegrator = XPBD;
+		else if ( "projective" == sValue )
+			m_eIntegrator = PROJECTIVE_DYNAMICS;
+		else
+			bReturnValue = false;
+	}
+	else if ( "cg_iterations" == sName )
+	{
+		char* pEnd;
+		long lIterations = strtol( sValue.c_str(), &pEnd, 10 );
+
+		if ( (bReturnValue = ('\0' == *pEnd && lIterations > 0)) )
+			m_pImplicitSolver->setMaxIterations( (unsigned int)lIterations );
+	}
+	else if ( "cg_tolerance" == sName )
+	{
+		char* pEnd;
+		float fTolerance = strtof( sValue.c_str(), &pEnd );
+
+		if ( (bReturnValue = ('\0' == *pEnd && fTolerance > 0.0f)) )
+			m_pImplicitSolver->setTolerance( fTolerance );
+	}
+	else if ( "xpbd_iterations" == sName )
+	{
+		char* pEnd;
+		long lIterations = strtol( sValue.c_str(), &pEnd, 10 );
+
+		if ( (bReturnValue = ('\0' == *pEnd && lIterations > 0)) )
+			m_pXPBDSolver->setIterations( (unsigned int)lIterations );
+	}
+	else if ( "xpbd_solver" == sName )
+	{
+		if ( "gauss_seidel" == sValue )
+			m_pXPBDSolver->setIterationType( XPBDSolver::GAUSS_SEIDEL );
+		else if ( "jacobi" == sValue )
+			m_pXPBDSolver->setIterationType( XPBDSolver::JACOBI );
+		else
+			bReturnValue = false;
+	}
+	else if ( "pd_iterations" == sName )
+	{
+		char* pEnd;
+		long lIterations = strtol( sValue.c_str(), &pEnd, 10 );
 
-	// Set color and draw Masses
-	m_vShdrMngr->setUniformVec3(ShaderManager::eShaderType::WORLD_SHDR, "vColor", &BLACK);
-	glBindBuffer( GL_ARRAY_BUFFER, m_iVertexBuffer );
-	glBufferData( GL_ARRAY_BUFFER, m_vPositions.size() * sizeof( vec3 ), m_vPositions.data(), GL_DYNAMIC_DRAW );
-	glPointSize( 7.5f );
-	glDrawArrays( GL_POINTS, 0, m_vPositions.size() );
-	glPointSize( 1.0f );
+		if ( (bReturnValue = ('\0' == *pEnd && lIterations > 0)) )
+			m_pProjectiveSolver->setIterations( (unsigned int)lIterations );
+	}
+	else if ( "timestep" == sName )
+	{
+		if ( "fixed" == sValue )
+			m_bAdaptiveSteps = false;
+		else if ( "adaptive" == sValue )
+			m_bAdaptiveSteps = true;
+		else
+			bReturnValue = false;
+	}
+	else if ( "step_tolerance" == sName )
+	{
+		char* pEnd;
+		float fTolerance = strtof( sValue.c_str(), &pEnd );
 
-	// Set Color and Draw Lines
-	m_vShdrMngr->setUniformVec3(ShaderManager::eShaderType::WORLD_SHDR, "vColor", &WHITE);
-	glBufferData(GL_ARRAY_BUFFER, m_vNormals.size() * sizeof(vec3), m_vNormals.data(), GL_DYNAMIC_DRAW);
-	glDrawArrays(GL_LINES, 0, m_vNormals.size());
+		if ( (bReturnValue = ('\0' == *pEnd && fTolerance > 0.0f)) )
+			m_fStepTolerance = fTolerance;
+	}
+	else if ( "frame_budget" == sName )
+	{
+		char* pEnd;
+		float fBudget = strtof( sValue.c_str(), &pEnd );
 
-	glUseProgram( 0 );
-	glBindVertexArray( 0 );
+		if ( (bReturnValue = ('\0' == *pEnd && fBudget >= 0.0f)) )
+			m_fFrameBudget = fBudget;
+	}
+	else if ( "step_log" == sName )
+	{
+		char* pEnd;
+		long lFrames = strtol( sValue.c_str(), &pEnd, 10 );
+
+		if ( (bReturnValue = ('\0' == *pEnd && lFrames >= 0)) )
+			m_iStepLogFrames = (unsigned int)lFrames;
+	}
+	else if ( "self_collision" == sName )
+	{
+		if ( "off" == sValue )
+			m_bSelfCollision = false;
+		else if ( "on" == sValue )
+			m_bSelfCollision = true;
+		else
+			bReturnValue = false;
+	}
+	else if ( "self_collision_distance" == sName )
+	{
+		char* pEnd;
+		float fDistance = strtof( sValue.c_str(), &pEnd );
+
+		if ( (bReturnValue = ('\0' == *pEnd && fDistance >= 0.0f)) )
+			m_pSelfCollision->setDistance( fDistance );
+	}
+	else if ( "sleep" == sName )
+	{
+		if ( "off" == sValue )
+		{
+			m_bSleep = false;
+			wake();
+		}
+		else if ( "on" == sValue )
+			m_bSleep = true;
+		else
+			bReturnValue = false;
+	}
+	else if ( "sleep_energy" == sName )
+	{
+		char* pEnd;
+		float fEnergy = strtof( sValue.c_str(), &pEnd );
+
+		if ( (bReturnValue = ('\0' == *pEnd && fEnergy >= 0.0f)) )
+			m_fSleepEnergy = fEnergy;
+	}
+	else if ( "sleep_frames" == sName )
+	{
+		char* pEnd;
+		long lFrames = strtol( sValue.c_str(), &pEnd, 10 );
+
+		if ( (bReturnValue = ('\0' == *pEnd && lFrames > 0)) )
+			m_iSleepFrames = (unsigned int)lFrames;
+	}
+	else
+		bReturnValue = false;
+
+	if ( !bReturnValue )
+		cout << "Error: Unknown Mass Spring option \"" << sName << " " << sValue << "\".\n";
+
+	return bReturnValue;
+}
+
+/*********************************************************************************\
+* Locality Reordering                                                            *
+\*********************************************************************************/
+
+// Spreads the lower 21 bits of a value out so there are two 0 bits between each bit.
+static unsigned long long expandMortonBits( unsigned long long iValue )
+{
+	iValue &= 0x1fffff;
+	iValue = (iValue | iValue << 32) & 0x1f00000000ffffULL;
+	iValue = (iValue | iValue << 16) & 0x1f0000ff0000ffULL;
+	iValue = (iValue | iValue << 8) & 0x100f00f00f00f00fULL;
+	iValue = (iValue | iValue << 4) & 0x10c30c30c30c30c3ULL;
+	iValue = (iValue | iValue << 2) & 0x1249249249249249ULL;
+	return iValue;
+}
+
+// Reorders the masses so that masses that are close in the lattice are close in memory, then
+//	remaps and sorts the springs by their first mass so the spring pass walks the mass arrays
+//	nearly sequentially.  Both orderings keep the first lattice mass at index 0.
+void MassSpringSystem::reorderMasses( int iLength, int iHeight, int iDepth )
+{
+	unsigned int iNumMasses = m_sMasses.size();
+	vector< unsigned int > vNewToOld;
+	vNewToOld.reserve( iNumMasses );
+
+	if ( ORDER_MORTON == m_eOrdering )
+	{
+		// Sort lattice indices by the Z-order code of their (x, y, z) lattice coordinate
+		vector< pair< unsigned long long, unsigned int > > vCodes( iNumMasses );
+		int iLxH = iLength * iHeight;
+
+		for ( unsigned int i = 0; i < iNumMasses; ++i )
+		{
+			unsigned long long iX = i % iLength;
+			unsigned long long iY = (i / iLength) % iHeight;
+			unsigned long long iZ = i / iLxH;
+
+			vCodes[ i ].first = expandMortonBits( iX ) | (expandMortonBits( iY ) << 1) | (expandMortonBits( iZ ) << 2);
+			vCodes[ i ].second = i;
+		}
+
+		sort( vCodes.begin(), vCodes.end() );
+
+		for ( unsigned int i = 0; i < iNumMasses; ++i )
+			vNewToOld.push_back( vCodes[ i ].second );
+	}
+	else // ORDER_BFS
+	{
+		// Build a compressed adjacency list of the spring graph
+		SpringAdjacency sAdjacency;
+		vector< bool > vVisited( iNumMasses, false );
+
+		sAdjacency.build( m_sSprings, iNumMasses );
+
+		// Breadth-first from each unvisited mass; vNewToOld doubles as the queue.
+		for ( unsigned int iRoot = 0; iRoot < iNumMasses; ++iRoot )
+		{
+			if ( vVisited[ iRoot ] )
+				continue;
+
+			vVisited[ iRoot ] = true;
+			vNewToOld.push_back( iRoot );
+
+			for ( unsigned int q = vNewToOld.size() - 1; q < vNewToOld.size(); ++q )
+			{
+				unsigned int iCurr = vNewToOld[ q ];
+				for ( unsigned int a = sAdjacency.m_vOffsets[ iCurr ]; a < sAdjacency.m_vOffsets[ iCurr + 1 ]; ++a )
+				{
+					unsigned int iNext = sAdjacency.m_vMass[ a ];
+					if ( !vVisited[ iNext ] )
+					{
+						vVisited[ iNext ] = true;
+						vNewToOld.push_back( iNext );
+					}
+				}
+			}
+		}
+	}
+
+	applyMassOrder( vNewToOld );
+}
+
+// Builds the list of springs around each mass with a counting sort over the spring end points.
+void MassSpringSystem::SpringAdjacency::build( const Springs& sSprings, unsigned int iNumMasses )
+{
+	unsigned int iNumSprings = sSprings.size();
+
+	m_vOffsets.assign( iNumMasses + 1, 0 );
+	m_vSpring.resize( iNumSprings * 2 );
+	m_vMass.resize( iNumSprings * 2 );
+
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		++m_vOffsets[ sSprings.m_iMass1[ s ] + 1 ];
+		++m_vOffsets[ sSprings.m_iMass2[ s ] + 1 ];
+	}
+	for ( unsigned int i = 0; i < iNumMasses; ++i )
+		m_vOffsets[ i + 1 ] += m_vOffsets[ i ];
+
+	vector< unsigned int > vFill( m_vOffsets.begin(), m_vOffsets.end() - 1 );
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		unsigned int iMass1 = sSprings.m_iMass1[ s ];
+		unsigned int iMass2 = sSprings.m_iMass2[ s ];
+
+		m_vSpring[ vFill[ iMass1 ] ] = s;
+		m_vMass[ vFill[ iMass1 ]++ ] = iMass2;
+		m_vSpring[ vFill[ iMass2 ] ] = s;
+		m_vMass[ vFill[ iMass2 ]++ ] = iMass1;
+	}
+}
+
+// Permutes every mass array by the given order (new index -> old index), then remaps
+//	the springs to the new indices and sorts them by (lower, higher) mass index.
+void MassSpringSystem::applyMassOrder( const vector< unsigned int >& vNewToOld )
+{
+	unsigned int iNumMasses = m_sMasses.size();
+	unsigned int iNumSprings = m_sSprings.size();
+	PointMasses sReordered;
+	vector< unsigned int > vOldToNew( iNumMasses );
+	vector< unsigned long long > vSpringKeys( iNumSprings );
+
+	// Gather masses into their new positions
+	sReordered.reserve( iNumMasses );
+	for ( unsigned int i = 0; i < iNumMasses; ++i )
+	{
+		unsigned int iOld = vNewToOld[ i ];
+		vOldToNew[ iOld ] = i;
+
+		sReordered.m_vPosition.push_back( m_sMasses.m_vPosition[ iOld ] );
+		sReordered.m_vVelocity.push_back( m_sMasses.m_vVelocity[ iOld ] );
+		sReordered.m_vForce.push_back( m_sMasses.m_vForce[ iOld ] );
+		sReordered.m_fInvMass.push_back( m_sMasses.m_fInvMass[ iOld ] );
+		sReordered.m_iFlags.push_back( m_sMasses.m_iFlags[ iOld ] );
+	}
+	swap( m_sMasses, sReordered );
+
+	// Remap springs so the lower index comes first, then sort by (first, second)
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		unsigned long long iMass1 = vOldToNew[ m_sSprings.m_iMass1[ s ] ];
+		unsigned long long iMass2 = vOldToNew[ m_sSprings.m_iMass2[ s ] ];
+		if ( iMass2 < iMass1 )
+			swap( iMass1, iMass2 );
+
+		m_sSprings.m_iMass1[ s ] = (unsigned int) iMass1;
+		m_sSprings.m_iMass2[ s ] = (unsigned int) iMass2;
+		vSpringKeys[ s ] = (iMass1 << 32) | iMass2;
+	}
+
+	vector< unsigned int > vSpringOrder( iNumSprings );
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+		vSpringOrder[ s ] = s;
+	sort( vSpringOrder.begin(), vSpringOrder.end(),
+		  [ &vSpringKeys ]( unsigned int iLHS, unsigned int iRHS ) { return vSpringKeys[ iLHS ] < vSpringKeys[ iRHS ]; } );
+
+	permuteSprings( vSpringOrder );
+}
+
+// Reorders the spring arrays by the given order (new index -> old index).
+void MassSpringSystem::permuteSprings( const vector< unsigned int >& vNewToOld )
+{
+	unsigned int iNumSprings = m_sSprings.size();
+	Springs sSorted;
+
+	sSorted.reserve( iNumSprings );
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		sSorted.m_iMass1.push_back( m_sSprings.m_iMass1[ vNewToOld[ s ] ] );
+		sSorted.m_iMass2.push_back( m_sSprings.m_iMass2[ vNewToOld[ s ] ] );
+		sSorted.m_fRestLength.push_back( m_sSprings.m_fRestLength[ vNewToOld[ s ] ] );
+	}
+	swap( m_sSprings, sSorted );
+}
+
+/*********************************************************************************\
+* Parallel Update                                                                *
+\*********************************************************************************/
+
+// Greedy edge coloring of the spring graph: each spring takes the lowest color not already used
+//	by a spring on either of its masses.  Springs are then grouped by color (keeping their relative
+//	order) and m_vColorOffsets marks where each color starts.  Lattices need at most 2 * 26 - 1 colors;
+//	anything that can't get one of the MAX_SPRING_COLORS is put in a serial bucket.
+void MassSpringSystem::colorSprings()
+{
+	unsigned int iNumSprings = m_sSprings.size();
+	unsigned int iNumColors = 0;
+	vector< unsigned long long > vUsedColors( m_sMasses.size(), 0 );
+	vector< unsigned int > vColors( iNumSprings ), vSpringOrder( iNumSprings );
+
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		unsigned int iMass1 = m_sSprings.m_iMass1[ s ];
+		unsigned int iMass2 = m_sSprings.m_iMass2[ s ];
+		unsigned long long iUsed = vUsedColors[ iMass1 ] | vUsedColors[ iMass2 ];
+		unsigned int iColor = 0;
+
+		while ( iColor < MAX_SPRING_COLORS && ((iUsed >> iColor) & 1ULL) )
+			++iColor;
+
+		if ( iColor < MAX_SPRING_COLORS )
+		{
+			vUsedColors[ iMass1 ] |= (1ULL << iColor);
+			vUsedColors[ iMass2 ] |= (1ULL << iColor);
+		}
+
+		vColors[ s ] = iColor;
+		iNumColors = (iColor + 1 > iNumColors) ? iColor + 1 : iNumColors;
+	}
+
+	// Counting sort of the springs by color
+	m_vColorOffsets.assign( iNumColors + 1, 0 );
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+		++m_vColorOffsets[ vColors[ s ] + 1 ];
+	for ( unsigned int c = 0; c < iNumColors; ++c )
+		m_vColorOffsets[ c + 1 ] += m_vColorOffsets[ c ];
+
+	vector< unsigned int > vFill( m_vColorOffsets.begin(), m_vColorOffsets.end() - 1 );
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+		vSpringOrder[ vFill[ vColors[ s ] ]++ ] = s;
+
+	permuteSprings( vSpringOrder );
+}
+
+// Spring damping acts on the velocity of each end point, so a mass attached to n springs is damped
+//	n times per substep.  Precomputing that per mass keeps the spring kernels purely elastic.
+void MassSpringSystem::computeMassDamping()
+{
+	m_fMassDamping.assign( m_sMasses.size(), 0.0f );
+
+	for ( unsigned int s = 0; s < m_sSprings.size(); ++s )
+	{
+		m_fMassDamping[ m_sSprings.m_iMass1[ s ] ] += m_fDamping_Coeff;
+		m_fMassDamping[ m_sSprings.m_iMass2[ s ] ] += m_fDamping_Coeff;
+	}
+}
+
+// Index of the calling thread within the current parallel region.
+static int getThreadIndex()
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
+// Number of threads in the current parallel region.
+static int getTeamSize()
+{
+#ifdef _OPENMP
+	return omp_get_num_threads();
+#else
+	return 1;
+#endif
+}
+
+// Splits [iFirst, iLast) evenly over the threads of the current parallel region and returns the
+//	calling thread's share.  The split only depends on the thread count.  Every share but the last ends a
+//	multiple of iAlignment after iFirst, so a kernel taking iAlignment items at a time from the start of its
+//	share meets the same groups, and the same remainder before iLast, whatever the thread count.
+static void getThreadRange( unsigned int iFirst, unsigned int iLast, unsigned int& iBegin, unsigned int& iEnd,
+							unsigned int iAlignment = 1 )
+{
+#ifdef _OPENMP
+	unsigned long long iCount = iLast - iFirst;
+	unsigned long long iThread = omp_get_thread_num();
+	unsigned long long iNumThreads = omp_get_num_threads();
+
+	iBegin = iFirst + (unsigned int)((iCount * iThread) / iNumThreads / iAlignment * iAlignment);
+	iEnd = (iThread + 1 == iNumThreads) ? iLast
+										 : iFirst + (unsigned int)((iCount * (iThread + 1)) / iNumThreads / iAlignment * iAlignment);
+#else
+	iBegin = iFirst;
+	iEnd = iLast;
+#endif
 }
 
 // Update the Mass Spring system by evaluating the force of every spring against its connected masses
+//	Explicit: each substep is split across m_iNumThreads threads: springs are processed one color at a time
+//	(springs of the same color share no masses) followed by the mass integration.  Deterministic: the
+//	colors are kept on a single thread too, so every mass sums its spring forces in the same order.
+//	Implicit: one backward Euler solve per substep; the solver parallelizes each of its passes.
+//	XPBD: one constraint projection step per substep.
+//	Projective Dynamics: local/global iterations against the prefactored system per substep.
+//	Adaptive: the same span of time (m_iLoopCount * m_fDeltaT) in substeps sized to the system's state.
+//	Self collision forces are added to the spring forces at the start of every substep, whatever the integrator.
+//	The clearance of every mass is measured once at the start of the frame, the objects don't move during it.
+//	Sleeping islands are woken first and quiet ones put to sleep last; a frame with every island asleep is skipped.
 void MassSpringSystem::update()
 {
-	// Calculat Direction both ways and Forces in both Directions
-	vec3 vD12, vD21, vF12, vF21;
+	wakeIslands();
+	if ( m_vActiveMasses.empty() )
+		return;
+
+	updateClearance();
+
+	// Projective dynamics would refactor its system for every new substep size, so it always takes fixed steps
+	if ( m_bAdaptiveSteps && PROJECTIVE_DYNAMICS != m_eIntegrator )
+		updateAdaptive();
+	else if ( EXPLICIT_EULER == m_eIntegrator ) // Apply this multiple times per update to give an accurate depiction of movement per frame at a small Delta_T
+		stepExplicit( m_iLoopCount, m_fDeltaT );
+	else
+	{
+		for ( unsigned int i = 0; i < m_iLoopCount; ++i )
+			step( m_fDeltaT );
+	}
+
+	sleepIslands();
+}
+
+// Independent systems don't share any data, only the environment they query, so a team of threads takes
+//	whole systems at a time: the largest first, then each thread takes the next one as it finishes its last.
+//	The team has the largest thread count among the systems.  Each system steps on one thread inside the
+//	team, its own parallel regions are nested and run serially; a single system uses its own threads.  The
+//	environment has to be up to date before the call, the queries only read it.
+void MassSpringSystem::updateSystems( const vector< MassSpringSystem* >& pSystems )
+{
+	vector< MassSpringSystem* > pOrder( pSystems );
+	int iNumThreads = 1;
+
+	if ( 1 == pSystems.size() )
+	{
+		pSystems.front()->update();
+		return;
+	}
+
+	for ( unsigned int i = 0; i < pSystems.size(); ++i )
+		iNumThreads = std::max( iNumThreads, pSystems[ i ]->m_iNumThreads );
+
+	std::stable_sort( pOrder.begin(), pOrder.end(), []( const MassSpringSystem* pA, const MassSpringSystem* pB )
+	{
+		return pA->m_sActiveSprings.size() + pA->m_vActiveMasses.size() > pB->m_sActiveSprings.size() + pB->m_vActiveMasses.size();
+	} );
+
+	#pragma omp parallel for schedule( dynamic, 1 ) num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int i = 0; i < (int)pOrder.size(); ++i )
+		pOrder[ i ]->update();
+}
 
-	// Apply this multiple times per update to give an accurate depiction of movement per frame at a small Delta_T
-	for( unsigned int i = 0; i < m_iLoopCount; ++i )
+// Advances the system by a single substep of fDeltaT with the selected integrator.
+void MassSpringSystem::step( float fDeltaT )
+{
+	if ( EXPLICIT_EULER == m_eIntegrator )
+		stepExplicit( 1, fDeltaT );
+	else
 	{
-		// Iterate over every spring
-		for (vector< Spring* >::iterator iter = m_vSprings.begin();
-			iter != m_vSprings.end();
-			++iter)
+		if ( m_bSelfCollision )
 		{
-			// Get Directions
-			vD12 = (*iter)->pPoint2->m_vPosition - (*iter)->pPoint1->m_vPosition;
-			vD21 = -vD12;
-
-			// Calculate Spring Force and apply along direction
-			float fSpring = m_fK * (length(vD12) - (*iter)->m_fRestLength);
-			vF12 = fSpring * normalize(vD12);
-			vF21 = fSpring * normalize(vD21);
-
-			// Add forces to points along with damping
-			(*iter)->pPoint1->m_vForce += vF12 - ((*iter)->pPoint1->m_vVelocity * m_fDamping_Coeff);
-			(*iter)->pPoint2->m_vForce += vF21 - ((*iter)->pPoint2->m_vVelocity * m_fDamping_Coeff);
+			#pragma omp parallel num_threads( m_iNumThreads ) if( m_iNumThreads > 1 )
+			m_pSelfCollision->accumulateForces();
 		}
 
-		// Apply Forces and update velocities and positions for Masses
-		for (vector< PointMass* >::iterator iter = m_vMasses.begin();
-			iter != m_vMasses.end();
-			++iter)
+		if ( IMPLICIT_EULER == m_eIntegrator )
+			m_pImplicitSolver->step( fDeltaT );
+		else if ( XPBD == m_eIntegrator )
+			m_pXPBDSolver->step( fDeltaT );
+		else if ( PROJECTIVE_DYNAMICS == m_eIntegrator )
+			m_pProjectiveSolver->step( fDeltaT );
+
+		++m_iStepCount;
+	}
+}
+
+// Runs iSteps explicit substeps of fDeltaT inside one parallel region, over the active springs and masses.
+void MassSpringSystem::stepExplicit( unsigned int iSteps, float fDeltaT )
+{
+	int iNumColors = (int)m_vActiveColorOffsets.size() - 1;
+
+	m_iStepCount += iSteps;
+
+	#pragma omp parallel num_threads( m_iNumThreads ) if( m_iNumThreads > 1 )
+	{
+		unsigned int iBegin, iEnd;
+		bool bSerial = (1 == getTeamSize()) && !m_bDeterministic;
+		unsigned int iAlignment = m_bDeterministic ? SPRING_KERNEL_MAX_WIDTH : 1;
+
+		for( int i = 0; i < (int)iSteps; ++i )
 		{
-			if (!(*iter)->m_bFixed)
+			// A single thread doesn't need the coloring; sweep every spring in one pass.
+			if( bSerial )
+				accumulateSpringForces( 0, m_sActiveSprings.size() );
+
+			// Iterate over every spring, one color at a time
+			for( int c = 0; c < iNumColors && !bSerial; ++c )
 			{
-				// Add Gravity and Collision Forces
-				(*iter)->m_vForce += vGRAVITY;
-				checkCollision( *(*iter) );
-
-				vec3 vAcceleration = (*iter)->m_vForce / (*iter)->m_fMass;		// Acceleration from Newton's 2nd Law F=ma
-				(*iter)->m_vVelocity += vAcceleration * m_fDeltaT;				// Velocity from definition
-				(*iter)->m_vPosition += (*iter)->m_vVelocity * m_fDeltaT;			// Position from definition
-				(*iter)->m_vForce = vec3(0.0f);									// reset Forces
+				if( c != SERIAL_SPRING_COLOR )
+					getThreadRange( m_vActiveColorOffsets[c], m_vActiveColorOffsets[c + 1], iBegin, iEnd, iAlignment );
+				else if( 0 == getThreadIndex() ) // Overflow springs couldn't be colored, run them on one thread
+				{
+					iBegin = m_vActiveColorOffsets[c];
+					iEnd = m_vActiveColorOffsets[c + 1];
+				}
+				else
+					iBegin = iEnd = 0;
+
+				accumulateSpringForces( iBegin, iEnd );
+				#pragma omp barrier
 			}
+
+			// Every thread takes part in the self collision pass, it ends on a barrier
+			if( m_bSelfCollision )
+				m_pSelfCollision->accumulateForces();
+
+			// Apply Forces and update velocities and positions for Masses
+			getThreadRange( 0, m_vActiveMasses.size(), iBegin, iEnd );
+			integrateMasses( iBegin, iEnd, fDeltaT );
+			#pragma omp barrier
 		}
 	}
+}
 
-	// Add Points and Lines for Drawing.
-	m_vPositions.clear();
-	m_vNormals.clear();
+// Adds the elastic force of active springs [iBegin, iEnd) to their connected masses using the selected kernel.
+//	Damping is applied per mass in integrateMasses.
+void MassSpringSystem::accumulateSpringForces( unsigned int iBegin, unsigned int iEnd )
+{
+	m_pSpringKernel( m_sActiveSprings.m_iMass1.data(), m_sActiveSprings.m_iMass2.data(), m_sActiveSprings.m_fRestLength.data(),
+					 iBegin, iEnd, m_sMasses.m_vPosition.data(), m_sMasses.m_vForce.data(), m_fK );
+}
 
-	for (vector< PointMass* >::const_iterator iter = m_vMasses.begin();
-		iter != m_vMasses.end();
-		++iter)
-		m_vPositions.push_back((*iter)->m_vPosition);
+// Applies the accumulated forces to active masses [iBegin, iEnd); updating velocities and positions.
+//	The active masses are free and in mass order, so each attribute array is still walked forwards.  New
+//	contacts are looked for along the next step of the masses whose clearance doesn't cover it, with a single
+//	batched query for the whole range.
+void MassSpringSystem::integrateMasses( unsigned int iBegin, unsigned int iEnd, float fDeltaT )
+{
+	vec3* pPosition = m_sMasses.m_vPosition.data();
+	vec3* pVelocity = m_sMasses.m_vVelocity.data();
+	vec3* pForce = m_sMasses.m_vForce.data();
+	const float* pInvMass = m_sMasses.m_fInvMass.data();
+	const unsigned int* pActive = m_vActiveMasses.data();
+	unsigned int iQueryEnd = iBegin;
 
-	for (vector< Spring* >::const_iterator iter = m_vSprings.begin();
-		iter != m_vSprings.end();
-		++iter)
+	// Add Spring Damping and Gravity, then gather the collision queries
+	for (unsigned int i = iBegin; i < iEnd; ++i)
 	{
-		m_vNormals.push_back((*iter)->pPoint1->m_vPosition);
-		m_vNormals.push_back((*iter)->pPoint2->m_vPosition);
+		unsigned int m = pActive[i];
+		applyMassForces( m );
+
+		vec3 vRay = (pVelocity[m] + pForce[m] * pInvMass[m] * fDeltaT) * fDeltaT;
+		if (needsQuery( m, pPosition[m], vRay ))
+		{
+			m_sQueries.m_iMass[iQueryEnd] = m;
+			m_sQueries.m_vStart[iQueryEnd] = pPosition[m];
+			m_sQueries.m_vRay[iQueryEnd] = vRay;
+			++iQueryEnd;
+		}
 	}
 
+	if (iQueryEnd > iBegin)
+		m_pEnvironment->checkCollisions( &m_sQueries.m_vStart[iBegin], &m_sQueries.m_vRay[iBegin], iQueryEnd - iBegin,
+										 &m_sQueries.m_fT[iBegin], &m_sQueries.m_vNormal[iBegin], &m_sQueries.m_iObject[iBegin] );
+
+	// Queries are in mass order, so the next one belongs to the next queried mass
+	unsigned int iQuery = iBegin;
+	for (unsigned int i = iBegin; i < iEnd; ++i)
+	{
+		unsigned int m = pActive[i];
+		vec3 vRay = (pVelocity[m] + pForce[m] * pInvMass[m] * fDeltaT) * fDeltaT;
+		vec3 vNormal( 0.0f );
+		unsigned int iObject = 0;
+		float fT = FLT_MAX;
+
+		if (iQuery < iQueryEnd && m == m_sQueries.m_iMass[iQuery])
+		{
+			fT = m_sQueries.m_fT[iQuery];
+			vNormal = m_sQueries.m_vNormal[iQuery];
+			iObject = m_sQueries.m_iObject[iQuery];
+			++iQuery;
+		}
+
+		// Add Collision Forces
+		resolveCollision( m, vRay, vRay, fT, iObject, vNormal );
+
+		vec3 vAcceleration = pForce[m] * pInvMass[m];		// Acceleration from Newton's 2nd Law F=ma
+		pVelocity[m] += vAcceleration * fDeltaT;			// Velocity from definition
+		pPosition[m] += pVelocity[m] * fDeltaT;				// Position from definition
+		pForce[m] = vec3(0.0f);								// reset Forces
+	}
+}
+
+// Adds the forces acting on a single mass on top of its spring forces: spring damping and gravity.
+void MassSpringSystem::applyMassForces( unsigned int iMass )
+{
+	m_sMasses.m_vForce[ iMass ] -= m_sMasses.m_vVelocity[ iMass ] * m_fMassDamping[ iMass ];
+	m_sMasses.m_vForce[ iMass ] += vGRAVITY;
+}
+
+// Position based solvers: velocity of a free mass after its accumulated force, gravity and spring damping
+//	over fDeltaT.  The damping is taken implicitly, v = (v + h * f / m) / (1 + h * c / m); small, heavily
+//	damped masses would reverse their velocity every step if it were applied as a force.
+void MassSpringSystem::integrateMassForces( unsigned int iMass, float fDeltaT )
+{
+	float fInvMass = m_sMasses.m_fInvMass[ iMass ];
+	vec3& vVelocity = m_sMasses.m_vVelocity[ iMass ];
+
+	vVelocity = (vVelocity + (m_sMasses.m_vForce[ iMass ] + vGRAVITY) * (fInvMass * fDeltaT))
+				/ (1.0f + m_fMassDamping[ iMass ] * fInvMass * fDeltaT);
+	m_sMasses.m_vForce[ iMass ] = vec3( 0.0f );
+}
+
+// Looks for a new contact along vRay if the mass is close enough to an object to reach one, then applies the
+//	collision forces (see resolveCollision).  Returns the number of contacts kept from before.
+unsigned int MassSpringSystem::checkCollision( unsigned int iMass, const vec3& vContactRay, const vec3& vRay )
+{
+	const vec3& vPosition = m_sMasses.m_vPosition[ iMass ];
+	vec3 vNormal( 0.0f );
+	unsigned int iObject = 0;
+	float fT = FLT_MAX;
+
+	if ( needsQuery( iMass, vPosition, vRay ) )
+		m_pEnvironment->checkCollisions( &vPosition, &vRay, 1, &fT, &vNormal, &iObject );
+
+	return resolveCollision( iMass, vContactRay, vRay, fT, iObject, vNormal );
 }
 
-// Checks General collision with xz-plane @ y = 0
-//	Testing: Was testing a table cloth; masses that fell off the side ended up stretching the cloth to infinity, not sure why.
-void MassSpringSystem::checkCollision( PointMass& pMass )
+// Penalty forces of the contacts of a mass.  Each contact pushes the mass back out along its normal with
+//	Collision_K times its depth behind the contact point, taken at the position moved by vContactRay, and is
+//	released once the mass is back in front of it.  Then the hit of the collision query along vRay (fT along the
+//	normalized ray to object iObject, FLT_MAX for none) becomes a new contact, taken at the position moved by
+//	vRay, unless the mass is already touching that object.  Collision_Damping_Coeff damps the velocity once
+//	while there's any contact.  Returns the number of contacts kept from before, the first ones in the cache.
+unsigned int MassSpringSystem::resolveCollision( unsigned int iMass, const vec3& vContactRay, const vec3& vRay, float fT,
+												 unsigned int iObject, const vec3& vNormal )
 {
-	//* Collision Against World Objects -> General Solution (DOESN'T WORK)
-	// Apply Current Force as Acceleration to get Velocity Vector; Scale Ray by timestep
-	vec3 vRay = (pMass.m_vVelocity + ((pMass.m_vForce/pMass.m_fMass)*m_fDeltaT)) * m_fDeltaT;
-	vec3 vNewPos = pMass.m_vPosition + vRay;	// Get new Position
-	vec3 vPushPoint, vSpringForce, vDiff;
-	float fT;
-	
-	// No collision detected yet
-	if (!pMass.m_bColliding)
+	// Local references into the Mass arrays
+	const vec3& vPosition = m_sMasses.m_vPosition[ iMass ];
+	const vec3& vVelocity = m_sMasses.m_vVelocity[ iMass ];
+	vec3& vForce = m_sMasses.m_vForce[ iMass ];
+	unsigned int c = 0, iKept;
+	float fDepth;
+
+	// Still dealing with the contacts from before?
+	while ( c < m_sContacts.getCount( iMass ) )
 	{
-		// Check for Collisions
-		fT = EnvironmentManager::getInstance()->checkCollision(pMass.m_vPosition, vRay, pMass.m_vCollisionNormal);
+		unsigned int iEntry = m_sContacts.getEntry( iMass, c );
+		const vec3& vContactNormal = m_sContacts.m_vNormal[ iEntry ];
 
-		// Past xy-plane @ y = 0?
-		if (pMass.m_bColliding = (fT < FLT_MAX && fT > 0.0f))
+		fDepth = dot( vPosition + vContactRay - m_sContacts.m_vPoint[ iEntry ], vContactNormal );
+		if ( fDepth <= 0.0f )
 		{
-			pMass.m_vCollisionIntersection = pMass.m_vPosition + (normalize(vRay) * fT);	// Store the intersection
-			vDiff = vNewPos - pMass.m_vCollisionIntersection;								// Calculate difference
+			vForce -= m_fCollisionK * fDepth * vContactNormal;
+			++c;
 		}
+		else
+			m_sContacts.remove( iMass, c );
 	}
-	else // Still dealing with a collision.
+	iKept = c;
+
+	// New collision detected?
+	if ( fT < FLT_MAX && fT > 0.0f && vNormal != vec3( 0.0f ) && !m_sContacts.hasObject( iMass, iObject ) )
 	{
-		vDiff = vNewPos - pMass.m_vCollisionIntersection;									// Update Difference
-		pMass.m_bColliding = (dot(vDiff, pMass.m_vCollisionNormal) <= 0.0f);				// Determine if a collision is still occuring
+		vec3 vIntersection = vPosition + (normalize( vRay ) * fT);
+		vec3 vContactNormal = normalize( vNormal );
+
+		fDepth = dot( vPosition + vRay - vIntersection, vContactNormal );
+		if ( m_sContacts.add( iMass, iObject, vIntersection, vContactNormal ) && fDepth < 0.0f )
+			vForce -= m_fCollisionK * fDepth * vContactNormal;
 	}
 
-	// There is a collision? calculate the force.
-	if (pMass.m_bColliding)
+	if ( m_sContacts.getCount( iMass ) > 0 )
+		vForce -= m_fCollisionDamp * vVelocity;
+
+	m_sMasses.setFlag( iMass, MASS_COLLIDING, m_sContacts.getCount( iMass ) > 0 );
+	return iKept;
+}
+
+// A ray from vStart can only reach an object the mass isn't touching once the mass has used up its clearance:
+//	the distance it has moved since the clearance was measured plus the length of the ray.
+bool MassSpringSystem::needsQuery( unsigned int iMass, const vec3& vStart, const vec3& vRay ) const
+{
+	return nullptr != m_pEnvironment && vRay != vec3( 0.0f )
+		&& length( vStart - m_sContacts.m_vClearanceOrigin[ iMass ] ) + length( vRay ) >= m_sContacts.m_fClearance[ iMass ];
+}
+
+// Measures the clearance of every active mass from its current position, leaving out the objects it's touching.
+//	Sleeping masses don't move, theirs is measured again in wakeIslands if the objects do.
+void MassSpringSystem::updateClearance()
+{
+	int iNumActive = (int)m_vActiveMasses.size();
+
+	if ( nullptr == m_pEnvironment )
+		return;
+
+	#pragma omp parallel for num_threads( m_iNumThreads ) if( m_iNumThreads > 1 )
+	for ( int i = 0; i < iNumActive; ++i )
 	{
-		vPushPoint = -((dot(vDiff, pMass.m_vCollisionNormal) / dot(pMass.m_vCollisionNormal, pMass.m_vCollisionNormal)) * pMass.m_vCollisionNormal);
-		vSpringForce = -m_fCollisionK * -vPushPoint - (m_fCollisionDamp * pMass.m_vVelocity);
+		unsigned int m = m_vActiveMasses[ i ];
 
-		pMass.m_vForce += vSpringForce;
+		m_sContacts.m_vClearanceOrigin[ m ] = m_sMasses.m_vPosition[ m ];
+		m_sContacts.m_fClearance[ m ] = m_pEnvironment->getClearance( m_sMasses.m_vPosition[ m ],
+																	   &m_sContacts.m_iObject[ m_sContacts.getEntry( m, 0 ) ],
+																	   m_sContacts.getCount( m ) );
 	}
-	//*/
-	/* Collision against xz-plane at y = 0.0 (WORKS)
-	vec3 vNewPos = pMass.m_vPosition + (pMass.m_vVelocity * m_fDeltaT);
+}
+
+/*********************************************************************************\
+* Sleeping Islands                                                               *
+\*********************************************************************************/
+
+// Connected components of the spring graph by union-find over the springs, numbered in order of their first
+//	mass into pMassIsland.  Returns how many there are.  Every spring's masses must be below iNumMasses.
+static unsigned int numberIslands( const unsigned int* pMass1, const unsigned int* pMass2, unsigned int iNumSprings,
+								   unsigned int iNumMasses, unsigned int* pMassIsland )
+{
+	vector< unsigned int > vParent( iNumMasses );
+	unsigned int iNumIslands = 0;
+
+	for ( unsigned int m = 0; m < iNumMasses; ++m )
+		vParent[ m ] = m;
 
-	// Past xy-plane @ y = 0?
-	if (vNewPos.y < 0.0)
+	// Path halving: every mass visited on the way to the root skips up a level
+	auto findRoot = [ &vParent ]( unsigned int m )
 	{
-		// Check for Table intersection
-		//if ( abs( vNewPos.x - 3.0 ) < 2.0f && abs( vNewPos.z - 3.0 ) < 2.0f )
-		//{
-		// Calculate Spring to add force to plane.
-		vec3 vNormal = vec3(0.0, vNewPos.y, 0.0);
-		vec3 vSpringForce = -m_fCollisionK * vNormal - (m_fCollisionDamp * pMass.m_vVelocity);
-		cout << "Spring Force: {" << vSpringForce.x << ", " << vSpringForce.y << ", " << vSpringForce.z << "}\n";
-		cout << "Added to current force: {" << pMass.m_vForce.x << ", " << pMass.m_vForce.y << ", " << pMass.m_vForce.z << "}\n";
+		while ( vParent[ m ] != m )
+			m = vParent[ m ] = vParent[ vParent[ m ] ];
+		return m;
+	};
 
-		pMass.m_vForce += vSpringForce;
-		cout << "\t==: {" << pMass.m_vForce.x << ", " << pMass.m_vForce.y << ", " << pMass.m_vForce.z << "}\n";
-		//}
-	}//*/
+	for ( unsigned int s = 0; s < iNumSprings; ++s )
+	{
+		unsigned int iRoot1 = findRoot( pMass1[ s ] );
+		unsigned int iRoot2 = findRoot( pMass2[ s ] );
+
+		if ( iRoot1 != iRoot2 )
+			vParent[ std::max( iRoot1, iRoot2 ) ] = std::min( iRoot1, iRoot2 );
+	}
+
+	// Roots are the lowest mass of their island, so they're numbered before any other mass of it is reached
+	for ( unsigned int m = 0; m < iNumMasses; ++m )
+	{
+		unsigned int iRoot = findRoot( m );
+		pMassIsland[ m ] = (iRoot == m) ? iNumIslands++ : pMassIsland[ iRoot ];
+	}
+
+	return iNumIslands;
+}
+
+// Only the free masses count towards an island's mass; an island of fixed masses never moves.
+void MassSpringSystem::Islands::build( const Springs& sSprings, const PointMasses& sMasses )
+{
+	unsigned int iNumMasses = sMasses.size();
+	unsigned int iNumIslands;
+
+	m_iMassIsland.resize( iNumMasses );
+	iNumIslands = numberIslands( sSprings.m_iMass1.data(), sSprings.m_iMass2.data(), sSprings.size(), iNumMasses,
+								 m_iMassIsland.data() );
+
+	m_fMass.assign( iNumIslands, 0.0f );
+	m_fKinetic.assign( iNumIslands, 0.0f );
+	m_fStrain.assign( iNumIslands, 0.0f );
+	m_fPrevStrain.assign( iNumIslands, 0.0f );
+	m_iQuietFrames.assign( iNumIslands, 0 );
+	m_bSleeping.assign( iNumIslands, 0 );
+	m_bWake.assign( iNumIslands, 0 );
+	m_bNearChange.assign( iNumIslands, 0 );
+	m_vMin.assign( iNumIslands, vec3( FLT_MAX ) );
+	m_vMax.assign( iNumIslands, vec3( -FLT_MAX ) );
+
+	for ( unsigned int m = 0; m < iNumMasses; ++m )
+		if ( !sMasses.isFixed( m ) )
+			m_fMass[ m_iMassIsland[ m ] ] += 1.0f / sMasses.m_fInvMass[ m ];
+}
+
+static bool boxesOverlap( const vec3& vMinA, const vec3& vMaxA, const vec3& vMinB, const vec3& vMaxB )
+{
+	return vMinA.x <= vMaxB.x && vMaxA.x >= vMinB.x && vMinA.y <= vMaxB.y && vMaxA.y >= vMinB.y
+		&& vMinA.z <= vMaxB.z && vMaxA.z >= vMinB.z;
+}
+
+// Bounds of the masses of every island, fixed ones included.  Taken as islands fall asleep: their masses
+//	don't move until they wake.
+void MassSpringSystem::Islands::fit( const PointMasses& sMasses )
+{
+	std::fill( m_vMin.begin(), m_vMin.end(), vec3( FLT_MAX ) );
+	std::fill( m_vMax.begin(), m_vMax.end(), vec3( -FLT_MAX ) );
+
+	for ( unsigned int m = 0; m < sMasses.size(); ++m )
+	{
+		m_vMin[ m_iMassIsland[ m ] ] = min( m_vMin[ m_iMassIsland[ m ] ], sMasses.m_vPosition[ m ] );
+		m_vMax[ m_iMassIsland[ m ] ] = max( m_vMax[ m_iMassIsland[ m ] ], sMasses.m_vPosition[ m ] );
+	}
+}
+
+// Every island wakes at the start of the next update.
+void MassSpringSystem::wake()
+{
+	std::fill( m_sIslands.m_bWake.begin(), m_sIslands.m_bWake.end(), 1 );
+}
+
+// Collects the free masses of the awake islands and their springs.  The springs keep their color order, so
+//	the colors stay independent sets.
+void MassSpringSystem::buildActiveSet()
+{
+	const unsigned char* pSleeping = m_sIslands.m_bSleeping.data();
+	const unsigned int* pMassIsland = m_sIslands.m_iMassIsland.data();
+
+	m_vActiveMasses.clear();
+	for ( unsigned int m = 0; m < m_sMasses.size(); ++m )
+	{
+		if ( !m_sMasses.isFixed( m ) && !pSleeping[ pMassIsland[ m ] ] )
+			m_vActiveMasses.push_back( m );
+	}
+
+	m_sActiveSprings.clear();
+	m_vActiveColorOffsets.assign( 1, 0 );
+	for ( unsigned int c = 0; c + 1 < m_vColorOffsets.size(); ++c )
+	{
+		for ( unsigned int s = m_vColorOffsets[ c ]; s < m_vColorOffsets[ c + 1 ]; ++s )
+		{
+			unsigned int iMass1 = m_sSprings.m_iMass1[ s ], iMass2 = m_sSprings.m_iMass2[ s ];
+
+			if ( !pSleeping[ pMassIsland[ iMass1 ] ] && !(m_sMasses.isFixed( iMass1 ) && m_sMasses.isFixed( iMass2 )) )
+				m_sActiveSprings.add( m_sSprings, s );
+		}
+		m_vActiveColorOffsets.push_back( m_sActiveSprings.size() );
+	}
+}
+
+// Wakes the islands flagged by wake() or by self collision with an awake mass.  When the objects of the
+//	environment have changed, the sleeping islands within SLEEP_WAKE_DISTANCE shortest springs of the change
+//	look at it: an island wakes if one of its masses rests on an object in the change (it may have moved away
+//	or been removed, the contacts with removed ones are dropped), or if an object the mass isn't touching came
+//	closer than that.  Their masses measure their clearance again.  The first time, or after changes were missed, the change covers everything and
+//	only the clearance is looked at.
+void MassSpringSystem::wakeIslands()
+{
+	Islands& sIslands = m_sIslands;
+	int iNumMasses = (int)m_sMasses.size();
+	bool bChanged = false, bAnyAwake = false, bAnyNear = false;
+
+	if ( nullptr != m_pEnvironment && m_pEnvironment->getChangeCount() != m_iEnvironmentChanges )
+	{
+		float fWakeDistance = SLEEP_WAKE_DISTANCE * m_fMinRestLength;
+		bool bKnownChange = ENVIRONMENT_UNSEEN != m_iEnvironmentChanges
+							&& 1 == m_pEnvironment->getChangeCount() - m_iEnvironmentChanges;
+		vec3 vChangedMin( -FLT_MAX ), vChangedMax( FLT_MAX );
+
+		m_iEnvironmentChanges = m_pEnvironment->getChangeCount();
+		if ( bKnownChange )
+		{
+			m_pEnvironment->getChangedBounds( vChangedMin, vChangedMax );
+			vChangedMin -= vec3( fWakeDistance );
+			vChangedMax += vec3( fWakeDistance );
+		}
+
+		for ( unsigned int i = 0; i < sIslands.size(); ++i )
+		{
+			sIslands.m_bNearChange[ i ] = sIslands.m_bSleeping[ i ]
+				&& boxesOverlap( sIslands.m_vMin[ i ], sIslands.m_vMax[ i ], vChangedMin, vChangedMax );
+			bAnyNear |= 0 != sIslands.m_bNearChange[ i ];
+		}
+
+		// Sleeping islands away from the change skip it without a query
+		if ( bAnyNear )
+		{
+			#pragma omp parallel for num_threads( m_iNumThreads ) if( m_iNumThreads > 1 )
+			for ( int m = 0; m < iNumMasses; ++m )
+			{
+				if ( m_sMasses.isSleeping( m ) && sIslands.m_bNearChange[ sIslands.m_iMassIsland[ m ] ] )
+				{
+					const vec3& vPosition = m_sMasses.m_vPosition[ m ];
+					bool bSupportChanged = bKnownChange && m_sContacts.getCount( m ) > 0
+										   && boxesOverlap( vPosition, vPosition, vChangedMin, vChangedMax );
+					float fClearance;
+
+					// Nothing holds the mass up where a removed object was
+					for ( unsigned int c = bSupportChanged ? m_sContacts.getCount( m ) : 0; c > 0; --c )
+					{
+						if ( !m_pEnvironment->hasObject( m_sContacts.m_iObject[ m_sContacts.getEntry( m, c - 1 ) ] ) )
+							m_sContacts.remove( m, c - 1 );
+					}
+
+					fClearance = m_pEnvironment->getClearance( vPosition, &m_sContacts.m_iObject[ m_sContacts.getEntry( m, 0 ) ],
+															   m_sContacts.getCount( m ) );
+
+					// Every writer stores 1, so a plain byte store is enough
+					if ( bSupportChanged || (fClearance < m_sContacts.m_fClearance[ m ] && fClearance < fWakeDistance) )
+						sIslands.m_bWake[ sIslands.m_iMassIsland[ m ] ] = 1;
+
+					m_sContacts.m_vClearanceOrigin[ m ] = m_sMasses.m_vPosition[ m ];
+					m_sContacts.m_fClearance[ m ] = fClearance;
+				}
+			}
+		}
+	}
+
+	for ( unsigned int i = 0; i < sIslands.size(); ++i )
+	{
+		if ( sIslands.m_bWake[ i ] && sIslands.m_bSleeping[ i ] )
+		{
+			sIslands.m_bSleeping[ i ] = 0;
+			sIslands.m_iQuietFrames[ i ] = 0;
+			bChanged = true;
+		}
+		sIslands.m_bWake[ i ] = 0;
+		bAnyAwake |= !sIslands.m_bSleeping[ i ] && sIslands.m_fMass[ i ] > 0.0f;
+	}
+
+	// The other integrators can't leave part of the system out of their solve
+	if ( bAnyAwake && EXPLICIT_EULER != m_eIntegrator )
+	{
+		for ( unsigned int i = 0; i < sIslands.size(); ++i )
+		{
+			bChanged |= (0 != sIslands.m_bSleeping[ i ]);
+			sIslands.m_bSleeping[ i ] = 0;
+			sIslands.m_iQuietFrames[ i ] = 0;
+		}
+	}
+
+	if ( bChanged )
+	{
+		for ( int m = 0; m < iNumMasses; ++m )
+			m_sMasses.setFlag( m, MASS_SLEEPING, !m_sMasses.isFixed( m ) && 0 != sIslands.m_bSleeping[ sIslands.m_iMassIsland[ m ] ] );
+		buildActiveSet();
+	}
+}
+
+// Measures the kinetic and strain energy of every awake island at the end of the frame and puts the islands
+//	that have stayed quiet for m_iSleepFrames to sleep, stopping their masses.
+void MassSpringSystem::sleepIslands()
+{
+	Islands& sIslands = m_sIslands;
+	bool bChanged = false, bAllQuiet = true;
+
+	if ( !m_bSleep )
+		return;
+
+	std::fill( sIslands.m_fKinetic.begin(), sIslands.m_fKinetic.end(), 0.0f );
+	std::fill( sIslands.m_fStrain.begin(), sIslands.m_fStrain.end(), 0.0f );
+
+	for ( unsigned int i = 0; i < m_vActiveMasses.size(); ++i )
+	{
+		unsigned int m = m_vActiveMasses[ i ];
+		const vec3& vVelocity = m_sMasses.m_vVelocity[ m ];
+
+		sIslands.m_fKinetic[ sIslands.m_iMassIsland[ m ] ] += 0.5f * dot( vVelocity, vVelocity ) / m_sMasses.m_fInvMass[ m ];
+	}
+
+	for ( unsigned int s = 0; s < m_sActiveSprings.size(); ++s )
+	{
+		unsigned int iMass1 = m_sActiveSprings.m_iMass1[ s ];
+		float fStretch = length( m_sMasses.m_vPosition[ iMass1 ] - m_sMasses.m_vPosition[ m_sActiveSprings.m_iMass2[ s ] ] )
+						 - m_sActiveSprings.m_fRestLength[ s ];
+
+		sIslands.m_fStrain[ sIslands.m_iMassIsland[ iMass1 ] ] += 0.5f * m_fK * fStretch * fStretch;
+	}
+
+	for ( unsigned int i = 0; i < sIslands.size(); ++i )
+	{
+		if ( sIslands.m_bSleeping[ i ] || sIslands.m_fMass[ i ] <= 0.0f )
+			continue;
+
+		float fThreshold = m_fSleepEnergy * sIslands.m_fMass[ i ];
+		bool bQuiet = sIslands.m_fKinetic[ i ] < fThreshold && abs( sIslands.m_fStrain[ i ] - sIslands.m_fPrevStrain[ i ] ) < fThreshold;
+
+		sIslands.m_iQuietFrames[ i ] = bQuiet ? sIslands.m_iQuietFrames[ i ] + 1 : 0;
+		sIslands.m_fPrevStrain[ i ] = sIslands.m_fStrain[ i ];
+		bAllQuiet &= sIslands.m_iQuietFrames[ i ] >= m_iSleepFrames;
+	}
+
+	for ( unsigned int i = 0; i < sIslands.size(); ++i )
+	{
+		if ( !sIslands.m_bSleeping[ i ] && sIslands.m_fMass[ i ] > 0.0f && sIslands.m_iQuietFrames[ i ] >= m_iSleepFrames
+			 && (EXPLICIT_EULER == m_eIntegrator || bAllQuiet) )
+		{
+			sIslands.m_bSleeping[ i ] = 1;
+			bChanged = true;
+		}
+	}
+
+	if ( bChanged )
+	{
+		for ( unsigned int i = 0; i < m_vActiveMasses.size(); ++i )
+		{
+			unsigned int m = m_vActiveMasses[ i ];
+
+			if ( sIslands.m_bSleeping[ sIslands.m_iMassIsland[ m ] ] )
+			{
+				m_sMasses.setFlag( m, MASS_SLEEPING, true );
+				m_sMasses.m_vVelocity[ m ] = m_sMasses.m_vForce[ m ] = vec3( 0.0f );
+			}
+		}
+		sIslands.fit( m_sMasses );
+		buildActiveSet();
+	}
+}
+
+
+/*********************************************************************************\
+* Adaptive Substepping                                                           *
+\*********************************************************************************/
+
+// Explicit stability limits: semi-implicit Euler stays stable while h < 2 / omega on every mass, with
+//	omega = sqrt( k * springs / m ) (+ Collision_K while colliding); the damping rate c / m is added on
+//	top since the damping is integrated explicitly too.  Also finds the shortest spring the error and
+//	CFL bounds are measured against.
+void MassSpringSystem::computeStepBounds()
+{
+	vector< unsigned int > vCount( m_sMasses.size(), 0 );
+	float fMaxRate = 0.0f, fMaxContactRate = 0.0f;
+
+	m_fMinRestLength = m_fRestLength;
+	for ( unsigned int s = 0; s < m_sSprings.size(); ++s )
+	{
+		++vCount[ m_sSprings.m_iMass1[ s ] ];
+		++vCount[ m_sSprings.m_iMass2[ s ] ];
+		if ( m_sSprings.m_fRestLength[ s ] > 0.0f )
+			m_fMinRestLength = std::min( m_fMinRestLength, m_sSprings.m_fRestLength[ s ] );
+	}
+
+	for ( unsigned int m = 0; m < m_sMasses.size(); ++m )
+	{
+		float fInvMass = m_sMasses.m_fInvMass[ m ];
+
+		if ( m_sMasses.isFixed( m ) )
+			continue;
+
+		fMaxRate = std::max( fMaxRate, sqrt( m_fK * vCount[ m ] * fInvMass ) + m_fMassDamping[ m ] * fInvMass );
+		fMaxContactRate = std::max( fMaxContactRate, sqrt( (m_fK * vCount[ m ] + m_fCollisionK) * fInvMass )
+													 + (m_fMassDamping[ m ] + m_fCollisionDamp) * fInvMass );
+	}
+
+	m_fStableDeltaT = (fMaxRate > 0.0f) ? STEP_STABILITY * 2.0f / fMaxRate : FLT_MAX;
+	m_fStableContactDeltaT = (fMaxContactRate > 0.0f) ? STEP_STABILITY * 2.0f / fMaxContactRate : FLT_MAX;
+	m_fAdaptiveDeltaT = m_fDeltaT;
+	m_vStepVelocity.assign( m_sMasses.m_vVelocity.begin(), m_sMasses.m_vVelocity.end() );
+}
+
+// Covers the frame's m_iLoopCount * m_fDeltaT of simulated time with substeps sized by estimateStep.
+//	Once the frame's wall-clock budget is spent the rest of its time is dropped: the simulation runs slower
+//	than real time instead of taking steps too large to stay accurate.  Deterministic systems have no
+//	budget, the substeps can't depend on how fast the machine is.
+void MassSpringSystem::updateAdaptive()
+{
+	chrono::steady_clock::time_point tStart = chrono::steady_clock::now();
+	float fFrameTime = m_fDeltaT * (float)m_iLoopCount;
+	float fTime = 0.0f, fMinDeltaT = FLT_MAX, fMaxDeltaT = 0.0f;
+	unsigned int iSteps = 0;
+	bool bOverBudget = false;
+
+	while ( fFrameTime - fTime > fFrameTime * FLT_EPSILON && !bOverBudget )
+	{
+		// Split what is left of the frame evenly rather than leave a sliver for the last substep
+		float fRemaining = fFrameTime - fTime;
+		float fDeltaT = fRemaining / ceil( fRemaining / m_fAdaptiveDeltaT );
+
+		step( fDeltaT );
+		m_fAdaptiveDeltaT = std::min( estimateStep( fDeltaT ), fFrameTime );
+
+		fTime += fDeltaT;
+		fMinDeltaT = std::min( fMinDeltaT, fDeltaT );
+		fMaxDeltaT = std::max( fMaxDeltaT, fDeltaT );
+		++iSteps;
+
+		bOverBudget = m_fFrameBudget > 0.0f && !m_bDeterministic
+					  && chrono::duration< float, milli >( chrono::steady_clock::now() - tStart ).count() > m_fFrameBudget
+					  && fFrameTime - fTime > fFrameTime * FLT_EPSILON;
+	}
+
+	logSteps( iSteps, fMinDeltaT, fMaxDeltaT, bOverBudget );
+}
+
+// Size of the next substep after one of fDeltaT; the smallest of:
+//	Error: semi-implicit and explicit Euler (the embedded pair) end a step h * |dv| / 2 apart.  That estimate
+//		is held at m_fStepTolerance of the shortest spring by scaling h with sqrt( tolerance / error ).
+//	CFL: no mass travels more than STEP_CFL of the shortest spring in a substep.
+//	Stability (explicit only): the limit of the stiffest mass, with Collision_K once anything collides.
+float MassSpringSystem::estimateStep( float fDeltaT )
+{
+	int iNumMasses = (int)m_sMasses.size();
+	float fMaxDeltaV2 = 0.0f, fMaxSpeed2 = 0.0f;
+	bool bColliding = false;
+	float fError, fNext;
+
+	#pragma omp parallel num_threads( m_iNumThreads ) if( m_iNumThreads > 1 )
+	{
+		float fThreadDeltaV2 = 0.0f, fThreadSpeed2 = 0.0f;
+		bool bThreadColliding = false;
+
+		#pragma omp for
+		for ( int m = 0; m < iNumMasses; ++m )
+		{
+			const vec3& vVelocity = m_sMasses.m_vVelocity[ m ];
+			vec3 vDeltaV = vVelocity - m_vStepVelocity[ m ];
+
+			fThreadDeltaV2 = std::max( fThreadDeltaV2, dot( vDeltaV, vDeltaV ) );
+			fThreadSpeed2 = std::max( fThreadSpeed2, dot( vVelocity, vVelocity ) );
+			bThreadColliding |= m_sMasses.isColliding( m );
+			m_vStepVelocity[ m ] = vVelocity;
+		}
+
+		#pragma omp critical
+		{
+			fMaxDeltaV2 = std::max( fMaxDeltaV2, fThreadDeltaV2 );
+			fMaxSpeed2 = std::max( fMaxSpeed2, fThreadSpeed2 );
+			bColliding |= bThreadColliding;
+		}
+	}
+
+	fError = 0.5f * fDeltaT * sqrt( fMaxDeltaV2 );
+	fNext = fDeltaT * ((fError > 0.0f) ? glm::clamp( 0.9f * sqrt( m_fStepTolerance * m_fMinRestLength / fError ), STEP_SHRINK, STEP_GROWTH )
+									   : STEP_GROWTH);
+
+	if ( fMaxSpeed2 > 0.0f )
+		fNext = std::min( fNext, STEP_CFL * m_fMinRestLength / sqrt( fMaxSpeed2 ) );
+	if ( EXPLICIT_EULER == m_eIntegrator )
+		fNext = std::min( fNext, bColliding ? m_fStableContactDeltaT : m_fStableDeltaT );
+
+	return fNext;
+}
+
+// Accumulates a frame's substeps and reports them every m_iStepLogFrames frames.
+void MassSpringSystem::logSteps( unsigned int iSteps, float fMinDeltaT, float fMaxDeltaT, bool bOverBudget )
+{
+	m_sStepLog.iFrames++;
+	m_sStepLog.iSteps += iSteps;
+	m_sStepLog.iMinSteps = std::min( m_sStepLog.iMinSteps, iSteps );
+	m_sStepLog.iMaxSteps = std::max( m_sStepLog.iMaxSteps, iSteps );
+	m_sStepLog.iOverBudget += bOverBudget ? 1 : 0;
+	m_sStepLog.fMinDeltaT = std::min( m_sStepLog.fMinDeltaT, fMinDeltaT );
+	m_sStepLog.fMaxDeltaT = std::max( m_sStepLog.fMaxDeltaT, fMaxDeltaT );
+
+	if ( 0 != m_iStepLogFrames && m_sStepLog.iFrames >= m_iStepLogFrames )
+	{
+		cout << "Adaptive steps: " << m_sStepLog.iFrames << " frames, "
+			 << (float)m_sStepLog.iSteps / (float)m_sStepLog.iFrames << " substeps/frame ("
+			 << m_sStepLog.iMinSteps << " - " << m_sStepLog.iMaxSteps << "), delta_t "
+			 << m_sStepLog.fMinDeltaT << " - " << m_sStepLog.fMaxDeltaT << ", "
+			 << m_sStepLog.iOverBudget << " frames over budget\n";
+		resetStepLog();
+	}
+}
+
+void MassSpringSystem::resetStepLog()
+{
+	m_sStepLog.iFrames = m_sStepLog.iSteps = m_sStepLog.iMaxSteps = m_sStepLog.iOverBudget = 0;
+	m_sStepLog.iMinSteps = UINT_MAX;
+	m_sStepLog.fMinDeltaT = FLT_MAX;
+	m_sStepLog.fMaxDeltaT = 0.0f;
 }
 
+/*********************************************************************************\
+* Position Based Contacts                                                        *
+\*********************************************************************************/
+
+// Looks for an object the mass isn't touching yet between vStart and its current position (if its clearance
+//	doesn't cover the movement) and adds a contact at the hit with its unit normal.  Returns true if one was found.
+bool MassSpringSystem::findContact( unsigned int iMass, const vec3& vStart )
+{
+	vec3 vRay = m_sMasses.m_vPosition[ iMass ] - vStart;
+	vec3 vNormal( 0.0f );
+	unsigned int iObject = 0;
+	float fT = FLT_MAX;
+	bool bFound = false;
 
-// Updates and returns the look at for the camera.
+	if ( needsQuery( iMass, vStart, vRay ) )
+	{
+		m_pEnvironment->checkCollisions( &vStart, &vRay, 1, &fT, &vNormal, &iObject );
+
+		if ( fT < FLT_MAX && fT >= 0.0f && vNormal != vec3( 0.0f ) && !m_sContacts.hasObject( iMass, iObject ) )
+			bFound = m_sContacts.add( iMass, iObject, vStart + (normalize( vRay ) * fT), normalize( vNormal ) );
+	}
+
+	m_sMasses.setFlag( iMass, MASS_COLLIDING, m_sContacts.getCount( iMass ) > 0 );
+	return bFound;
+}
+
+// Contacts are inequality constraints on the planes found along the predicted path; a contact is released once
+//	the mass starts and ends the step outside, since rays can't find contacts from behind a plane.  Then the
+//	step is checked for new contacts.
+void MassSpringSystem::updateContact( unsigned int iMass, const vec3& vStart )
+{
+	unsigned int c = 0;
+
+	while ( c < m_sContacts.getCount( iMass ) )
+	{
+		unsigned int iEntry = m_sContacts.getEntry( iMass, c );
+		const vec3& vContact = m_sContacts.m_vPoint[ iEntry ];
+		const vec3& vNormal = m_sContacts.m_vNormal[ iEntry ];
+
+		if ( dot( m_sMasses.m_vPosition[ iMass ] - vContact, vNormal ) <= 0.0f || dot( vStart - vContact, vNormal ) <= 0.0f )
+			++c;
+		else
+			m_sContacts.remove( iMass, c );
+	}
+
+	findContact( iMass, vStart );
+}
+
+// Pushes a colliding mass back onto the outside of each of its contact planes: C = (x - contact) . n >= 0.
+//	The planes don't move, so the whole correction goes to the mass.  Masses pushed out also lose their
+//	tangential movement since vStart (static friction), otherwise resting objects drift with the
+//	order the constraints are solved in.  Returns true if the mass was moved.
+bool MassSpringSystem::projectContact( unsigned int iMass, const vec3& vStart )
+{
+	vec3& vPosition = m_sMasses.m_vPosition[ iMass ];
+	bool bReturnValue = false;
+
+	for ( unsigned int c = 0; c < m_sContacts.getCount( iMass ); ++c )
+	{
+		unsigned int iEntry = m_sContacts.getEntry( iMass, c );
+		const vec3& vNormal = m_sContacts.m_vNormal[ iEntry ];
+		float fDepth = dot( vPosition - m_sContacts.m_vPoint[ iEntry ], vNormal );
+
+		if ( fDepth < 0.0f )
+		{
+			vec3 vMovement = vPosition - vStart;
+
+			vPosition -= vNormal * fDepth;
+			vPosition -= vMovement - vNormal * dot( vMovement, vNormal );
+			bReturnValue = true;
+		}
+	}
+
+	return bReturnValue;
+}
+
+
+// Updates and returns the look at for the camera, from the published positions.
 const vec3& MassSpringSystem::getCenter()
 {
-	m_vCenter = (m_vMasses.empty() ? m_vCenter : m_vMasses.front()->m_vPosition);
+	const aligned_vector< vec3 >& vPositions = getPublishedPositions();
+
+	m_vCenter = (vPositions.empty() ? m_vCenter : vPositions.front());
 	return m_vCenter;
 }
+
+// Copies the positions into the back slot of the triple buffer and swaps it in as the latest.  The slots
+//	keep their capacity, so this doesn't allocate once every slot has been written.
+void MassSpringSystem::publishPositions()
+{
+	m_sPublished.getBack() = m_sMasses.m_vPosition;
+	m_sPublished.publish();
+}
+
+/*********************************************************************************\
+* Snapshots                                                                      *
+\*********************************************************************************/
+
+// Arrays of a snapshot, in file order.  The first ones are what the rest of the state is derived from; the
+//	others would be reset by prepareUpdate, so they're read after it.
+enum eSnapshotSections
+{
+	SNAP_POSITION = 0,
+	SNAP_VELOCITY,
+	SNAP_FORCE,
+	SNAP_INV_MASS,
+	SNAP_FLAGS,
+	SNAP_SPRING_MASS1,
+	SNAP_SPRING_MASS2,
+	SNAP_REST_LENGTH,
+	SNAP_COLOR_OFFSETS,
+	SNAP_CONTACT_COUNT,
+	SNAP_CONTACT_OBJECT,
+	SNAP_CONTACT_POINT,
+	SNAP_CONTACT_NORMAL,
+	SNAP_CLEARANCE_ORIGIN,
+	SNAP_CLEARANCE,
+	SNAP_STEP_VELOCITY,		// First array read after prepareUpdate
+	SNAP_PREV_STRAIN,
+	SNAP_QUIET_FRAMES,
+	SNAP_DELTA_V,
+	NUM_SNAPSHOT_SECTIONS
+};
+
+// Start of a snapshot file, in native byte order: a file from a machine of the other endianness fails the
+//	magic check.  Each array starts at iSectionOffset, aligned to SNAPSHOT_ALIGNMENT from the start of the file.
+struct MassSpringSystem::SnapshotHeader
+{
+	unsigned int iMagic, iVersion, iHeaderSize, iNumSections;
+	unsigned int iNumMasses, iNumSprings, iNumColors, iNumIslands;
+
+	// Parameters
+	float fK, fRestLength, fMass, fDeltaT, fDampingCoeff, fCollisionK, fCollisionDamp;
+	unsigned int iLoopCount, iOrdering, iIntegrator;
+	float fStartPos[ 3 ];
+	unsigned int iCGIterations, iXPBDIterations, iXPBDIterationType, iPDIterations;
+	float fCGTolerance;
+	unsigned int iAdaptiveSteps, iStepLogFrames;
+	float fStepTolerance, fFrameBudget, fAdaptiveDeltaT;
+	unsigned int iSelfCollision;
+	float fSelfCollisionDistance;
+	unsigned int iSleep, iSleepFrames;
+	float fSleepEnergy;
+
+	unsigned long long iStepCount;
+	unsigned long long iSectionOffset[ NUM_SNAPSHOT_SECTIONS ], iSectionBytes[ NUM_SNAPSHOT_SECTIONS ];
+};
+
+// Rounds a file offset up to the next SNAPSHOT_ALIGNMENT boundary.
+static unsigned long long alignSnapshot( unsigned long long iOffset )
+{
+	return (iOffset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+// Where each array of a snapshot with sHeader's counts is kept and how many bytes it takes.  The pointers are
+//	only meaningful once the arrays are sized for those counts.
+void MassSpringSystem::getSnapshotSections( const SnapshotHeader& sHeader, SnapshotSection* pSections )
+{
+	unsigned long long iMasses = sHeader.iNumMasses, iSprings = sHeader.iNumSprings, iIslands = sHeader.iNumIslands;
+	unsigned long long iContacts = iMasses * MAX_MASS_CONTACTS;
+	unsigned long long iDeltaV = (IMPLICIT_EULER == sHeader.iIntegrator) ? iMasses : 0;
+	const SnapshotSection sSections[ NUM_SNAPSHOT_SECTIONS ] =
+	{
+		{ m_sMasses.m_vPosition.data(), iMasses * sizeof( vec3 ) },
+		{ m_sMasses.m_vVelocity.data(), iMasses * sizeof( vec3 ) },
+		{ m_sMasses.m_vForce.data(), iMasses * sizeof( vec3 ) },
+		{ m_sMasses.m_fInvMass.data(), iMasses * sizeof( float ) },
+		{ m_sMasses.m_iFlags.data(), iMasses * sizeof( unsigned char ) },
+		{ m_sSprings.m_iMass1.data(), iSprings * sizeof( unsigned int ) },
+		{ m_sSprings.m_iMass2.data(), iSprings * sizeof( unsigned int ) },
+		{ m_sSprings.m_fRestLength.data(), iSprings * sizeof( float ) },
+		{ m_vColorOffsets.data(), (sHeader.iNumColors + 1ULL) * sizeof( unsigned int ) },
+		{ m_sContacts.m_iCount.data(), iMasses * sizeof( unsigned char ) },
+		{ m_sContacts.m_iObject.data(), iContacts * sizeof( unsigned int ) },
+		{ m_sContacts.m_vPoint.data(), iContacts * sizeof( vec3 ) },
+		{ m_sContacts.m_vNormal.data(), iContacts * sizeof( vec3 ) },
+		{ m_sContacts.m_vClearanceOrigin.data(), iMasses * sizeof( vec3 ) },
+		{ m_sContacts.m_fClearance.data(), iMasses * sizeof( float ) },
+		{ m_vStepVelocity.data(), iMasses * sizeof( vec3 ) },
+		{ m_sIslands.m_fPrevStrain.data(), iIslands * sizeof( float ) },
+		{ m_sIslands.m_iQuietFrames.data(), iIslands * sizeof( unsigned int ) },
+		{ m_pImplicitSolver->getDeltaV().data(), iDeltaV * sizeof( vec3 ) }
+	};
+
+	copy( sSections, sSections + NUM_SNAPSHOT_SECTIONS, pSections );
+}
+
+// Checks the arrays of a mapped snapshot whose sections are where its header says hold a system the update
+//	can run: springs between existing masses, no more contacts than a mass keeps, masses that are either
+//	fixed or have a finite, non-zero inverse mass, and as many islands as the springs make.  The spring
+//	colours aren't checked, loadSnapshot rebuilds them.  Returns why the snapshot can't be loaded, or nullptr.
+const char* MassSpringSystem::checkSnapshotArrays( const SnapshotHeader& sHeader, const char* pData )
+{
+	const float* pInvMass = reinterpret_cast< const float* >( pData + sHeader.iSectionOffset[ SNAP_INV_MASS ] );
+	const unsigned char* pFlags = reinterpret_cast< const unsigned char* >( pData + sHeader.iSectionOffset[ SNAP_FLAGS ] );
+	const unsigned int* pMass1 = reinterpret_cast< const unsigned int* >( pData + sHeader.iSectionOffset[ SNAP_SPRING_MASS1 ] );
+	const unsigned int* pMass2 = reinterpret_cast< const unsigned int* >( pData + sHeader.iSectionOffset[ SNAP_SPRING_MASS2 ] );
+	const unsigned char* pContactCount = reinterpret_cast< const unsigned char* >( pData + sHeader.iSectionOffset[ SNAP_CONTACT_COUNT ] );
+	vector< unsigned int > vMassIsland;
+
+	for ( unsigned int s = 0; s < sHeader.iNumSprings; ++s )
+	{
+		if ( pMass1[ s ] >= sHeader.iNumMasses || pMass2[ s ] >= sHeader.iNumMasses )
+			return "has a spring between masses it doesn't have";
+	}
+
+	for ( unsigned int m = 0; m < sHeader.iNumMasses; ++m )
+	{
+		if ( pContactCount[ m ] > MAX_MASS_CONTACTS )
+			return "has more contacts on a mass than it can keep";
+
+		if ( (pFlags[ m ] & MASS_FIXED) ? 0.0f != pInvMass[ m ] : (0.0f == pInvMass[ m ] || !isfinite( pInvMass[ m ] )) )
+			return "has a mass whose inverse mass doesn't match whether it's fixed";
+	}
+
+	vMassIsland.resize( sHeader.iNumMasses );
+	if ( sHeader.iNumIslands != numberIslands( pMass1, pMass2, sHeader.iNumSprings, sHeader.iNumMasses, vMassIsland.data() ) )
+		return "has a different number of islands than its springs make";
+
+	return nullptr;
+}
+
+// Writes the header then every array straight from memory, padded so each starts on an aligned offset.
+//	The thread count, spring kernel and environment belong to the machine and scene, they aren't saved.
+bool MassSpringSystem::saveSnapshot( const string& sFileName )
+{
+	static const char cPadding[ SNAPSHOT_ALIGNMENT ] = {};
+	SnapshotHeader sHeader = {};
+	SnapshotSection sSections[ NUM_SNAPSHOT_SECTIONS ];
+	unsigned long long iOffset = alignSnapshot( sizeof( SnapshotHeader ) ), iWritten = 0;
+	ofstream sFile( sFileName, ios::binary | ios::trunc );
+
+	sHeader.iMagic = SNAPSHOT_MAGIC;
+	sHeader.iVersion = SNAPSHOT_VERSION;
+	sHeader.iHeaderSize = sizeof( SnapshotHeader );
+	sHeader.iNumSections = NUM_SNAPSHOT_SECTIONS;
+	sHeader.iNumMasses = m_sMasses.size();
+	sHeader.iNumSprings = m_sSprings.size();
+	sHeader.iNumColors = m_vColorOffsets.size() - 1;
+	sHeader.iNumIslands = m_sIslands.size();
+
+	sHeader.fK = m_fK;
+	sHeader.fRestLength = m_fRestLength;
+	sHeader.fMass = m_fMass;
+	sHeader.fDeltaT = m_fDeltaT;
+	sHeader.fDampingCoeff = m_fDamping_Coeff;
+	sHeader.fCollisionK = m_fCollisionK;
+	sHeader.fCollisionDamp = m_fCollisionDamp;
+	sHeader.iLoopCount = m_iLoopCount;
+	sHeader.iOrdering = m_eOrdering;
+	sHeader.iIntegrator = m_eIntegrator;
+	sHeader.fStartPos[ 0 ] = m_vStartPos.x;
+	sHeader.fStartPos[ 1 ] = m_vStartPos.y;
+	sHeader.fStartPos[ 2 ] = m_vStartPos.z;
+	sHeader.iCGIterations = m_pImplicitSolver->getMaxIterations();
+	sHeader.fCGTolerance = m_pImplicitSolver->getTolerance();
+	sHeader.iXPBDIterations = m_pXPBDSolver->getIterations();
+	sHeader.iXPBDIterationType = m_pXPBDSolver->getIterationType();
+	sHeader.iPDIterations = m_pProjectiveSolver->getIterations();
+	sHeader.iAdaptiveSteps = m_bAdaptiveSteps;
+	sHeader.iStepLogFrames = m_iStepLogFrames;
+	sHeader.fStepTolerance = m_fStepTolerance;
+	sHeader.fFrameBudget = m_fFrameBudget;
+	sHeader.fAdaptiveDeltaT = m_fAdaptiveDeltaT;
+	sHeader.iSelfCollision = m_bSelfCollision;
+	sHeader.fSelfCollisionDistance = m_bSelfCollision ? m_pSelfCollision->getDistance() : 0.0f;
+	sHeader.iSleep = m_bSleep;
+	sHeader.iSleepFrames = m_iSleepFrames;
+	sHeader.fSleepEnergy = m_fSleepEnergy;
+	sHeader.iStepCount = m_iStepCount;
+
+	getSnapshotSections( sHeader, sSections );
+	for ( unsigned int s = 0; s < NUM_SNAPSHOT_SECTIONS; ++s )
+	{
+		sHeader.iSectionOffset[ s ] = iOffset;
+		sHeader.iSectionBytes[ s ] = sSections[ s ].iBytes;
+		iOffset = alignSnapshot( iOffset + sSections[ s ].iBytes );
+	}
+
+	sFile.write( reinterpret_cast< const char* >( &sHeader ), sizeof( SnapshotHeader ) );
+	iWritten = sizeof( SnapshotHeader );
+	for ( unsigned int s = 0; s < NUM_SNAPSHOT_SECTIONS && sFile; ++s )
+	{
+		sFile.write( cPadding, sHeader.iSectionOffset[ s ] - iWritten );
+		sFile.write( static_cast< const char* >( sSections[ s ].pData ), sSections[ s ].iBytes );
+		iWritten = sHeader.iSectionOffset[ s ] + sSections[ s ].iBytes;
+	}
+	sFile.close();
+
+	if ( !sFile )
+		cout << "Error: Unable to write Mass Spring snapshot \"" << sFileName << "\".\n";
+
+	return !sFile.fail();
+}
+
+// Maps the file and checks every array is where the header says and as large as its counts make it, and
+//	that their contents make a valid system (see checkSnapshotArrays), before anything is changed.  Each
+//	array is then copied straight from the mapping, and whatever the update derives from them is rebuilt,
+//	the spring colours included.  Islands whose masses were saved asleep are asleep again; sleeping masses
+//	measure their clearance against the current environment on the next update.
+bool MassSpringSystem::loadSnapshot( const string& sFileName )
+{
+	MappedFile sFile( sFileName );
+	SnapshotHeader sHeader;
+	SnapshotSection sSections[ NUM_SNAPSHOT_SECTIONS ];
+	const char* cError = nullptr;
+
+	if ( !sFile.isOpen() || sFile.getSize() < sizeof( SnapshotHeader ) )
+		cError = "can't be read";
+	else
+	{
+		memcpy( &sHeader, sFile.getData(), sizeof( SnapshotHeader ) );
+
+		if ( SNAPSHOT_MAGIC != sHeader.iMagic || sizeof( SnapshotHeader ) != sHeader.iHeaderSize
+			 || NUM_SNAPSHOT_SECTIONS != sHeader.iNumSections )
+			cError = "isn't a Mass Spring snapshot of this build";
+		else if ( SNAPSHOT_VERSION != sHeader.iVersion )
+			cError = "is from another snapshot version";
+		else if ( sHeader.iOrdering >= MAX_ORDERINGS || sHeader.iIntegrator >= MAX_INTEGRATORS
+				  || sHeader.iXPBDIterationType >= XPBDSolver::MAX_ITERATION_TYPES )
+			cError = "has unknown parameters";
+		else if ( sHeader.iNumColors > MAX_SPRING_COLORS + 1 )
+			cError = "has more spring colours than this build makes";
+		else
+		{
+			getSnapshotSections( sHeader, sSections );
+			for ( unsigned int s = 0; s < NUM_SNAPSHOT_SECTIONS && nullptr == cError; ++s )
+			{
+				if ( sHeader.iSectionBytes[ s ] != sSections[ s ].iBytes || 0 != sHeader.iSectionOffset[ s ] % SNAPSHOT_ALIGNMENT
+					 || sHeader.iSectionOffset[ s ] > sFile.getSize() || sFile.getSize() - sHeader.iSectionOffset[ s ] < sHeader.iSectionBytes[ s ] )
+					cError = "is truncated or corrupt";
+			}
+
+			if ( nullptr == cError )
+				cError = checkSnapshotArrays( sHeader, sFile.getData() );
+		}
+	}
+
+	if ( nullptr != cError )
+	{
+		cout << "Error: Mass Spring snapshot \"" << sFileName << "\" " << cError << ".\n";
+		return false;
+	}
+
+	// Parameters
+	m_fK = sHeader.fK;
+	m_fRestLength = sHeader.fRestLength;
+	m_fMass = sHeader.fMass;
+	m_fDeltaT = sHeader.fDeltaT;
+	m_fDamping_Coeff = sHeader.fDampingCoeff;
+	m_fCollisionK = sHeader.fCollisionK;
+	m_fCollisionDamp = sHeader.fCollisionDamp;
+	m_iLoopCount = sHeader.iLoopCount;
+	m_eOrdering = (MassOrdering)sHeader.iOrdering;
+	m_eIntegrator = (IntegratorType)sHeader.iIntegrator;
+	m_vStartPos = vec3( sHeader.fStartPos[ 0 ], sHeader.fStartPos[ 1 ], sHeader.fStartPos[ 2 ] );
+	m_pImplicitSolver->setMaxIterations( sHeader.iCGIterations );
+	m_pImplicitSolver->setTolerance( sHeader.fCGTolerance );
+	m_pXPBDSolver->setIterations( sHeader.iXPBDIterations );
+	m_pXPBDSolver->setIterationType( (XPBDSolver::eIterationType)sHeader.iXPBDIterationType );
+	m_pProjectiveSolver->setIterations( sHeader.iPDIterations );
+	m_bAdaptiveSteps = 0 != sHeader.iAdaptiveSteps;
+	m_iStepLogFrames = sHeader.iStepLogFrames;
+	m_fStepTolerance = sHeader.fStepTolerance;
+	m_fFrameBudget = sHeader.fFrameBudget;
+	m_bSelfCollision = 0 != sHeader.iSelfCollision;
+	m_pSelfCollision->setDistance( sHeader.fSelfCollisionDistance );
+	m_bSleep = 0 != sHeader.iSleep;
+	m_iSleepFrames = sHeader.iSleepFrames;
+	m_fSleepEnergy = sHeader.fSleepEnergy;
+
+	// Masses, springs and contacts, then the state derived from them
+	m_sMasses.m_vPosition.resize( sHeader.iNumMasses );
+	m_sMasses.m_vVelocity.resize( sHeader.iNumMasses );
+	m_sMasses.m_vForce.resize( sHeader.iNumMasses );
+	m_sMasses.m_fInvMass.resize( sHeader.iNumMasses );
+	m_sMasses.m_iFlags.resize( sHeader.iNumMasses );
+	m_sSprings.m_iMass1.resize( sHeader.iNumSprings );
+	m_sSprings.m_iMass2.resize( sHeader.iNumSprings );
+	m_sSprings.m_fRestLength.resize( sHeader.iNumSprings );
+	m_vColorOffsets.resize( sHeader.iNumColors + 1 );
+	m_sContacts.resize( sHeader.iNumMasses );
+
+	getSnapshotSections( sHeader, sSections );
+	for ( unsigned int s = 0; s < SNAP_STEP_VELOCITY; ++s )
+		memcpy( sSections[ s ].pData, sFile.getData() + sHeader.iSectionOffset[ s ], sSections[ s ].iBytes );
+
+	// Two springs of a colour sharing a mass would race in the parallel passes, so the colours are rebuilt
+	//	rather than trusted.  The springs of a saved system are grouped by colour already and keep their order.
+	colorSprings();
+	prepareUpdate();
+
+	// Islands are numbered from the same springs, which were checked to make as many as were saved
+	m_vStepVelocity.resize( sHeader.iNumMasses );
+	m_sIslands.m_fPrevStrain.resize( sHeader.iNumIslands );
+	m_sIslands.m_iQuietFrames.resize( sHeader.iNumIslands );
+	getSnapshotSections( sHeader, sSections );
+	for ( unsigned int s = SNAP_STEP_VELOCITY; s < NUM_SNAPSHOT_SECTIONS; ++s )
+		memcpy( sSections[ s ].pData, sFile.getData() + sHeader.iSectionOffset[ s ], sSections[ s ].iBytes );
+
+	m_fAdaptiveDeltaT = sHeader.fAdaptiveDeltaT;
+	for ( unsigned int m = 0; m < m_sMasses.size(); ++m )
+	{
+		if ( m_sMasses.isSleeping( m ) )
+			m_sIslands.m_bSleeping[ m_sIslands.m_iMassIsland[ m ] ] = 1;
+	}
+
+	m_sIslands.fit( m_sMasses );
+	buildActiveSet();
+	resetStepLog();
+	m_iStepCount = sHeader.iStepCount;
+	m_iEnvironmentChanges = ENVIRONMENT_UNSEEN;
+	m_sPublished.fill( m_sMasses.m_vPosition );
+
+	return true;
+}
@@ -3,6 +3,9 @@
 Mesh::Mesh( const string &sFileName )
 {
 	m_sFileName = sFileName;
+	m_pMesh = nullptr;
+	m_pBVH = nullptr;
+	m_pSDF = nullptr;
 }
 
 // Delete any buffers that we initialized
@@ -15,6 +18,12 @@ Mesh::~Mesh()
 
 	if (nullptr != m_pMesh)
 		delete m_pMesh;
+
+	if (nullptr != m_pBVH)
+		delete m_pBVH;
+
+	if (nullptr != m_pSDF)
+		delete m_pSDF;
 }
 
 // Load the Mesh from a given file name
@@ -42,6 +51,49 @@ bool Mesh::genMesh( const string& sFileName )
 	return bReturnValue;
 }
 
+// Copies the vertices of the TriMesh for the collision structures
+void Mesh::getVertices( vector< vec3 >& vVertices ) const
+{
+	vVertices.clear();
+	vVertices.reserve( m_pMesh->vertices.size() );
+	for ( unsigned int i = 0; i < m_pMesh->vertices.size(); ++i )
+		vVertices.push_back( vec3( m_pMesh->vertices[ i ][ 0 ], m_pMesh->vertices[ i ][ 1 ], m_pMesh->vertices[ i ][ 2 ] ) );
+}
+
+// Builds the collision BVH from the loaded faces.
+void Mesh::buildBVH()
+{
+	vector< vec3 > vVertices;
+
+	getVertices( vVertices );
+
+	if ( nullptr != m_pBVH )
+		delete m_pBVH;
+
+	m_pBVH = new MeshBVH( vVertices, m_pIndices );
+}
+
+// Loads the signed distance field cached beside the mesh file (bunny.ply -> bunny.sdf), or builds it and
+//	writes the cache if there's none for this resolution and these vertices.
+void Mesh::buildSDF( unsigned int iResolution )
+{
+	size_t iExtension = m_sFileName.find_last_of( '.' );
+	string sCacheFile = m_sFileName.substr( 0, iExtension ) + ".sdf";
+	vector< vec3 > vVertices;
+
+	if ( nullptr == m_pSDF )
+		m_pSDF = new MeshSDF();
+
+	getVertices( vVertices );
+	if ( !m_pSDF->load( sCacheFile, iResolution, vVertices, m_pIndices ) )
+	{
+		m_pSDF->build( vVertices, m_pIndices, iResolution );
+
+		if ( !m_pSDF->save( sCacheFile ) )
+			cout << "Unable to cache the distance field of " << m_sFileName << " to " << sCacheFile << endl;
+	}
+}
+
 void Mesh::initMesh()
 {
 	glGenVertexArrays( 1, &m_iVertexArray );
@@ -0,0 +1,281 @@
+#include "MeshBVH.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define MESH_BVH_BINS 16			// Split candidates per axis for the surface area heuristic
+#define MESH_BVH_LEAF_SIZE 2		// Always a leaf at or under this many triangles
+#define MESH_BVH_MAX_LEAF_SIZE 8	// Never a leaf above this many triangles (unless they can't be split)
+#define MESH_BVH_TRAVERSAL_COST 1.0f	// Cost of visiting a node relative to testing a triangle
+
+// Surface area of a box, for the heuristic
+static float surfaceArea( const vec3& vMin, const vec3& vMax )
+{
+	vec3 vExtent = max( vMax - vMin, vec3( 0.0f ) );
+	return 2.0f * (vExtent.x * vExtent.y + vExtent.y * vExtent.z + vExtent.z * vExtent.x);
+}
+
+// Builds the tree over every triangle then stores the triangles in leaf order.
+MeshBVH::MeshBVH( const vector< vec3 >& vVertices, const vector< unsigned int >& iIndices )
+{
+	unsigned int iNumTriangles = iIndices.size() / 3;
+	vector< BuildTriangle > vBuild( iNumTriangles );
+	vector< Triangle > vSource( iNumTriangles );
+
+	for ( unsigned int t = 0; t < iNumTriangles; ++t )
+	{
+		const vec3& v0 = vVertices[ iIndices[ 3 * t ] ];
+		const vec3& v1 = vVertices[ iIndices[ 3 * t + 1 ] ];
+		const vec3& v2 = vVertices[ iIndices[ 3 * t + 2 ] ];
+
+		vSource[ t ].vVertex = v0;
+		vSource[ t ].vEdge1 = v1 - v0;
+		vSource[ t ].vEdge2 = v2 - v0;
+
+		vBuild[ t ].vMin = min( v0, min( v1, v2 ) );
+		vBuild[ t ].vMax = max( v0, max( v1, v2 ) );
+		vBuild[ t ].vCentroid = (vBuild[ t ].vMin + vBuild[ t ].vMax) * 0.5f;
+		vBuild[ t ].iIndex = t;
+	}
+
+	if ( iNumTriangles > 0 )
+	{
+		m_vNodes.reserve( 2 * iNumTriangles / MESH_BVH_LEAF_SIZE + 1 );
+		buildNode( vBuild, 0, iNumTriangles, 1 );
+	}
+
+	m_vTriangles.resize( iNumTriangles );
+	for ( unsigned int t = 0; t < iNumTriangles; ++t )
+		m_vTriangles[ t ] = vSource[ vBuild[ t ].iIndex ];
+}
+
+// Splits vBuild[iFirst, iFirst + iCount) with the binned surface area heuristic along the longest axis of the
+//	centroids, falling back to a median split if the bins can't separate them.  Returns the index of the new node.
+unsigned int MeshBVH::buildNode( vector< BuildTriangle >& vBuild, unsigned int iFirst, unsigned int iCount, unsigned int iDepth )
+{
+	unsigned int iNode = m_vNodes.size();
+	vec3 vMin( FLT_MAX ), vMax( -FLT_MAX ), vCentroidMin( FLT_MAX ), vCentroidMax( -FLT_MAX );
+	Node sNode;
+
+	for ( unsigned int i = iFirst; i < iFirst + iCount; ++i )
+	{
+		vMin = min( vMin, vBuild[ i ].vMin );
+		vMax = max( vMax, vBuild[ i ].vMax );
+		vCentroidMin = min( vCentroidMin, vBuild[ i ].vCentroid );
+		vCentroidMax = max( vCentroidMax, vBuild[ i ].vCentroid );
+	}
+
+	for ( int a = 0; a < 3; ++a )
+	{
+		sNode.fMin[ a ] = vMin[ a ];
+		sNode.fMax[ a ] = vMax[ a ];
+	}
+	sNode.iOffset = iFirst;
+	sNode.iCount = iCount;
+	m_vNodes.push_back( sNode );
+
+	vec3 vExtent = vCentroidMax - vCentroidMin;
+	int iAxis = (vExtent.x >= vExtent.y && vExtent.x >= vExtent.z) ? 0 : (vExtent.y >= vExtent.z ? 1 : 2);
+
+	// Leaf: few triangles, all centered on the same point, or the traversal stack limit reached
+	if ( iCount <= MESH_BVH_LEAF_SIZE || iDepth + 2 >= MESH_BVH_STACK_SIZE || vExtent[ iAxis ] <= 0.0f )
+		return iNode;
+
+	// Bin the centroids and find the cheapest split between bins
+	struct Bin
+	{
+		vec3 vMin, vMax;
+		unsigned int iCount;
+	} sBins[ MESH_BVH_BINS ];
+	float fBinScale = MESH_BVH_BINS / vExtent[ iAxis ];
+
+	for ( int b = 0; b < MESH_BVH_BINS; ++b )
+	{
+		sBins[ b ].vMin = vec3( FLT_MAX );
+		sBins[ b ].vMax = vec3( -FLT_MAX );
+		sBins[ b ].iCount = 0;
+	}
+
+	for ( unsigned int i = iFirst; i < iFirst + iCount; ++i )
+	{
+		int b = std::min( (int)((vBuild[ i ].vCentroid[ iAxis ] - vCentroidMin[ iAxis ]) * fBinScale), MESH_BVH_BINS - 1 );
+		sBins[ b ].vMin = min( sBins[ b ].vMin, vBuild[ i ].vMin );
+		sBins[ b ].vMax = max( sBins[ b ].vMax, vBuild[ i ].vMax );
+		++sBins[ b ].iCount;
+	}
+
+	// Sweep from the right for the area and count right of every split, then from the left
+	float fRightArea[ MESH_BVH_BINS ];
+	unsigned int iRightCount[ MESH_BVH_BINS ];
+	vec3 vSideMin( FLT_MAX ), vSideMax( -FLT_MAX );
+	unsigned int iSideCount = 0;
+
+	for ( int b = MESH_BVH_BINS - 1; b > 0; --b )
+	{
+		vSideMin = min( vSideMin, sBins[ b ].vMin );
+		vSideMax = max( vSideMax, sBins[ b ].vMax );
+		iSideCount += sBins[ b ].iCount;
+		fRightArea[ b ] = (iSideCount > 0) ? surfaceArea( vSideMin, vSideMax ) : 0.0f;
+		iRightCount[ b ] = iSideCount;
+	}
+
+	float fBestCost = FLT_MAX;
+	int iBestSplit = -1;
+
+	vSideMin = vec3( FLT_MAX );
+	vSideMax = vec3( -FLT_MAX );
+	iSideCount = 0;
+	for ( int b = 1; b < MESH_BVH_BINS; ++b )
+	{
+		vSideMin = min( vSideMin, sBins[ b - 1 ].vMin );
+		vSideMax = max( vSideMax, sBins[ b - 1 ].vMax );
+		iSideCount += sBins[ b - 1 ].iCount;
+
+		if ( 0 == iSideCount || 0 == iRightCount[ b ] )
+			continue;
+
+		float fCost = surfaceArea( vSideMin, vSideMax ) * iSideCount + fRightArea[ b ] * iRightCount[ b ];
+		if ( fCost < fBestCost )
+		{
+			fBestCost = fCost;
+			iBestSplit = b;
+		}
+	}
+
+	// Splitting has to beat testing every triangle here
+	float fLeafCost = surfaceArea( vMin, vMax ) * iCount;
+	fBestCost = MESH_BVH_TRAVERSAL_COST * surfaceArea( vMin, vMax ) + fBestCost;
+	if ( iCount <= MESH_BVH_MAX_LEAF_SIZE && fBestCost >= fLeafCost )
+		return iNode;
+
+	unsigned int iHalf;
+	if ( iBestSplit > 0 )
+	{
+		float fOrigin = vCentroidMin[ iAxis ];
+		BuildTriangle* pMiddle = partition( vBuild.data() + iFirst, vBuild.data() + iFirst + iCount,
+			[ iAxis, fOrigin, fBinScale, iBestSplit ]( const BuildTriangle& sTriangle )
+			{ return std::min( (int)((sTriangle.vCentroid[ iAxis ] - fOrigin) * fBinScale), MESH_BVH_BINS - 1 ) < iBestSplit; } );
+		iHalf = pMiddle - (vBuild.data() + iFirst);
+	}
+	else
+		iHalf = 0;
+
+	// The bins couldn't separate them, split at the median centroid instead
+	if ( 0 == iHalf || iCount == iHalf )
+	{
+		iHalf = iCount / 2;
+		nth_element( vBuild.begin() + iFirst, vBuild.begin() + iFirst + iHalf, vBuild.begin() + iFirst + iCount,
+					 [ iAxis ]( const BuildTriangle& sA, const BuildTriangle& sB ) { return sA.vCentroid[ iAxis ] < sB.vCentroid[ iAxis ]; } );
+	}
+
+	m_vNodes[ iNode ].iCount = 0;
+	buildNode( vBuild, iFirst, iHalf, iDepth + 1 );
+	unsigned int iRight = buildNode( vBuild, iFirst + iHalf, iCount - iHalf, iDepth + 1 );
+	m_vNodes[ iNode ].iOffset = iRight;
+
+	return iNode;
+}
+
+// Distance (as a fraction of the ray) at which the segment enters the node's box, FLT_MAX if it misses
+//	it or only reaches it past fMaxT.
+float MeshBVH::entryDistance( const Node& sNode, const vec3& vStart, const vec3& vInvRay, float fMaxT ) const
+{
+	float fEntry = 0.0f, fExit = fMaxT;
+
+	for ( int a = 0; a < 3; ++a )
+	{
+		float fT0 = (sNode.fMin[ a ] - vStart[ a ]) * vInvRay[ a ];
+		float fT1 = (sNode.fMax[ a ] - vStart[ a ]) * vInvRay[ a ];
+
+		// NaN (start on a slab of a box parallel to the ray) leaves the range as is
+		fEntry = fmax( fEntry, fmin( fT0, fT1 ) );
+		fExit = fmin( fExit, fmax( fT0, fT1 ) );
+	}
+
+	return (fEntry <= fExit) ? fEntry : FLT_MAX;
+}
+
+// Front to back traversal: the nearer child is visited first and nodes entered past the closest hit are skipped.
+bool MeshBVH::intersect( const vec3& vStart, const vec3& vRay, float& fT, vec3& vNormal ) const
+{
+	unsigned int iStack[ MESH_BVH_STACK_SIZE ];
+	unsigned int iTop = 0;
+	vec3 vInvRay = 1.0f / vRay;
+	float fClosest = 1.0f;
+	bool bHit = false;
+
+	if ( !m_vNodes.empty() && entryDistance( m_vNodes[ 0 ], vStart, vInvRay, fClosest ) < FLT_MAX )
+		iStack[ iTop++ ] = 0;
+
+	while ( iTop > 0 )
+	{
+		unsigned int iNode = iStack[ --iTop ];
+		const Node& sNode = m_vNodes[ iNode ];
+
+		if ( sNode.iCount > 0 )
+		{
+			for ( unsigned int t = sNode.iOffset; t < sNode.iOffset + sNode.iCount; ++t )
+			{
+				const Triangle& sTriangle = m_vTriangles[ t ];
+				vec3 vP = cross( vRay, sTriangle.vEdge2 );
+				float fDet = dot( sTriangle.vEdge1, vP );
+
+				if ( 0.0f == fDet )		// Parallel to the triangle
+					continue;
+
+				float fInvDet = 1.0f / fDet;
+				vec3 vS = vStart - sTriangle.vVertex;
+				float fU = dot( vS, vP ) * fInvDet;
+				if ( fU < 0.0f || fU > 1.0f )
+					continue;
+
+				vec3 vQ = cross( vS, sTriangle.vEdge1 );
+				float fV = dot( vRay, vQ ) * fInvDet;
+				if ( fV < 0.0f || fU + fV > 1.0f )
+					continue;
+
+				float fHitT = dot( sTriangle.vEdge2, vQ ) * fInvDet;
+				if ( fHitT >= 0.0f && fHitT <= fClosest )
+				{
+					fClosest = fHitT;
+					vNormal = cross( sTriangle.vEdge1, sTriangle.vEdge2 );
+					bHit = true;
+				}
+			}
+		}
+		else
+		{
+			unsigned int iNear = iNode + 1, iFar = sNode.iOffset;
+			float fNear = entryDistance( m_vNodes[ iNear ], vStart, vInvRay, fClosest );
+			float fFar = entryDistance( m_vNodes[ iFar ], vStart, vInvRay, fClosest );
+
+			if ( fFar < fNear )
+			{
+				swap( iNear, iFar );
+				swap( fNear, fFar );
+			}
+
+			if ( fFar < FLT_MAX )
+				iStack[ iTop++ ] = iFar;
+			if ( fNear < FLT_MAX )
+				iStack[ iTop++ ] = iNear;
+		}
+	}
+
+	if ( bHit )
+		fT = fClosest;
+
+	return bHit;
+}
+
+// Box of the root node
+void MeshBVH::getBounds( vec3& vMin, vec3& vMax ) const
+{
+	if ( m_vNodes.empty() )
+		vMin = vMax = vec3( 0.0f );
+	else
+	{
+		vMin = vec3( m_vNodes[ 0 ].fMin[ 0 ], m_vNodes[ 0 ].fMin[ 1 ], m_vNodes[ 0 ].fMin[ 2 ] );
+		vMax = vec3( m_vNodes[ 0 ].fMax[ 0 ], m_vNodes[ 0 ].fMax[ 1 ], m_vNodes[ 0 ].fMax[ 2 ] );
+	}
+}
@@ -29,8 +29,11 @@ MeshManager::~MeshManager()
 //				Reference to the texture.
 // Parameters:	sFileName - The location of the file to load.
 //				pUser - The 3D Object requesting a reference to the texture.
+//				iSDFResolution - Cells along the longest side of the mesh for its signed distance field,
+//								 0 for none.  The field is shared like the mesh: it's rebuilt when a user
+//								 asks for a finer one than it has, every user gets the finest.
 // Written by:  James Cote
-Mesh* MeshManager::loadMesh( const string& sFileName, long lID )
+Mesh* MeshManager::loadMesh( const string& sFileName, long lID, unsigned int iSDFResolution )
 {
 	// Attempt to grab it from the texture cache if it already exists
 	Mesh* pReturnMesh = nullptr;
@@ -72,10 +75,24 @@ Mesh* MeshManager::loadMesh( const string& sFileName, long lID )
 		}
 	}
 
+	if ( nullptr != pReturnMesh && iSDFResolution > 0 )
+	{
+		const MeshSDF* pSDF = pReturnMesh->getSDF();
+
+		if ( nullptr != pSDF && pSDF->getResolution() != iSDFResolution )
+			cout << "Warning: " << sFileName << " is shared at distance field resolution "
+				 << std::max( pSDF->getResolution(), iSDFResolution ) << ", asked for "
+				 << std::min( pSDF->getResolution(), iSDFResolution ) << endl;
+
+		if ( nullptr == pSDF || pSDF->getResolution() < iSDFResolution )
+			pReturnMesh->buildSDF( iSDFResolution );
+	}
+
 	return pReturnMesh;
 }
 
 // Attempts to Initialize and return a new mesh object from a given object file.
+//	The collision BVH is built here, once per file, and shared by every user of the mesh.
 // Returns: Mesh Object created or nullptr if mesh failed to create.
 //			Bool: Returns true on Success, False on failure.
 bool MeshManager::initializeMesh( Mesh* pReturnMesh, const string& sFileName )
@@ -86,6 +103,9 @@ bool MeshManager::initializeMesh( Mesh* pReturnMesh, const string& sFileName )
 	if ( bReturnValue )
 		bReturnValue = pReturnMesh->genMesh( sFileName );
 
+	if ( bReturnValue )
+		pReturnMesh->buildBVH();
+
 	// Return result.
 	return bReturnValue;
 }
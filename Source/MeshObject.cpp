@@ -2,7 +2,7 @@
 #define PI					3.14159265f
 
 MeshObject::MeshObject( const glm::vec3* pPosition, const string* sFileName, long lID, 
-						const string* sTexName, const Anim_Track* pAnimTrack )
+						const string* sTexName, const Anim_Track* pAnimTrack, unsigned int iSDFResolution )
 	: Object3D( pPosition, lID, sTexName, pAnimTrack )
 {
 	m_fScale = 0.01f;
@@ -11,7 +11,7 @@ MeshObject::MeshObject( const glm::vec3* pPosition, const string* sFileName, lon
 
 	ShaderManager* pShdrMngr = ShaderManager::getInstance();
 
-	m_pMesh = MeshManager::getInstance()->loadMesh( *sFileName, m_lID );
+	m_pMesh = MeshManager::getInstance()->loadMesh( *sFileName, m_lID, iSDFResolution );
 	m_pMesh->initMesh( );
 	
 	//m_pEdgeBuffer = new EdgeBuffer( m_iVertexArray );
@@ -46,9 +46,7 @@ void MeshObject::draw( const vec3& vCamLookAt, float fMinThreshold, float fMaxTh
 	// Draw the Animation Track
 	if ( nullptr != m_pAnimTrack )
 	{
-		if( !m_bPause )
-			m_pAnimTrack->animate();
-		pPositionTranslated = m_pAnimTrack->getFreNetFrames() * scale( vec3( m_fScale ) ) * toMat4( m_pQuaternion );
+		pPositionTranslated = getModelMatrix( getPublishedFrame() );
 		pShdrMngr->setUnifromMatrix4x4( ShaderManager::eShaderType::MESH_SHDR, "translate", &pPositionTranslated );
 		m_pAnimTrack->draw();
 	}
@@ -82,3 +80,95 @@ void MeshObject::calculateUVs()
 {
 	// Nothing ot Implement
 }
+
+// Model matrix of the mesh at mFrame, the Frenet frame of the Animation Track (identity without one): the scale
+//	and the orientation, then the frame.  Collisions take the track's current frame, drawing the published one.
+mat4 MeshObject::getModelMatrix( const mat4& mFrame ) const
+{
+	return mFrame * scale( vec3( m_fScale ) ) * toMat4( m_pQuaternion );
+}
+
+// Segment from vStart to vStart + vRay against the mesh: a lookup in its distance field if it has one,
+//	otherwise a ray cast through its BVH.  fT is the distance along the normalized ray like the other objects;
+//	the normal faces the start of the ray.
+bool MeshObject::intersect( const mat4& mInverse, const mat3& mNormalMatrix, const vec3& vStart, const vec3& vRay,
+							float& fT, vec3& vIntersectingNormal ) const
+{
+	const MeshBVH* pBVH = m_pMesh->getBVH();
+	const MeshSDF* pSDF = m_pMesh->getSDF();
+	vec3 vLocalStart = vec3( mInverse * vec4( vStart, 1.0f ) );
+	vec3 vLocalRay = vec3( mInverse * vec4( vRay, 0.0f ) );
+	vec3 vNormal;
+	float fFraction;
+	bool bReturn = false;
+
+	if ( vRay != vec3( 0.0f ) )
+	{
+		if ( nullptr != pSDF && !pSDF->empty() )
+			bReturn = pSDF->intersect( vLocalStart, vLocalRay, fFraction, vNormal );
+		else if ( nullptr != pBVH )
+			bReturn = pBVH->intersect( vLocalStart, vLocalRay, fFraction, vNormal );
+	}
+
+	if ( bReturn )
+	{
+		vNormal = normalize( mNormalMatrix * vNormal );
+		vIntersectingNormal = (dot( vNormal, vRay ) > 0.0f) ? -vNormal : vNormal;
+		fT = fFraction * length( vRay );
+	}
+
+	return bReturn;
+}
+
+// Checks collision of ray from start point against the mesh.
+bool MeshObject::isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal )
+{
+	mat4 mModel = getModelMatrix( Object::getFreNetFrames() );
+
+	return intersect( inverse( mModel ), transpose( inverse( mat3( mModel ) ) ), vStart, vRay, fT, vIntersectingNormal );
+}
+
+// Batched isCollision: the transforms are only computed once for the whole batch.
+void MeshObject::findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+								unsigned int* pObject, unsigned int iObject )
+{
+	mat4 mModel = getModelMatrix( Object::getFreNetFrames() );
+	mat4 mInverse = inverse( mModel );
+	mat3 mNormalMatrix = transpose( inverse( mat3( mModel ) ) );
+	float fT;
+	vec3 vNormal;
+
+	for ( unsigned int i = 0; i < iCount; ++i )
+	{
+		if ( intersect( mInverse, mNormalMatrix, pStart[ i ], pRay[ i ], fT, vNormal ) && fT < pT[ i ] )
+		{
+			pT[ i ] = fT;
+			pNormal[ i ] = vNormal;
+			pObject[ i ] = iObject;
+		}
+	}
+}
+
+// World space box of the mesh's bounds under the model matrix
+bool MeshObject::getBounds( vec3& vMin, vec3& vMax )
+{
+	const MeshBVH* pBVH = m_pMesh->getBVH();
+	mat4 mModel = getModelMatrix( Object::getFreNetFrames() );
+	vec3 vLocalMin, vLocalMax;
+
+	if ( nullptr == pBVH || 0 == pBVH->getNumTriangles() )
+		return false;
+
+	pBVH->getBounds( vLocalMin, vLocalMax );
+	vMin = vec3( FLT_MAX );
+	vMax = vec3( -FLT_MAX );
+	for ( int i = 0; i < 8; ++i )
+	{
+		vec3 vCorner( (i & 1) ? vLocalMax.x : vLocalMin.x, (i & 2) ? vLocalMax.y : vLocalMin.y, (i & 4) ? vLocalMax.z : vLocalMin.z );
+		vCorner = vec3( mModel * vec4( vCorner, 1.0f ) );
+		vMin = min( vMin, vCorner );
+		vMax = max( vMax, vCorner );
+	}
+
+	return true;
+}
@@ -0,0 +1,412 @@
+#include "MeshSDF.h"
+#include <unordered_map>
+
+/***********\
+ * DEFINES *
+\***********/
+#define MESH_SDF_MAGIC 0x46445353	// "SSDF"
+#define MESH_SDF_VERSION 2
+#define FNV_OFFSET 0xcbf29ce484222325ull	// 64-bit FNV-1a parameters for the hash of the mesh's data
+#define FNV_PRIME 0x100000001b3ull
+#define BRICK_EDGE (MESH_SDF_BRICK + 1)
+#define FAR_SAMPLE FLT_MAX			// Sample further than the band from every triangle: its sign isn't known
+
+// Triangle with the angle weighted pseudo normals of its features, the sign of the distance to a point is
+//	taken from the normal of the feature closest to it (Baerentzen and Aanaes).
+struct SDFTriangle
+{
+	vec3 vVertex[ 3 ];
+	vec3 vFaceNormal;
+	vec3 vEdgeNormal[ 3 ];		// Edge i goes from vertex i to vertex (i + 1) % 3
+	vec3 vVertexNormal[ 3 ];
+	vec3 vMin, vMax;
+};
+
+// Key of the undirected edge between two vertices
+static unsigned long long edgeKey( unsigned int iA, unsigned int iB )
+{
+	return (iA < iB) ? ((unsigned long long)iA << 32 | iB) : ((unsigned long long)iB << 32 | iA);
+}
+
+// FNV-1a hash of the bytes of the vertices and indices, to tell a cache built from another version of the
+//	mesh.
+static unsigned long long hashMesh( const vector< vec3 >& vVertices, const vector< unsigned int >& iIndices )
+{
+	unsigned long long iHash = FNV_OFFSET;
+	const unsigned char* pBytes = (const unsigned char*)vVertices.data();
+
+	for ( size_t i = 0; i < vVertices.size() * sizeof( vec3 ); ++i )
+		iHash = (iHash ^ pBytes[ i ]) * FNV_PRIME;
+
+	pBytes = (const unsigned char*)iIndices.data();
+	for ( size_t i = 0; i < iIndices.size() * sizeof( unsigned int ); ++i )
+		iHash = (iHash ^ pBytes[ i ]) * FNV_PRIME;
+
+	return iHash;
+}
+
+// Closest point to vPoint on the triangle (Ericson, Real-Time Collision Detection 5.1.5) and the normal of the
+//	feature it lies on.
+static vec3 closestPoint( const SDFTriangle& sTri, const vec3& vPoint, vec3& vFeatureNormal )
+{
+	const vec3& vA = sTri.vVertex[ 0 ];
+	const vec3& vB = sTri.vVertex[ 1 ];
+	const vec3& vC = sTri.vVertex[ 2 ];
+	vec3 vAB = vB - vA, vAC = vC - vA, vAP = vPoint - vA;
+	float fD1 = dot( vAB, vAP ), fD2 = dot( vAC, vAP );
+
+	if ( fD1 <= 0.0f && fD2 <= 0.0f )
+	{
+		vFeatureNormal = sTri.vVertexNormal[ 0 ];
+		return vA;
+	}
+
+	vec3 vBP = vPoint - vB;
+	float fD3 = dot( vAB, vBP ), fD4 = dot( vAC, vBP );
+	if ( fD3 >= 0.0f && fD4 <= fD3 )
+	{
+		vFeatureNormal = sTri.vVertexNormal[ 1 ];
+		return vB;
+	}
+
+	float fVC = fD1 * fD4 - fD3 * fD2;
+	if ( fVC <= 0.0f && fD1 >= 0.0f && fD3 <= 0.0f )
+	{
+		vFeatureNormal = sTri.vEdgeNormal[ 0 ];
+		return vA + vAB * (fD1 / (fD1 - fD3));
+	}
+
+	vec3 vCP = vPoint - vC;
+	float fD5 = dot( vAB, vCP ), fD6 = dot( vAC, vCP );
+	if ( fD6 >= 0.0f && fD5 <= fD6 )
+	{
+		vFeatureNormal = sTri.vVertexNormal[ 2 ];
+		return vC;
+	}
+
+	float fVB = fD5 * fD2 - fD1 * fD6;
+	if ( fVB <= 0.0f && fD2 >= 0.0f && fD6 <= 0.0f )
+	{
+		vFeatureNormal = sTri.vEdgeNormal[ 2 ];
+		return vA + vAC * (fD2 / (fD2 - fD6));
+	}
+
+	float fVA = fD3 * fD6 - fD5 * fD4;
+	if ( fVA <= 0.0f && (fD4 - fD3) >= 0.0f && (fD5 - fD6) >= 0.0f )
+	{
+		vFeatureNormal = sTri.vEdgeNormal[ 1 ];
+		return vB + (vC - vB) * ((fD4 - fD3) / ((fD4 - fD3) + (fD5 - fD6)));
+	}
+
+	float fDenom = 1.0f / (fVA + fVB + fVC);
+	vFeatureNormal = sTri.vFaceNormal;
+	return vA + vAB * (fVB * fDenom) + vAC * (fVC * fDenom);
+}
+
+// Only bricks within the band of a triangle are stored.  Each stored brick keeps the list of triangles whose
+//	band overlaps it, then every brick computes its samples from its own list, so bricks build in parallel.
+void MeshSDF::build( const vector< vec3 >& vVertices, const vector< unsigned int >& iIndices, unsigned int iResolution )
+{
+	unsigned int iNumTriangles = iIndices.size() / 3;
+	vector< SDFTriangle > vTriangles;
+	vector< unsigned int > iSource;		// Triangle in iIndices of each entry of vTriangles
+	vector< vec3 > vVertexNormals( vVertices.size(), vec3( 0.0f ) );
+	unordered_map< unsigned long long, vec3 > vEdgeNormals;
+	vec3 vMin( FLT_MAX ), vMax( -FLT_MAX );
+
+	m_iResolution = iResolution;
+	m_iNumTriangles = iNumTriangles;
+	m_iMeshHash = hashMesh( vVertices, iIndices );
+	m_iBricks.clear();
+	m_fSamples.clear();
+
+	if ( 0 == iNumTriangles || 0 == iResolution )
+		return;
+
+	// Face normals, summed into the edges and (weighted by the angle at the vertex) into the vertices
+	vTriangles.reserve( iNumTriangles );
+	for ( unsigned int t = 0; t < iNumTriangles; ++t )
+	{
+		const unsigned int* pIndex = &iIndices[ 3 * t ];
+		SDFTriangle sTri;
+
+		for ( int v = 0; v < 3; ++v )
+			sTri.vVertex[ v ] = vVertices[ pIndex[ v ] ];
+
+		vec3 vNormal = cross( sTri.vVertex[ 1 ] - sTri.vVertex[ 0 ], sTri.vVertex[ 2 ] - sTri.vVertex[ 0 ] );
+		float fLength = length( vNormal );
+
+		// Degenerate triangles are covered by their neighbours
+		if ( fLength <= FLT_EPSILON )
+			continue;
+
+		sTri.vFaceNormal = vNormal / fLength;
+		for ( int v = 0; v < 3; ++v )
+		{
+			vec3 vNext = normalize( sTri.vVertex[ (v + 1) % 3 ] - sTri.vVertex[ v ] );
+			vec3 vPrev = normalize( sTri.vVertex[ (v + 2) % 3 ] - sTri.vVertex[ v ] );
+
+			vVertexNormals[ pIndex[ v ] ] += sTri.vFaceNormal * acos( clamp( dot( vNext, vPrev ), -1.0f, 1.0f ) );
+			vEdgeNormals[ edgeKey( pIndex[ v ], pIndex[ (v + 1) % 3 ] ) ] += sTri.vFaceNormal;
+		}
+
+		sTri.vMin = min( sTri.vVertex[ 0 ], min( sTri.vVertex[ 1 ], sTri.vVertex[ 2 ] ) );
+		sTri.vMax = max( sTri.vVertex[ 0 ], max( sTri.vVertex[ 1 ], sTri.vVertex[ 2 ] ) );
+		vMin = min( vMin, sTri.vMin );
+		vMax = max( vMax, sTri.vMax );
+		vTriangles.push_back( sTri );
+		iSource.push_back( t );
+	}
+
+	if ( vTriangles.empty() )
+		return;
+
+	// Pseudo normals only decide a sign, they don't need normalizing
+	for ( unsigned int s = 0; s < vTriangles.size(); ++s )
+	{
+		const unsigned int* pIndex = &iIndices[ 3 * iSource[ s ] ];
+
+		for ( int v = 0; v < 3; ++v )
+		{
+			vTriangles[ s ].vVertexNormal[ v ] = vVertexNormals[ pIndex[ v ] ];
+			vTriangles[ s ].vEdgeNormal[ v ] = vEdgeNormals[ edgeKey( pIndex[ v ], pIndex[ (v + 1) % 3 ] ) ];
+		}
+	}
+
+	// Grid over the bounds padded by the band
+	vec3 vExtent = vMax - vMin;
+	float fBand;
+
+	m_fCellSize = std::max( vExtent.x, std::max( vExtent.y, vExtent.z ) ) / iResolution;
+	if ( m_fCellSize <= 0.0f )
+		m_fCellSize = 1.0f;
+	fBand = MESH_SDF_BAND * m_fCellSize;
+	m_vOrigin = vMin - vec3( fBand + m_fCellSize );
+
+	for ( int a = 0; a < 3; ++a )
+	{
+		int iCells = (int)ceil( (vExtent[ a ] + 2.0f * (fBand + m_fCellSize)) / m_fCellSize );
+		m_iBricksPerAxis[ a ] = (iCells + MESH_SDF_BRICK - 1) / MESH_SDF_BRICK;
+	}
+
+	// Triangles touching each brick
+	vector< vector< unsigned int > > iBrickTriangles( m_iBricksPerAxis[ 0 ] * m_iBricksPerAxis[ 1 ] * m_iBricksPerAxis[ 2 ] );
+	float fBrickSize = MESH_SDF_BRICK * m_fCellSize;
+
+	for ( unsigned int t = 0; t < vTriangles.size(); ++t )
+	{
+		ivec3 iFirst = ivec3( floor( (vTriangles[ t ].vMin - vec3( fBand ) - m_vOrigin) / fBrickSize ) );
+		ivec3 iLast = ivec3( floor( (vTriangles[ t ].vMax + vec3( fBand ) - m_vOrigin) / fBrickSize ) );
+
+		iFirst = max( iFirst, ivec3( 0 ) );
+		iLast = min( iLast, ivec3( m_iBricksPerAxis[ 0 ] - 1, m_iBricksPerAxis[ 1 ] - 1, m_iBricksPerAxis[ 2 ] - 1 ) );
+		for ( int z = iFirst.z; z <= iLast.z; ++z )
+			for ( int y = iFirst.y; y <= iLast.y; ++y )
+				for ( int x = iFirst.x; x <= iLast.x; ++x )
+					iBrickTriangles[ (z * m_iBricksPerAxis[ 1 ] + y) * m_iBricksPerAxis[ 0 ] + x ].push_back( t );
+	}
+
+	m_iBricks.assign( iBrickTriangles.size(), MESH_SDF_NO_BRICK );
+	int iNumBricks = 0;
+	for ( unsigned int b = 0; b < iBrickTriangles.size(); ++b )
+		if ( !iBrickTriangles[ b ].empty() )
+			m_iBricks[ b ] = iNumBricks++;
+
+	m_fSamples.assign( (size_t)iNumBricks * MESH_SDF_BRICK_SAMPLES, FAR_SAMPLE );
+
+	#pragma omp parallel for schedule(dynamic)
+	for ( int b = 0; b < (int)iBrickTriangles.size(); ++b )
+	{
+		if ( MESH_SDF_NO_BRICK == m_iBricks[ b ] )
+			continue;
+
+		int iBrickX = b % m_iBricksPerAxis[ 0 ];
+		int iBrickY = (b / m_iBricksPerAxis[ 0 ]) % m_iBricksPerAxis[ 1 ];
+		int iBrickZ = b / (m_iBricksPerAxis[ 0 ] * m_iBricksPerAxis[ 1 ]);
+		vec3 vBrickOrigin = m_vOrigin + vec3( iBrickX, iBrickY, iBrickZ ) * fBrickSize;
+		float* pSamples = &m_fSamples[ (size_t)m_iBricks[ b ] * MESH_SDF_BRICK_SAMPLES ];
+
+		for ( unsigned int i = 0; i < iBrickTriangles[ b ].size(); ++i )
+		{
+			const SDFTriangle& sTri = vTriangles[ iBrickTriangles[ b ][ i ] ];
+
+			// Samples of the brick within the band of the triangle's box
+			ivec3 iFirst = ivec3( ceil( (sTri.vMin - vec3( fBand ) - vBrickOrigin) / m_fCellSize ) );
+			ivec3 iLast = ivec3( floor( (sTri.vMax + vec3( fBand ) - vBrickOrigin) / m_fCellSize ) );
+
+			iFirst = max( iFirst, ivec3( 0 ) );
+			iLast = min( iLast, ivec3( MESH_SDF_BRICK ) );
+			for ( int z = iFirst.z; z <= iLast.z; ++z )
+				for ( int y = iFirst.y; y <= iLast.y; ++y )
+					for ( int x = iFirst.x; x <= iLast.x; ++x )
+					{
+						vec3 vPoint = vBrickOrigin + vec3( x, y, z ) * m_fCellSize;
+						vec3 vFeatureNormal;
+						vec3 vDiff = vPoint - closestPoint( sTri, vPoint, vFeatureNormal );
+						float fDistance = length( vDiff );
+						float& fSample = pSamples[ (z * BRICK_EDGE + y) * BRICK_EDGE + x ];
+
+						if ( fDistance <= fBand && fDistance < fabs( fSample ) )
+							fSample = (dot( vDiff, vFeatureNormal ) < 0.0f) ? -fDistance : fDistance;
+					}
+		}
+	}
+}
+
+// Trilinear interpolation of the cell containing vPoint.  Every corner needs a known distance, so points are
+//	found within (MESH_SDF_BAND - sqrt(3)) cells of the surface at least.
+bool MeshSDF::sample( const vec3& vPoint, float& fDistance, vec3& vGradient ) const
+{
+	vec3 vCell = (vPoint - m_vOrigin) / m_fCellSize;
+	vec3 vFloor = floor( vCell );
+	ivec3 iCell = ivec3( vFloor );
+	ivec3 iBrick = iCell / MESH_SDF_BRICK;
+
+	if ( m_fSamples.empty() || iCell.x < 0 || iCell.y < 0 || iCell.z < 0
+		 || iBrick.x >= m_iBricksPerAxis[ 0 ] || iBrick.y >= m_iBricksPerAxis[ 1 ] || iBrick.z >= m_iBricksPerAxis[ 2 ] )
+		return false;
+
+	int iBrickIndex = m_iBricks[ (iBrick.z * m_iBricksPerAxis[ 1 ] + iBrick.y) * m_iBricksPerAxis[ 0 ] + iBrick.x ];
+	if ( MESH_SDF_NO_BRICK == iBrickIndex )
+		return false;
+
+	ivec3 iLocal = iCell - iBrick * MESH_SDF_BRICK;
+	vec3 vFraction = vCell - vFloor;
+	float fCorner[ 2 ][ 2 ][ 2 ];
+
+	for ( int z = 0; z < 2; ++z )
+		for ( int y = 0; y < 2; ++y )
+			for ( int x = 0; x < 2; ++x )
+			{
+				fCorner[ z ][ y ][ x ] = getSample( iBrickIndex, iLocal.x + x, iLocal.y + y, iLocal.z + z );
+				if ( FAR_SAMPLE == fCorner[ z ][ y ][ x ] )
+					return false;
+			}
+
+	// Interpolate along x, then y, then z; the gradient is the derivative of the same interpolation
+	float fX[ 2 ][ 2 ], fDX[ 2 ][ 2 ], fY[ 2 ], fDX_Y[ 2 ], fDY[ 2 ];
+
+	for ( int z = 0; z < 2; ++z )
+		for ( int y = 0; y < 2; ++y )
+		{
+			fX[ z ][ y ] = mix( fCorner[ z ][ y ][ 0 ], fCorner[ z ][ y ][ 1 ], vFraction.x );
+			fDX[ z ][ y ] = fCorner[ z ][ y ][ 1 ] - fCorner[ z ][ y ][ 0 ];
+		}
+
+	for ( int z = 0; z < 2; ++z )
+	{
+		fY[ z ] = mix( fX[ z ][ 0 ], fX[ z ][ 1 ], vFraction.y );
+		fDX_Y[ z ] = mix( fDX[ z ][ 0 ], fDX[ z ][ 1 ], vFraction.y );
+		fDY[ z ] = fX[ z ][ 1 ] - fX[ z ][ 0 ];
+	}
+
+	fDistance = mix( fY[ 0 ], fY[ 1 ], vFraction.z );
+	vGradient = vec3( mix( fDX_Y[ 0 ], fDX_Y[ 1 ], vFraction.z ),
+					  mix( fDY[ 0 ], fDY[ 1 ], vFraction.z ),
+					  fY[ 1 ] - fY[ 0 ] ) / m_fCellSize;
+
+	return true;
+}
+
+// The end of the segment has to be inside, near the surface.  A start outside the band is taken to be at the
+//	band's edge: the crossing may be placed early, but it stays on the segment.
+bool MeshSDF::intersect( const vec3& vStart, const vec3& vRay, float& fT, vec3& vNormal ) const
+{
+	float fStart, fEnd, fCrossing;
+	vec3 vGradient;
+
+	if ( !sample( vStart + vRay, fEnd, vNormal ) || fEnd > 0.0f )
+		return false;
+
+	if ( !sample( vStart, fStart, vGradient ) )
+		fStart = MESH_SDF_BAND * m_fCellSize;
+
+	// Already inside: the crossing happened on an earlier step
+	if ( fStart <= 0.0f )
+		return false;
+
+	fT = fStart / (fStart - fEnd);
+	if ( sample( vStart + vRay * fT, fCrossing, vGradient ) && vGradient != vec3( 0.0f ) )
+		vNormal = vGradient;
+
+	return vNormal != vec3( 0.0f );
+}
+
+// Writes the grid and its bricks.
+bool MeshSDF::save( const string& sFileName ) const
+{
+	ofstream outFile( sFileName, ios::binary );
+	unsigned int iHeader[ 4 ] = { MESH_SDF_MAGIC, MESH_SDF_VERSION, m_iResolution, m_iNumTriangles };
+	unsigned int iSizes[ 2 ] = { (unsigned int)m_iBricks.size(), (unsigned int)m_fSamples.size() };
+
+	if ( !outFile.good() )
+		return false;
+
+	outFile.write( (const char*)iHeader, sizeof( iHeader ) );
+	outFile.write( (const char*)&m_iMeshHash, sizeof( m_iMeshHash ) );
+	outFile.write( (const char*)&m_vOrigin[ 0 ], 3 * sizeof( float ) );
+	outFile.write( (const char*)&m_fCellSize, sizeof( float ) );
+	outFile.write( (const char*)m_iBricksPerAxis, sizeof( m_iBricksPerAxis ) );
+	outFile.write( (const char*)iSizes, sizeof( iSizes ) );
+	outFile.write( (const char*)m_iBricks.data(), m_iBricks.size() * sizeof( int ) );
+	outFile.write( (const char*)m_fSamples.data(), m_fSamples.size() * sizeof( float ) );
+
+	return outFile.good();
+}
+
+// Reads a grid written by save().  Fails, leaving the field empty, if the file is missing, damaged or was built
+//	with another resolution or mesh: the triangle count and the hash of the vertices and indices have to match.
+bool MeshSDF::load( const string& sFileName, unsigned int iResolution, const vector< vec3 >& vVertices,
+					const vector< unsigned int >& iIndices )
+{
+	ifstream inFile( sFileName, ios::binary );
+	unsigned int iNumTriangles = iIndices.size() / 3;
+	unsigned long long iMeshHash = hashMesh( vVertices, iIndices ), iFileHash = 0;
+	unsigned int iHeader[ 4 ], iSizes[ 2 ];
+	bool bReturnValue;
+
+	m_iBricks.clear();
+	m_fSamples.clear();
+
+	if ( !inFile.good() )
+		return false;
+
+	inFile.read( (char*)iHeader, sizeof( iHeader ) );
+	inFile.read( (char*)&iFileHash, sizeof( iFileHash ) );
+	inFile.read( (char*)&m_vOrigin[ 0 ], 3 * sizeof( float ) );
+	inFile.read( (char*)&m_fCellSize, sizeof( float ) );
+	inFile.read( (char*)m_iBricksPerAxis, sizeof( m_iBricksPerAxis ) );
+	inFile.read( (char*)iSizes, sizeof( iSizes ) );
+
+	bReturnValue = inFile.good() && MESH_SDF_MAGIC == iHeader[ 0 ] && MESH_SDF_VERSION == iHeader[ 1 ]
+				   && iResolution == iHeader[ 2 ] && iNumTriangles == iHeader[ 3 ] && iMeshHash == iFileHash
+				   && m_iBricksPerAxis[ 0 ] > 0 && m_iBricksPerAxis[ 1 ] > 0 && m_iBricksPerAxis[ 2 ] > 0
+				   && (unsigned long long)m_iBricksPerAxis[ 0 ] * m_iBricksPerAxis[ 1 ] * m_iBricksPerAxis[ 2 ] == iSizes[ 0 ]
+				   && 0 == iSizes[ 1 ] % MESH_SDF_BRICK_SAMPLES;
+
+	if ( bReturnValue )
+	{
+		m_iBricks.resize( iSizes[ 0 ] );
+		m_fSamples.resize( iSizes[ 1 ] );
+		inFile.read( (char*)m_iBricks.data(), m_iBricks.size() * sizeof( int ) );
+		inFile.read( (char*)m_fSamples.data(), m_fSamples.size() * sizeof( float ) );
+		bReturnValue = inFile.good();
+
+		for ( unsigned int b = 0; bReturnValue && b < m_iBricks.size(); ++b )
+			bReturnValue = MESH_SDF_NO_BRICK == m_iBricks[ b ] || (m_iBricks[ b ] >= 0 && (unsigned int)m_iBricks[ b ] < iSizes[ 1 ] / MESH_SDF_BRICK_SAMPLES);
+	}
+
+	if ( bReturnValue )
+	{
+		m_iResolution = iResolution;
+		m_iNumTriangles = iNumTriangles;
+		m_iMeshHash = iMeshHash;
+	}
+	else
+	{
+		m_iBricks.clear();
+		m_fSamples.clear();
+	}
+
+	return bReturnValue;
+}
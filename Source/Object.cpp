@@ -14,6 +14,8 @@ Object::Object( const vec3* pPos, long lID, const string* sTexName, const Anim_T
 	if ( nullptr != pAnimTrack )
 		m_pAnimTrack = new Anim_Track( *pAnimTrack );
 	else m_pAnimTrack = nullptr;
+
+	m_sPublishedFrame.fill( getFreNetFrames() );
 }
 
 // Copy Constructor
@@ -27,6 +29,7 @@ Object::Object( const Object* pCopy )
 	else m_pTexture = nullptr;
 
 	m_pAnimTrack = pCopy->m_pAnimTrack;
+	m_sPublishedFrame.fill( pCopy->getPublishedFrame() );
 }
 
 // Destructor: unload Texture.
@@ -54,6 +57,17 @@ void Object::switchTexture( const string* sTexLoc )
 	}
 }
 
+// Steps the Animation Track, if any, and hands the new frame to the render thread.
+void Object::animate()
+{
+	if ( nullptr != m_pAnimTrack )
+	{
+		m_pAnimTrack->animate();
+		m_sPublishedFrame.getBack() = m_pAnimTrack->getFreNetFrames();
+		m_sPublishedFrame.publish();
+	}
+}
+
 // If there's an Animation Track, return the Frenet frames, otherwise
 //	Return Identity matrix.
 mat4 Object::getFreNetFrames()
@@ -19,6 +19,24 @@ Object3D::Object3D( const Object3D* pCopy ) : Object( pCopy )
 	m_iVertexBuffer = pCopy->m_iVertexBuffer;
 }
 
+// Tests the rays one at a time.
+void Object3D::findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+								unsigned int* pObject, unsigned int iObject )
+{
+	float fT;
+	vec3 vNormal;
+
+	for ( unsigned int i = 0; i < iCount; ++i )
+	{
+		if ( isCollision( pStart[ i ], pRay[ i ], fT, vNormal ) && fT >= 0.0f && fT < pT[ i ] )
+		{
+			pT[ i ] = fT;
+			pNormal[ i ] = vNormal;
+			pObject[ i ] = iObject;
+		}
+	}
+}
+
 Object3D::~Object3D()
 {
 	glDeleteBuffers( 1, &m_iVertexBuffer );
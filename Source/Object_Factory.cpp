@@ -31,6 +31,7 @@ Object_Factory::Object_Factory()
 
 	m_pAnimProperty = nullptr;
 	m_sMeshProperty = m_sTextureProperty = "";
+	m_iSDFProperty = 0;
 }
 
 // Returns the singleton instance of the Object Factory
@@ -162,7 +163,8 @@ Object3D* Object_Factory::createMesh( vector< string > sData, int iLength )
 									  &m_sMeshProperty,
 									  getNewID(),
 									  &m_sTextureProperty,
-									  m_pAnimProperty );
+									  m_pAnimProperty,
+									  m_iSDFProperty );
 	}
 
 	return pReturnMesh;
@@ -312,7 +314,7 @@ void Object_Factory::handleData( vector< string >& sData, const string& sIndicat
 	else if ("mesh_obj" == sIndicator)	// Parse Mesh
 		pResultingObject = createMesh(sData, sData.size());
 	else if ("mass_spring" == sIndicator)	// Parse Mass Spring System
-		EnvironmentManager::getInstance()->initializeMassSpringSystem(sData, sData.size());
+		EnvironmentManager::getInstance()->addMassSpringSystem(sData, sData.size());
 
 	clearProperties();
 
@@ -334,6 +336,8 @@ void Object_Factory::handleProperty( vector< string >& sData, const string& sInd
 		m_sTextureProperty = sDataTrimmed;
 	else if ( "mesh" == sIndicator )
 		m_sMeshProperty = sDataTrimmed;
+	else if ( "sdf" == sIndicator )
+		m_iSDFProperty = stoi( sDataTrimmed );
 }
 
 // Removes any tabs from the beginning or end of a given string.
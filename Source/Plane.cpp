@@ -1,37 +1,18 @@
 #include "Plane.h"
 
-#define NUM_CORNERS 4
-#define PI					3.14159265f
-
 // Constructor
 Plane::Plane( const vec3* pPosition,
 			  const vector<glm::vec3>* pCorners,
 			  long lID,
 			  const string* sTexName,
-			  bool bUseEB, const Anim_Track* pAnimTrack ) : Object3D( pPosition, lID, sTexName, pAnimTrack )
+			  bool bUseEB, const Anim_Track* pAnimTrack ) : Object3D( pPosition, lID, sTexName, pAnimTrack ),
+															m_sCollider( *pPosition, *pCorners )
 {
-	if ( NUM_CORNERS != pCorners->size() )	// Set up a default Plane
-	{
-		m_pVertices.push_back( glm::vec3( -1.f, 0.f, -1.f ) );
-		m_pVertices.push_back( glm::vec3( -1.f, 0.f, 1.f ) );
-		m_pVertices.push_back( glm::vec3( 1.f, 0.f, -1.f ) );
-		m_pVertices.push_back( glm::vec3( 1.f, 0.f, 1.f ) );
-	}
-	else
-		m_pVertices.insert( m_pVertices.begin(), pCorners->begin(), pCorners->end() );
-
-	vec3 vTranslateVector = m_pPosition - vec3(0.0);
-	mat4 mTranslationMatrix = translate(mat4(1.0), vTranslateVector);
-	m_fD = length(vTranslateVector);
-
-	// Translate Plane to Specified Position in 3D space.
-	for (vector< vec3 >::iterator iter = m_pVertices.begin();
-		iter != m_pVertices.end();
-		++iter)
-		(*iter) = vec3( mTranslationMatrix * vec4((*iter), 1.0) );
+	// Geometry comes from the collider (default quad, translated to the Plane's position)
+	m_pVertices = m_sCollider.getCorners();
 
 	// Set up Normal and Vertex Normals
-	m_pNormal = normalize( cross( m_pVertices[ 1 ] - m_pVertices[ 0 ], m_pVertices[ 2 ] - m_pVertices[ 0 ] ) );
+	m_pNormal = m_sCollider.getNormal();
 	m_pNormals.resize( m_pVertices.size(), m_pNormal );
 
 	m_fScale = 1.f;
@@ -80,67 +61,7 @@ string Plane::getDebugOutput()
 // Checks collision of ray from start point against this plane.
 bool Plane::isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal)
 {
-	// Local Variables
-	vec3 vDest = vStart + vRay;
-	vec3 vRayNormalized, vIntersection;
-	fT = dot(vDest, m_pNormal) - m_fD;
-	bool bReturn = false;
-
-	// Lies on or behind the plane but started before intersecting.
-	if ( fT <= 0.0f && (dot(vStart, m_pNormal) - m_fD) >= 0.0f )
-	{
-		// Calculate whether the ray crosses through the plane
-		vRayNormalized = normalize(vRay);
-		fT = -(dot(m_pNormal, vStart) - m_fD) / dot(m_pNormal, vRayNormalized);
-		vIntersection = vStart + (vRayNormalized * fT);
-		vec3 v1, v2, v3, v4;
-
-		v1 = normalize(vIntersection - m_pVertices[0]);
-		v2 = normalize(vIntersection - m_pVertices[1]);
-		v3 = normalize(vIntersection - m_pVertices[2]);
-
-		float fTheta1;
-
-		// Angles around intersection should total 360 (2Pi)
-		/*
-			glm::vec3( -1.f, 0.f, -1.f )
-			glm::vec3( -1.f, 0.f, 1.f )
-			glm::vec3( 1.f, 0.f, -1.f )
-			glm::vec3( 1.f, 0.f, 1.f ) )
-
-			v2-v4
-			| \ |
-			v1-v3
-		*/
-		fTheta1 = acos(dot(v1, v2))
-				+ acos(dot(v2, v3))
-				+ acos(dot(v3, v1));
-
-		// Check Tri v1,v2,v3
-		// Intersected through first Triangle
-		if (fabs(fTheta1 - (2 * PI) < 0.1))
-			bReturn = true;
-		else
-		{
-			v4 = normalize(vIntersection - m_pVertices[3]);
-
-			// Check Tri v2,v4,v3
-			fTheta1 = acos(dot(v2, v4))
-					+ acos(dot(v4, v3))
-					+ acos(dot(v3, v2));
-
-			// Intersected through other triangle instead.
-			if (fabs(fTheta1 - (2 * PI) < 0.1))
-				bReturn = true;
-		}
-	}
-
-	// Return the Normal
-	if (bReturn)
-		vIntersectingNormal = m_pNormal;
-
-	// Return true if possible intersection
-	return bReturn;
+	return m_sCollider.isCollision( vStart, vRay, fT, vIntersectingNormal );
 }
 
 // Setup OpenGl to draw the Plane using the Plane Shader.
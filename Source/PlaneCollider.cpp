@@ -0,0 +1,158 @@
+#include "PlaneCollider.h"
+
+#define NUM_CORNERS 4
+#define COLLISION_BATCH 64		// Rays classified against the plane at a time
+#define CROSSING_SLACK 1e-4f	// The classification only rejects rays clearly on one side, isCollision decides the rest
+#define EDGE_SLACK 1e-4f		// Hits this close outside an edge still count, so rays through a shared edge aren't missed
+
+// Constructor: Translates the corners to the plane's position and finds its normal.
+PlaneCollider::PlaneCollider( const vec3& vPosition, const vector< vec3 >& vCorners )
+{
+	if ( NUM_CORNERS != vCorners.size() )	// Set up a default Plane
+	{
+		m_vCorners.push_back( glm::vec3( -1.f, 0.f, -1.f ) );
+		m_vCorners.push_back( glm::vec3( -1.f, 0.f, 1.f ) );
+		m_vCorners.push_back( glm::vec3( 1.f, 0.f, -1.f ) );
+		m_vCorners.push_back( glm::vec3( 1.f, 0.f, 1.f ) );
+	}
+	else
+		m_vCorners.insert( m_vCorners.begin(), vCorners.begin(), vCorners.end() );
+
+	vec3 vTranslateVector = vPosition - vec3(0.0);
+	mat4 mTranslationMatrix = translate(mat4(1.0), vTranslateVector);
+
+	// Translate Plane to Specified Position in 3D space.
+	for (vector< vec3 >::iterator iter = m_vCorners.begin();
+		iter != m_vCorners.end();
+		++iter)
+		(*iter) = vec3( mTranslationMatrix * vec4((*iter), 1.0) );
+
+	m_vNormal = normalize( cross( m_vCorners[ 1 ] - m_vCorners[ 0 ], m_vCorners[ 2 ] - m_vCorners[ 0 ] ) );
+
+	// Distance of the plane through the corners from the origin, so collisions happen where the Plane is drawn
+	m_fD = dot( m_vNormal, m_vCorners[ 0 ] );
+
+	/*
+		Triangles of the quad:
+
+		v2-v4
+		| \ |
+		v1-v3
+	*/
+	const unsigned int iTriangles[ 2 ][ 3 ] = { { 0, 1, 2 }, { 1, 3, 2 } };
+	for ( unsigned int t = 0; t < 2; ++t )
+		for ( unsigned int e = 0; e < 3; ++e )
+			setEdge( 3 * t + e, m_vCorners[ iTriangles[ t ][ e ] ], m_vCorners[ iTriangles[ t ][ (e + 1) % 3 ] ],
+					 m_vCorners[ iTriangles[ t ][ (e + 2) % 3 ] ] );
+}
+
+// Edge from vFrom to vTo of a triangle: in-plane unit normal of the edge facing vOpposite and its offset.
+void PlaneCollider::setEdge( unsigned int iEdge, const vec3& vFrom, const vec3& vTo, const vec3& vOpposite )
+{
+	vec3 vEdgeNormal = cross( m_vNormal, vTo - vFrom );
+	float fLength = length( vEdgeNormal );
+
+	// A degenerate edge doesn't limit anything, the other two edges decide.
+	m_vEdgeNormal[ iEdge ] = (fLength > 0.0f) ? vEdgeNormal / fLength : vec3( 0.0f );
+	m_fEdgeOffset[ iEdge ] = dot( m_vEdgeNormal[ iEdge ], vFrom );
+
+	if ( dot( m_vEdgeNormal[ iEdge ], vOpposite ) < m_fEdgeOffset[ iEdge ] )
+	{
+		m_vEdgeNormal[ iEdge ] = -m_vEdgeNormal[ iEdge ];
+		m_fEdgeOffset[ iEdge ] = -m_fEdgeOffset[ iEdge ];
+	}
+}
+
+// A point on the plane is inside the quad if it's on the inner side of all 3 edges of either triangle.
+bool PlaneCollider::isInside( const vec3& vPoint ) const
+{
+	bool bReturn = false;
+
+	for ( unsigned int t = 0; t < 6 && !bReturn; t += 3 )
+		bReturn = dot( vPoint, m_vEdgeNormal[ t ] ) >= m_fEdgeOffset[ t ] - EDGE_SLACK
+			   && dot( vPoint, m_vEdgeNormal[ t + 1 ] ) >= m_fEdgeOffset[ t + 1 ] - EDGE_SLACK
+			   && dot( vPoint, m_vEdgeNormal[ t + 2 ] ) >= m_fEdgeOffset[ t + 2 ] - EDGE_SLACK;
+
+	return bReturn;
+}
+
+// Bounding box of the corners, the broadphase pads it for flat planes.
+void PlaneCollider::getBounds( vec3& vMin, vec3& vMax ) const
+{
+	vMin = vMax = m_vCorners[ 0 ];
+	for ( unsigned int i = 1; i < m_vCorners.size(); ++i )
+	{
+		vMin = min( vMin, m_vCorners[ i ] );
+		vMax = max( vMax, m_vCorners[ i ] );
+	}
+}
+
+// Only rays that start on or in front of the plane and end on or behind it can hit; that test is a pair of
+//	dot products per ray and runs vectorized over COLLISION_BATCH rays at a time.  The few rays that cross
+//	the plane then go through the full isCollision test.
+void PlaneCollider::findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+									unsigned int* pObject, unsigned int iObject ) const
+{
+	unsigned char bCrossing[ COLLISION_BATCH ];
+	float fT;
+	vec3 vNormal;
+
+	for ( unsigned int iFirst = 0; iFirst < iCount; iFirst += COLLISION_BATCH )
+	{
+		unsigned int iBatch = std::min( iCount - iFirst, (unsigned int)COLLISION_BATCH );
+		const vec3* pBatchStart = pStart + iFirst;
+		const vec3* pBatchRay = pRay + iFirst;
+
+#if _OPENMP >= 201307
+		#pragma omp simd
+#endif
+		for ( unsigned int i = 0; i < iBatch; ++i )
+		{
+			float fStart = pBatchStart[ i ].x * m_vNormal.x + pBatchStart[ i ].y * m_vNormal.y + pBatchStart[ i ].z * m_vNormal.z - m_fD;
+			float fRay = pBatchRay[ i ].x * m_vNormal.x + pBatchRay[ i ].y * m_vNormal.y + pBatchRay[ i ].z * m_vNormal.z;
+
+			bCrossing[ i ] = (fStart >= -CROSSING_SLACK) & (fStart + fRay <= CROSSING_SLACK);
+		}
+
+		for ( unsigned int i = 0; i < iBatch; ++i )
+		{
+			unsigned int iRay = iFirst + i;
+
+			if ( bCrossing[ i ] && isCollision( pStart[ iRay ], pRay[ iRay ], fT, vNormal ) && fT >= 0.0f && fT < pT[ iRay ] )
+			{
+				pT[ iRay ] = fT;
+				pNormal[ iRay ] = vNormal;
+				pObject[ iRay ] = iObject;
+			}
+		}
+	}
+}
+
+// Checks collision of ray from start point against this plane.
+bool PlaneCollider::isCollision(const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal) const
+{
+	// Local Variables
+	vec3 vDest = vStart + vRay;
+	vec3 vRayNormalized, vIntersection;
+	fT = dot(vDest, m_vNormal) - m_fD;
+	bool bReturn = false;
+
+	// Lies on or behind the plane but started before intersecting.
+	if ( fT <= 0.0f && (dot(vStart, m_vNormal) - m_fD) >= 0.0f )
+	{
+		// Calculate whether the ray crosses through the plane
+		vRayNormalized = normalize(vRay);
+		fT = -(dot(m_vNormal, vStart) - m_fD) / dot(m_vNormal, vRayNormalized);
+		vIntersection = vStart + (vRayNormalized * fT);
+
+		// Intersected through either triangle of the quad?
+		bReturn = isInside( vIntersection );
+	}
+
+	// Return the Normal
+	if (bReturn)
+		vIntersectingNormal = m_vNormal;
+
+	// Return true if possible intersection
+	return bReturn;
+}
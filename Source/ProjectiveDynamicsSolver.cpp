@@ -0,0 +1,431 @@
+#include "ProjectiveDynamicsSolver.h"
+#include "MassSpringSystem.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_PD_ITERATIONS 10
+#define DISSECTION_LEAF_SIZE 64		// Groups of masses small enough to keep in their current order
+#define CONTACT_CG_ITERATIONS 20		// Max conjugate gradient iterations of a global step with contacts
+#define CONTACT_CG_TOLERANCE 1e-4		// Relative to the residual of the contact free solution
+#define REDUCTION_BLOCK 1024			// Values per partial sum of a deterministic dot product
+
+// Default Constructor
+ProjectiveDynamicsSolver::ProjectiveDynamicsSolver( MassSpringSystem* pSystem )
+{
+	m_pSystem = pSystem;
+	m_iIterations = DEFAULT_PD_ITERATIONS;
+	m_fFactoredDeltaT = m_fFactoredK = 0.0f;
+	m_iNumContacts = 0;
+}
+
+// Destructor
+ProjectiveDynamicsSolver::~ProjectiveDynamicsSolver()
+{
+	m_pSystem = nullptr;
+}
+
+// Sizes the buffers, orders the free masses for a sparse factor and factors the system for delta_t.
+void ProjectiveDynamicsSolver::initialize()
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+
+	m_vPrevPosition.assign( sMasses.m_vPosition.begin(), sMasses.m_vPosition.end() );
+	m_vInertial.assign( sMasses.m_vPosition.begin(), sMasses.m_vPosition.end() );
+	m_vProjection.assign( m_pSystem->m_sSprings.size(), vec3( 0.0f ) );
+
+	orderRows();
+	m_vContact.assign( m_vRowMass.size(), 0 );
+	m_vSolution.assign( m_vRowMass.size() * 3, 0.0 );
+	m_vResidual.assign( m_vRowMass.size() * 3, 0.0 );
+	m_vDirection.assign( m_vRowMass.size() * 3, 0.0 );
+	m_vPrecResidual.assign( m_vRowMass.size() * 3, 0.0 );
+	m_vProduct.assign( m_vRowMass.size() * 3, 0.0 );
+	m_vBlockSums.assign( (m_vRowMass.size() * 3 + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK, 0.0 );
+	factor( m_pSystem->m_fDeltaT );
+}
+
+// One Projective Dynamics step:
+//	1. Predict the inertial positions from the velocities and external forces, detect and project contacts.
+//	2. m_iIterations times: project every spring (local), solve the positions (global), project the contacts.
+//	3. Catch masses the springs pushed through a plane, then velocities from the change in position.
+void ProjectiveDynamicsSolver::step( float fDeltaT )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	int iNumThreads = m_pSystem->m_iNumThreads;
+	int iNumRows = (int)m_vRowMass.size();
+
+	// The factor only depends on h and k; anything else leaves it valid
+	if ( (fDeltaT != m_fFactoredDeltaT || m_pSystem->m_fK != m_fFactoredK) && !factor( fDeltaT ) )
+		return;
+
+	predict( fDeltaT, iNumThreads );
+	projectContacts( iNumThreads );
+
+	for ( unsigned int i = 0; i < m_iIterations; ++i )
+	{
+		projectSprings( iNumThreads );
+		solveGlobal( fDeltaT, iNumThreads );
+		projectContacts( iNumThreads );
+	}
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int r = 0; r < iNumRows; ++r )
+	{
+		unsigned int m = m_vRowMass[ r ];
+
+		if ( m_pSystem->findContact( m, m_vPrevPosition[ m ] ) )
+			m_pSystem->projectContact( m, m_vPrevPosition[ m ] );
+
+		sMasses.m_vVelocity[ m ] = (sMasses.m_vPosition[ m ] - m_vPrevPosition[ m ]) / fDeltaT;
+	}
+}
+
+/*********************************************************************************\
+* System Matrix                                                                  *
+\*********************************************************************************/
+
+// Gives every free mass a row.  The rows are ordered by geometric nested dissection of the masses'
+//	positions, so a cube of n masses factors with O(n^(4/3)) nonzeros instead of the O(n^(5/3)) of a banded order.
+void ProjectiveDynamicsSolver::orderRows()
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	unsigned int iNumMasses = sMasses.size();
+	vector< unsigned char > vLeft( iNumMasses, 0 );
+
+	m_vRowMass.clear();
+	for ( unsigned int m = 0; m < iNumMasses; ++m )
+		if ( !sMasses.isFixed( m ) )
+			m_vRowMass.push_back( m );
+
+	dissect( m_vRowMass, 0, m_vRowMass.size(), vLeft );
+
+	m_vRow.assign( iNumMasses, -1 );
+	for ( unsigned int r = 0; r < m_vRowMass.size(); ++r )
+		m_vRow[ m_vRowMass[ r ] ] = (int)r;
+}
+
+// Reorders vMasses[ iBegin, iEnd ) so eliminating them in order creates little fill: the group is cut in
+//	half across its longest axis, the masses of the far half with springs into the near half form the
+//	separator, which goes last so neither half fills in against the other.  Both halves are then dissected
+//	the same way.  vLeft is scratch space (all 0) with an entry per mass.
+void ProjectiveDynamicsSolver::dissect( vector< unsigned int >& vMasses, unsigned int iBegin, unsigned int iEnd,
+										vector< unsigned char >& vLeft ) const
+{
+	const vec3* pPosition = m_pSystem->m_sMasses.m_vPosition.data();
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	vector< unsigned int >::iterator pBegin = vMasses.begin() + iBegin, pEnd = vMasses.begin() + iEnd;
+	vec3 vMin( FLT_MAX ), vMax( -FLT_MAX ), vExtent;
+	unsigned int iLeftEnd, iSeparator;
+	int iAxis;
+	float fSplit;
+
+	if ( iEnd - iBegin <= DISSECTION_LEAF_SIZE )
+		return;
+
+	for ( unsigned int i = iBegin; i < iEnd; ++i )
+	{
+		vMin = min( vMin, pPosition[ vMasses[ i ] ] );
+		vMax = max( vMax, pPosition[ vMasses[ i ] ] );
+	}
+
+	vExtent = vMax - vMin;
+	iAxis = (vExtent.x >= vExtent.y && vExtent.x >= vExtent.z) ? 0 : ((vExtent.y >= vExtent.z) ? 1 : 2);
+
+	// Median along the axis; masses on the median plane go right unless nothing would be left
+	nth_element( pBegin, pBegin + (iEnd - iBegin) / 2, pEnd,
+				 [ pPosition, iAxis ]( unsigned int a, unsigned int b ) { return pPosition[ a ][ iAxis ] < pPosition[ b ][ iAxis ]; } );
+	fSplit = pPosition[ vMasses[ iBegin + (iEnd - iBegin) / 2 ] ][ iAxis ];
+
+	iLeftEnd = partition( pBegin, pEnd, [ pPosition, iAxis, fSplit ]( unsigned int m ) { return pPosition[ m ][ iAxis ] < fSplit; } ) - vMasses.begin();
+	if ( iLeftEnd == iBegin )
+		iLeftEnd = partition( pBegin, pEnd, [ pPosition, iAxis, fSplit ]( unsigned int m ) { return pPosition[ m ][ iAxis ] <= fSplit; } ) - vMasses.begin();
+	if ( iLeftEnd == iBegin || iLeftEnd == iEnd )
+		return;
+
+	for ( unsigned int i = iBegin; i < iLeftEnd; ++i )
+		vLeft[ vMasses[ i ] ] = 1;
+
+	iSeparator = partition( vMasses.begin() + iLeftEnd, pEnd,
+		[ &sAdjacency, &vLeft ]( unsigned int m )
+		{
+			for ( unsigned int a = sAdjacency.m_vOffsets[ m ]; a < sAdjacency.m_vOffsets[ m + 1 ]; ++a )
+				if ( vLeft[ sAdjacency.m_vMass[ a ] ] )
+					return false;
+			return true;
+		} ) - vMasses.begin();
+
+	for ( unsigned int i = iBegin; i < iLeftEnd; ++i )
+		vLeft[ vMasses[ i ] ] = 0;
+
+	dissect( vMasses, iBegin, iLeftEnd, vLeft );
+	dissect( vMasses, iLeftEnd, iSeparator, vLeft );
+}
+
+// Assembles the upper triangle of A = M / h^2 + k * L (L: graph Laplacian of the springs, springs to fixed
+//	masses only add to the diagonal) in the row order and factors it.  A is the same for x, y and z.
+bool ProjectiveDynamicsSolver::factor( float fDeltaT )
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	unsigned int iNumRows = m_vRowMass.size();
+	double fK = (double)m_pSystem->m_fK;
+	double fInvDeltaT2 = 1.0 / ((double)fDeltaT * (double)fDeltaT);
+	vector< unsigned int > vColumnOffsets( 1, 0 ), vRows;
+	vector< double > vValues;
+	bool bReturnValue;
+
+	vRows.reserve( sAdjacency.m_vMass.size() / 2 + iNumRows );
+	vValues.reserve( sAdjacency.m_vMass.size() / 2 + iNumRows );
+
+	for ( unsigned int c = 0; c < iNumRows; ++c )
+	{
+		unsigned int m = m_vRowMass[ c ];
+
+		for ( unsigned int a = sAdjacency.m_vOffsets[ m ]; a < sAdjacency.m_vOffsets[ m + 1 ]; ++a )
+		{
+			int iRow = m_vRow[ sAdjacency.m_vMass[ a ] ];
+
+			if ( iRow >= 0 && iRow < (int)c )
+			{
+				vRows.push_back( (unsigned int)iRow );
+				vValues.push_back( -fK );
+			}
+		}
+
+		vRows.push_back( c );
+		vValues.push_back( fInvDeltaT2 / (double)sMasses.m_fInvMass[ m ] + fK * (double)sAdjacency.getCount( m ) );
+		vColumnOffsets.push_back( vRows.size() );
+	}
+
+	m_fFactoredDeltaT = fDeltaT;
+	m_fFactoredK = m_pSystem->m_fK;
+	if ( !(bReturnValue = m_sFactor.factor( iNumRows, vColumnOffsets, vRows, vValues )) )
+		cout << "Error: Projective dynamics system matrix is not positive definite.\n";
+
+	return bReturnValue;
+}
+
+/*********************************************************************************\
+* Solver Steps                                                                   *
+\*********************************************************************************/
+
+// Applies gravity and spring damping (the same forces as the other integrators, the damping taken
+//	implicitly) to the velocities, moves every free mass to its inertial position y and updates its contact along
+//	the predicted path.
+void ProjectiveDynamicsSolver::predict( float fDeltaT, int iNumThreads )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	int iNumMasses = (int)sMasses.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		vec3& vPosition = sMasses.m_vPosition[ m ];
+		vec3& vVelocity = sMasses.m_vVelocity[ m ];
+
+		m_vPrevPosition[ m ] = vPosition;
+		if ( m_vRow[ m ] >= 0 )
+		{
+			m_pSystem->integrateMassForces( m, fDeltaT );
+			vPosition += vVelocity * fDeltaT;
+
+			m_pSystem->updateContact( m, m_vPrevPosition[ m ] );
+		}
+
+		m_vInertial[ m ] = vPosition;
+	}
+}
+
+// Local step: the closest point of each spring's constraint set |x1 - x2| = rest, d = rest * (x1 - x2) / |x1 - x2|.
+void ProjectiveDynamicsSolver::projectSprings( int iNumThreads )
+{
+	const MassSpringSystem::Springs& sSprings = m_pSystem->m_sSprings;
+	const vec3* pPosition = m_pSystem->m_sMasses.m_vPosition.data();
+	int iNumSprings = (int)sSprings.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int s = 0; s < iNumSprings; ++s )
+	{
+		vec3 vD12 = pPosition[ sSprings.m_iMass1[ s ] ] - pPosition[ sSprings.m_iMass2[ s ] ];
+		float fLength = length( vD12 );
+
+		m_vProjection[ s ] = (fLength > 0.0f) ? vD12 * (sSprings.m_fRestLength[ s ] / fLength) : vec3( 0.0f );
+	}
+}
+
+// Pushes colliding masses back out of their objects and marks the rows that were moved.
+void ProjectiveDynamicsSolver::projectContacts( int iNumThreads )
+{
+	int iNumRows = (int)m_vRowMass.size();
+	int iNumContacts = 0;
+
+	#pragma omp parallel for reduction( +: iNumContacts ) num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int r = 0; r < iNumRows; ++r )
+	{
+		m_vContact[ r ] = m_pSystem->projectContact( m_vRowMass[ r ], m_vPrevPosition[ m_vRowMass[ r ] ] ) ? 1 : 0;
+		iNumContacts += m_vContact[ r ];
+	}
+
+	m_iNumContacts = iNumContacts;
+}
+
+// Global step: gathers b = M / h^2 * y + k * sum( +-d ) (+ k * x of fixed neighbours) for every row in
+//	parallel, solves A x = b for x, y and z with one pass through the factor and writes the positions back.
+//	Rows in contact add kc * (x - contact point) to the system (their current, projected position is the
+//	contact point), which is solved by solveContacts instead.
+void ProjectiveDynamicsSolver::solveGlobal( float fDeltaT, int iNumThreads )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	const MassSpringSystem::Springs& sSprings = m_pSystem->m_sSprings;
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	int iNumRows = (int)m_vRowMass.size();
+	double fK = (double)m_pSystem->m_fK;
+	double fCollisionK = (double)m_pSystem->m_fCollisionK;
+	double fInvDeltaT2 = 1.0 / ((double)fDeltaT * (double)fDeltaT);
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int r = 0; r < iNumRows; ++r )
+	{
+		unsigned int m = m_vRowMass[ r ];
+		double fInertia = fInvDeltaT2 / (double)sMasses.m_fInvMass[ m ];
+		vec3 vSprings( 0.0f );
+		double* pB = &m_vSolution[ r * 3 ];
+
+		for ( unsigned int a = sAdjacency.m_vOffsets[ m ]; a < sAdjacency.m_vOffsets[ m + 1 ]; ++a )
+		{
+			unsigned int s = sAdjacency.m_vSpring[ a ];
+			unsigned int iOther = sAdjacency.m_vMass[ a ];
+
+			vSprings += (sSprings.m_iMass1[ s ] == m) ? m_vProjection[ s ] : -m_vProjection[ s ];
+			if ( m_vRow[ iOther ] < 0 )
+				vSprings += sMasses.m_vPosition[ iOther ];
+		}
+
+		for ( int i = 0; i < 3; ++i )
+			pB[ i ] = fInertia * (double)m_vInertial[ m ][ i ] + fK * (double)vSprings[ i ]
+					  + (m_vContact[ r ] ? fCollisionK * (double)sMasses.m_vPosition[ m ][ i ] : 0.0);
+	}
+
+	if ( 0 == m_iNumContacts )
+		m_sFactor.solve( m_vSolution.data(), 3 );
+	else
+		solveContacts( fDeltaT, iNumThreads );
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int r = 0; r < iNumRows; ++r )
+		sMasses.m_vPosition[ m_vRowMass[ r ] ] = vec3( (float)m_vSolution[ r * 3 ], (float)m_vSolution[ r * 3 + 1 ], (float)m_vSolution[ r * 3 + 2 ] );
+}
+
+// Sum of a[i] * b[i], accumulated in parallel.  Deterministic systems sum fixed blocks of REDUCTION_BLOCK
+//	values and add the block sums in order, rather than in the order the threads finish.
+double ProjectiveDynamicsSolver::dotProduct( const double* pA, const double* pB, int iCount, int iNumThreads )
+{
+	int iNumBlocks = (iCount + REDUCTION_BLOCK - 1) / REDUCTION_BLOCK;
+	double dSum = 0.0;
+
+	if ( m_pSystem->m_bDeterministic )
+	{
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int b = 0; b < iNumBlocks; ++b )
+		{
+			int iEnd = std::min( iCount, (b + 1) * REDUCTION_BLOCK );
+			double dBlockSum = 0.0;
+
+			for ( int i = b * REDUCTION_BLOCK; i < iEnd; ++i )
+				dBlockSum += pA[ i ] * pB[ i ];
+			m_vBlockSums[ b ] = dBlockSum;
+		}
+
+		for ( int b = 0; b < iNumBlocks; ++b )
+			dSum += m_vBlockSums[ b ];
+	}
+	else
+	{
+		#pragma omp parallel for reduction( +: dSum ) num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int i = 0; i < iCount; ++i )
+			dSum += pA[ i ] * pB[ i ];
+	}
+
+	return dSum;
+}
+
+// Solves (A + kc * C) x = b, C: identity on the rows in contact, by conjugate gradient preconditioned with
+//	the factor of A.  The contact free solution x0 = A^-1 b starts it, leaving the residual -kc * C * x0 on
+//	the contact rows only; A^-1 (A + kc * C) is the identity but for a handful of eigenvalues, so it
+//	converges in a few iterations.  b is in m_vSolution and is replaced by x.
+void ProjectiveDynamicsSolver::solveContacts( float fDeltaT, int iNumThreads )
+{
+	int iSize = (int)m_vSolution.size();
+	double fCollisionK = (double)m_pSystem->m_fCollisionK;
+	double dResidual, dThreshold, dRZ, dAlpha, dBeta, dNewRZ;
+
+	m_sFactor.solve( m_vSolution.data(), 3 );
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int i = 0; i < iSize; ++i )
+		m_vResidual[ i ] = m_vPrecResidual[ i ] = m_vContact[ i / 3 ] ? -fCollisionK * m_vSolution[ i ] : 0.0;
+
+	m_sFactor.solve( m_vPrecResidual.data(), 3 );
+	m_vDirection.assign( m_vPrecResidual.begin(), m_vPrecResidual.end() );
+
+	dRZ = dotProduct( m_vResidual.data(), m_vPrecResidual.data(), iSize, iNumThreads );
+	dResidual = dotProduct( m_vResidual.data(), m_vResidual.data(), iSize, iNumThreads );
+	dThreshold = CONTACT_CG_TOLERANCE * CONTACT_CG_TOLERANCE * dResidual;
+
+	for ( int k = 0; k < CONTACT_CG_ITERATIONS && dResidual > dThreshold; ++k )
+	{
+		multiply( m_vDirection.data(), m_vProduct.data(), fDeltaT, iNumThreads );
+		dAlpha = dRZ / dotProduct( m_vDirection.data(), m_vProduct.data(), iSize, iNumThreads );
+
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int i = 0; i < iSize; ++i )
+		{
+			m_vSolution[ i ] += dAlpha * m_vDirection[ i ];
+			m_vResidual[ i ] -= dAlpha * m_vProduct[ i ];
+			m_vPrecResidual[ i ] = m_vResidual[ i ];
+		}
+
+		m_sFactor.solve( m_vPrecResidual.data(), 3 );
+		dResidual = dotProduct( m_vResidual.data(), m_vResidual.data(), iSize, iNumThreads );
+		dNewRZ = dotProduct( m_vResidual.data(), m_vPrecResidual.data(), iSize, iNumThreads );
+		dBeta = dNewRZ / dRZ;
+		dRZ = dNewRZ;
+
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int i = 0; i < iSize; ++i )
+			m_vDirection[ i ] = m_vPrecResidual[ i ] + dBeta * m_vDirection[ i ];
+	}
+}
+
+// pOut = (A + kc * C) * pIn, gathered per row from the springs around its mass.
+void ProjectiveDynamicsSolver::multiply( const double* pIn, double* pOut, float fDeltaT, int iNumThreads ) const
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	int iNumRows = (int)m_vRowMass.size();
+	double fK = (double)m_pSystem->m_fK;
+	double fCollisionK = (double)m_pSystem->m_fCollisionK;
+	double fInvDeltaT2 = 1.0 / ((double)fDeltaT * (double)fDeltaT);
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int r = 0; r < iNumRows; ++r )
+	{
+		unsigned int m = m_vRowMass[ r ];
+		double fDiagonal = fInvDeltaT2 / (double)sMasses.m_fInvMass[ m ] + fK * (double)sAdjacency.getCount( m )
+						   + (m_vContact[ r ] ? fCollisionK : 0.0);
+		double* pOutR = pOut + r * 3;
+
+		for ( int i = 0; i < 3; ++i )
+			pOutR[ i ] = fDiagonal * pIn[ r * 3 + i ];
+
+		for ( unsigned int a = sAdjacency.m_vOffsets[ m ]; a < sAdjacency.m_vOffsets[ m + 1 ]; ++a )
+		{
+			int iOther = m_vRow[ sAdjacency.m_vMass[ a ] ];
+
+			if ( iOther >= 0 )
+				for ( int i = 0; i < 3; ++i )
+					pOutR[ i ] -= fK * pIn[ iOther * 3 + i ];
+		}
+	}
+}
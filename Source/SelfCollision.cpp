@@ -0,0 +1,223 @@
+#include "SelfCollision.h"
+#include "MassSpringSystem.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_DISTANCE_FRACTION 0.5f	// Default collision distance, fraction of the shortest spring
+#define TABLE_LOAD 2						// Buckets per mass, most of a bucket's masses are from other cells at 1
+#define MIN_TABLE_SIZE 1024
+#define MAX_TABLE_SIZE (1u << 22)		// 16 MB of bucket offsets, plenty for a few million masses
+#define SCAN_BLOCKS 256					// Blocks of buckets, each sorted by one thread
+#define SCATTER_CHUNKS 256				// Chunks of masses scattered to the blocks, each by one thread
+
+// Default Constructor
+SelfCollision::SelfCollision( MassSpringSystem* pSystem )
+{
+	m_pSystem = pSystem;
+	m_fDistance = 0.0f;
+	m_fCellSize = 0.0f;
+	m_iTableMask = 0;
+}
+
+// Destructor
+SelfCollision::~SelfCollision()
+{
+	m_pSystem = nullptr;
+}
+
+// TABLE_LOAD buckets per mass (rounded up to a power of 2) keep the buckets short without tying the memory to
+//	the space the system covers.  Cells are as wide as the collision distance so every pair in range is in
+//	neighbouring cells.
+void SelfCollision::initialize()
+{
+	unsigned int iNumMasses = m_pSystem->m_sMasses.size();
+	unsigned int iTableSize = MIN_TABLE_SIZE;
+
+	while ( iTableSize < TABLE_LOAD * iNumMasses && iTableSize < MAX_TABLE_SIZE )
+		iTableSize <<= 1;
+
+	m_iTableMask = iTableSize - 1;
+	m_fCellSize = (m_fDistance > 0.0f) ? m_fDistance : DEFAULT_DISTANCE_FRACTION * m_pSystem->m_fMinRestLength;
+
+	m_iMassBucket.resize( iNumMasses );
+	m_iMassCell.resize( iNumMasses );
+	m_iSortedCell.resize( iNumMasses );
+	m_iSorted.resize( iNumMasses );
+	m_iCellStart.resize( iTableSize + 1 );
+	m_iCellFill.resize( iTableSize );
+	m_iBlockMasses.resize( iNumMasses );
+	m_iChunkOffset.resize( SCAN_BLOCKS * SCATTER_CHUNKS );
+	m_iBlockStart.resize( SCAN_BLOCKS + 1 );
+}
+
+// Cell containing vPosition
+ivec3 SelfCollision::getCell( const vec3& vPosition ) const
+{
+	return ivec3( floor( vPosition / m_fCellSize ) );
+}
+
+// Counting sort of the masses by bucket, in two stable passes so every bucket ends up in mass order and the
+//	forces are summed in the same order whatever the thread count, without atomics:
+//	1. Bucket of every mass, and how many masses of each chunk go to each block of buckets.
+//	2. Prefix sum of those counts, block by block, so the chunks of a block follow each other in mass order.
+//	3. Each chunk scatters its masses, in order, to their block.
+//	4. Each block counts its buckets, takes their offsets and scatters its masses, still in order, to them.
+//	5. Each free, awake mass gathers the force from the masses in the 27 cells around it, only writing its own
+//	   force.  Sleeping masses are still binned so awake masses collide with (and wake) them.
+void SelfCollision::accumulateForces()
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	vec3* pForce = m_pSystem->m_sMasses.m_vForce.data();
+	int iNumMasses = (int)sMasses.size();
+	int iTableSize = (int)m_iTableMask + 1;
+	int iBlockSize = (iTableSize + SCAN_BLOCKS - 1) / SCAN_BLOCKS;
+	int iChunkSize = (iNumMasses + SCATTER_CHUNKS - 1) / SCATTER_CHUNKS;
+
+	#pragma omp for
+	for ( int k = 0; k < SCATTER_CHUNKS; ++k )
+	{
+		for ( int j = 0; j < SCAN_BLOCKS; ++j )
+			m_iChunkOffset[ j * SCATTER_CHUNKS + k ] = 0;
+
+		for ( int m = k * iChunkSize; m < (k + 1) * iChunkSize && m < iNumMasses; ++m )
+		{
+			ivec3 iCell = getCell( sMasses.m_vPosition[ m ] );
+			unsigned int iBucket = hashCell( iCell.x, iCell.y, iCell.z );
+
+			m_iMassBucket[ m ] = iBucket;
+			m_iMassCell[ m ] = packCell( iCell.x, iCell.y, iCell.z );
+			++m_iChunkOffset[ (iBucket / iBlockSize) * SCATTER_CHUNKS + k ];
+		}
+	}
+
+	// Counts are replaced by where each chunk's masses of the block start
+	#pragma omp single
+	{
+		unsigned int iOffset = 0;
+
+		for ( int j = 0; j < SCAN_BLOCKS; ++j )
+		{
+			m_iBlockStart[ j ] = iOffset;
+			for ( int k = 0; k < SCATTER_CHUNKS; ++k )
+			{
+				unsigned int iCount = m_iChunkOffset[ j * SCATTER_CHUNKS + k ];
+
+				m_iChunkOffset[ j * SCATTER_CHUNKS + k ] = iOffset;
+				iOffset += iCount;
+			}
+		}
+		m_iBlockStart[ SCAN_BLOCKS ] = iOffset;
+		m_iCellStart[ 0 ] = 0;
+	}
+
+	#pragma omp for
+	for ( int k = 0; k < SCATTER_CHUNKS; ++k )
+	{
+		for ( int m = k * iChunkSize; m < (k + 1) * iChunkSize && m < iNumMasses; ++m )
+			m_iBlockMasses[ m_iChunkOffset[ (m_iMassBucket[ m ] / iBlockSize) * SCATTER_CHUNKS + k ]++ ] = m;
+	}
+
+	// The end of bucket b is stored at b + 1
+	#pragma omp for
+	for ( int j = 0; j < SCAN_BLOCKS; ++j )
+	{
+		unsigned int iOffset = m_iBlockStart[ j ];
+
+		for ( int b = j * iBlockSize; b < (j + 1) * iBlockSize && b < iTableSize; ++b )
+			m_iCellFill[ b ] = 0;
+		for ( unsigned int i = m_iBlockStart[ j ]; i < m_iBlockStart[ j + 1 ]; ++i )
+			++m_iCellFill[ m_iMassBucket[ m_iBlockMasses[ i ] ] ];
+
+		for ( int b = j * iBlockSize; b < (j + 1) * iBlockSize && b < iTableSize; ++b )
+		{
+			unsigned int iCount = m_iCellFill[ b ];
+
+			m_iCellFill[ b ] = iOffset;
+			iOffset += iCount;
+			m_iCellStart[ b + 1 ] = iOffset;
+		}
+
+		for ( unsigned int i = m_iBlockStart[ j ]; i < m_iBlockStart[ j + 1 ]; ++i )
+		{
+			unsigned int iMass = m_iBlockMasses[ i ];
+			unsigned int iSlot = m_iCellFill[ m_iMassBucket[ iMass ] ]++;
+
+			m_iSorted[ iSlot ] = iMass;
+			m_iSortedCell[ iSlot ] = m_iMassCell[ iMass ];
+		}
+	}
+
+	#pragma omp for
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		if ( !sMasses.isFixed( m ) && !sMasses.isSleeping( m ) )
+			pForce[ m ] += getForce( m );
+	}
+}
+
+// Masses connected by a spring are held apart (or together) by it already
+bool SelfCollision::isConnected( unsigned int iMass1, unsigned int iMass2 ) const
+{
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+
+	for ( unsigned int a = sAdjacency.m_vOffsets[ iMass1 ]; a < sAdjacency.m_vOffsets[ iMass1 + 1 ]; ++a )
+		if ( sAdjacency.m_vMass[ a ] == iMass2 )
+			return true;
+
+	return false;
+}
+
+// Penalty force on a mass from every unconnected mass closer than the collision distance: Collision_K times
+//	the overlap along the line between them, less Collision_Damping_Coeff times their approach speed.
+//	Buckets hold masses of every cell hashed to them, only the masses of the cell being visited are tested so
+//	none is counted twice when neighbouring cells share a bucket.  A sleeping mass in range wakes its island
+//	for the next frame and pushes back like a fixed one until then.
+vec3 SelfCollision::getForce( unsigned int iMass ) const
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	MassSpringSystem::Islands& sIslands = m_pSystem->m_sIslands;
+	const vec3* pPosition = m_pSystem->m_sMasses.m_vPosition.data();
+	const vec3* pVelocity = m_pSystem->m_sMasses.m_vVelocity.data();
+	float fCollisionK = m_pSystem->m_fCollisionK;
+	float fCollisionDamp = m_pSystem->m_fCollisionDamp;
+	float fDistance2 = m_fCellSize * m_fCellSize;
+	ivec3 iCell = getCell( pPosition[ iMass ] );
+	vec3 vForce( 0.0f );
+
+	for ( int z = -1; z <= 1; ++z )
+		for ( int y = -1; y <= 1; ++y )
+			for ( int x = -1; x <= 1; ++x )
+			{
+				unsigned int iBucket = hashCell( iCell.x + x, iCell.y + y, iCell.z + z );
+				unsigned long long iKey = packCell( iCell.x + x, iCell.y + y, iCell.z + z );
+
+				for ( unsigned int i = m_iCellStart[ iBucket ]; i < m_iCellStart[ iBucket + 1 ]; ++i )
+				{
+					if ( m_iSortedCell[ i ] != iKey )
+						continue;
+
+					unsigned int iOther = m_iSorted[ i ];
+					if ( iOther == iMass )
+						continue;
+
+					vec3 vDiff = pPosition[ iMass ] - pPosition[ iOther ];
+					float fLength2 = dot( vDiff, vDiff );
+
+					if ( fLength2 >= fDistance2 || fLength2 <= 0.0f || isConnected( iMass, iOther ) )
+						continue;
+
+					// Every writer stores 1, so a plain byte store is enough
+					if ( sMasses.isSleeping( iOther ) )
+						sIslands.m_bWake[ sIslands.m_iMassIsland[ iOther ] ] = 1;
+
+					float fLength = sqrt( fLength2 );
+					vec3 vNormal = vDiff / fLength;
+					float fApproach = dot( pVelocity[ iMass ] - pVelocity[ iOther ], vNormal );
+
+					vForce += vNormal * (fCollisionK * (m_fCellSize - fLength) - fCollisionDamp * fApproach);
+				}
+			}
+
+	return vForce;
+}
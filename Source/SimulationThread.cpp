@@ -0,0 +1,128 @@
+#include "SimulationThread.h"
+#include <chrono>
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_RATE 60.0f		// Frames per second, the rate the systems were stepped at from the render loop
+
+// Default Constructor
+SimulationThread::SimulationThread()
+{
+	m_fRate = DEFAULT_RATE;
+	m_bStop = false;
+	m_bPaused = false;
+	m_iRequestedSteps = 0;
+	m_iFrameCount = 0;
+}
+
+// Destructor: the thread can't outlive what it steps
+SimulationThread::~SimulationThread()
+{
+	stop();
+}
+
+// Starts a new thread stepping pStep; anything pStep touches is shared with the calling thread from here on.
+void SimulationThread::start( const function< void() >& pStep, float fRate )
+{
+	stop();
+
+	m_pStep = pStep;
+	setRate( fRate );
+	m_bStop = false;
+	m_iRequestedSteps = 0;
+	m_iFrameCount = 0;
+	m_pThread = thread( &SimulationThread::run, this );
+}
+
+// Waits for the frame being stepped to finish, then joins the thread.  Requested steps that haven't
+//	started are dropped.
+void SimulationThread::stop()
+{
+	if ( m_pThread.joinable() )
+	{
+		m_bStop = true;
+		wake();
+		m_pThread.join();
+	}
+	m_pStep = nullptr;
+}
+
+void SimulationThread::setRate( float fRate )
+{
+	if ( fRate > 0.0f )
+		m_fRate = fRate;
+}
+
+void SimulationThread::setPaused( bool bPaused )
+{
+	m_bPaused = bPaused;
+	wake();
+}
+
+void SimulationThread::requestStep()
+{
+	++m_iRequestedSteps;
+	wake();
+}
+
+// The state is changed before the lock is taken, so the thread either sees it when checking its wait
+//	condition or is already waiting and gets the notification.
+void SimulationThread::wake()
+{
+	lock_guard< mutex > lWait( m_mWait );
+	m_cvWake.notify_all();
+}
+
+// Steps a frame every 1 / m_fRate seconds, timed from when the previous frame was due so the rate doesn't
+//	drift.  A frame that runs over its period starts the next one right away, but only one: the frames
+//	missed in between are dropped.  Requested steps run as soon as the thread sees them.
+void SimulationThread::run()
+{
+	typedef chrono::steady_clock Clock;
+	Clock::time_point tNextFrame = Clock::now();
+	bool bWasPaused = m_bPaused;
+
+	while ( !m_bStop )
+	{
+		bool bStep = false;
+
+		{
+			unique_lock< mutex > lWait( m_mWait );
+
+			if ( m_bPaused )
+				m_cvWake.wait( lWait, [ this ] { return m_bStop || !m_bPaused || m_iRequestedSteps > 0; } );
+			else
+				m_cvWake.wait_until( lWait, tNextFrame, [ this ] { return m_bStop || m_bPaused || m_iRequestedSteps > 0; } );
+		}
+
+		// Unpausing starts the clock again rather than catching up on the pause
+		if ( bWasPaused && !m_bPaused )
+			tNextFrame = Clock::now();
+		bWasPaused = m_bPaused;
+
+		if ( m_bStop )
+			break;
+
+		if ( m_iRequestedSteps > 0 )
+		{
+			--m_iRequestedSteps;
+			bStep = true;
+		}
+		else if ( !m_bPaused && Clock::now() >= tNextFrame )
+		{
+			Clock::time_point tNow = Clock::now();
+
+			tNextFrame += chrono::duration_cast< Clock::duration >( chrono::duration< float >( 1.0f / m_fRate ) );
+			if ( tNextFrame < tNow )
+				tNextFrame = tNow;
+			bStep = true;
+		}
+
+		if ( bStep )
+		{
+			m_pStep();
+			++m_iFrameCount;
+		}
+	}
+}
@@ -0,0 +1,212 @@
+#include "SparseCholesky.h"
+#include <cmath>
+
+using namespace std;
+
+// Default Constructor
+SparseCholesky::SparseCholesky()
+{
+	m_iSize = 0;
+}
+
+// Destructor
+SparseCholesky::~SparseCholesky()
+{
+	clear();
+}
+
+// Releases the factor
+void SparseCholesky::clear()
+{
+	m_iSize = 0;
+	m_vColumnOffsets.clear();
+	m_vRows.clear();
+	m_vValues.clear();
+}
+
+// Nonzero pattern of row iRow of L: every column reached by walking the elimination tree up from the
+//	nonzeros of column iRow of A (rows < iRow) until a column already visited for this row.
+//	The pattern is left in vStack[ top, size ) in topological order; returns top.
+unsigned int SparseCholesky::reach( unsigned int iRow, const vector< unsigned int >& vColumnOffsets, const vector< unsigned int >& vRows,
+									const vector< int >& vParent, vector< int >& vFlag, vector< unsigned int >& vStack ) const
+{
+	unsigned int iTop = m_iSize;
+
+	vFlag[ iRow ] = (int)iRow;
+	for ( unsigned int p = vColumnOffsets[ iRow ]; p < vColumnOffsets[ iRow + 1 ]; ++p )
+	{
+		unsigned int iLength = 0;
+
+		// Path up the tree; the front of the stack holds it until it's moved below the previous paths
+		for ( unsigned int i = vRows[ p ]; i < iRow && vFlag[ i ] != (int)iRow; i = (unsigned int)vParent[ i ] )
+		{
+			vStack[ iLength++ ] = i;
+			vFlag[ i ] = (int)iRow;
+		}
+
+		while ( iLength > 0 )
+			vStack[ --iTop ] = vStack[ --iLength ];
+	}
+
+	return iTop;
+}
+
+// Symbolic pass: elimination tree and the number of nonzeros in every column of L, which places each
+//	column in one allocation.  Numeric pass: row k of L by a sparse triangular solve against the rows
+//	above it (only the columns in its pattern), then the diagonal from what is left of A(k, k).
+bool SparseCholesky::factor( unsigned int iSize, const vector< unsigned int >& vColumnOffsets,
+							 const vector< unsigned int >& vRows, const vector< double >& vValues )
+{
+	vector< int > vParent( iSize, -1 ), vAncestor( iSize, -1 ), vFlag( iSize, -1 );
+	vector< unsigned int > vStack( iSize ), vNext;
+	vector< double > vRow( iSize, 0.0 );
+
+	clear();
+	m_iSize = iSize;
+
+	// Elimination tree, with path compression through the ancestors
+	for ( unsigned int k = 0; k < iSize; ++k )
+	{
+		for ( unsigned int p = vColumnOffsets[ k ]; p < vColumnOffsets[ k + 1 ]; ++p )
+		{
+			int iNext;
+
+			for ( int i = (int)vRows[ p ]; i != -1 && i < (int)k; i = iNext )
+			{
+				iNext = vAncestor[ i ];
+				vAncestor[ i ] = (int)k;
+				if ( -1 == iNext )
+					vParent[ i ] = (int)k;
+			}
+		}
+	}
+
+	// Column counts of L: every column in the pattern of row k gains an entry, plus each diagonal
+	m_vColumnOffsets.assign( iSize + 1, 0 );
+	for ( unsigned int k = 0; k < iSize; ++k )
+	{
+		for ( unsigned int t = reach( k, vColumnOffsets, vRows, vParent, vFlag, vStack ); t < iSize; ++t )
+			++m_vColumnOffsets[ vStack[ t ] + 1 ];
+		++m_vColumnOffsets[ k + 1 ];
+	}
+
+	for ( unsigned int k = 0; k < iSize; ++k )
+		m_vColumnOffsets[ k + 1 ] += m_vColumnOffsets[ k ];
+
+	m_vRows.resize( m_vColumnOffsets[ iSize ] );
+	m_vValues.resize( m_vColumnOffsets[ iSize ] );
+	vNext.assign( m_vColumnOffsets.begin(), m_vColumnOffsets.end() - 1 );
+	vFlag.assign( iSize, -1 );
+
+	// Numeric factorization, one row at a time
+	for ( unsigned int k = 0; k < iSize; ++k )
+	{
+		unsigned int iTop = reach( k, vColumnOffsets, vRows, vParent, vFlag, vStack );
+		double fDiagonal;
+
+		// Scatter column k of A (the upper triangle is row k of the lower)
+		for ( unsigned int p = vColumnOffsets[ k ]; p < vColumnOffsets[ k + 1 ]; ++p )
+			if ( vRows[ p ] <= k )
+				vRow[ vRows[ p ] ] += vValues[ p ];
+
+		fDiagonal = vRow[ k ];
+		vRow[ k ] = 0.0;
+
+		// Solve L(0:k-1, 0:k-1) * l = A(0:k-1, k) over the pattern of the row
+		for ( ; iTop < iSize; ++iTop )
+		{
+			unsigned int i = vStack[ iTop ];
+			double fLki = vRow[ i ] / m_vValues[ m_vColumnOffsets[ i ] ];
+
+			vRow[ i ] = 0.0;
+			for ( unsigned int p = m_vColumnOffsets[ i ] + 1; p < vNext[ i ]; ++p )
+				vRow[ m_vRows[ p ] ] -= m_vValues[ p ] * fLki;
+
+			fDiagonal -= fLki * fLki;
+			m_vRows[ vNext[ i ] ] = k;
+			m_vValues[ vNext[ i ]++ ] = fLki;
+		}
+
+		if ( fDiagonal <= 0.0 )
+		{
+			clear();
+			return false;
+		}
+
+		m_vRows[ vNext[ k ] ] = k;
+		m_vValues[ vNext[ k ]++ ] = sqrt( fDiagonal );
+	}
+
+	return true;
+}
+
+// Forward substitution with L then back substitution with L^T; every right hand side is carried
+//	through the same pass over L.  RHS is a compile time constant so the inner loops unroll.
+template< unsigned int RHS >
+static void substitute( unsigned int iSize, const unsigned int* pOffsets, const unsigned int* pRows, const double* pValues,
+						double* pX, unsigned int iNumRHS )
+{
+	unsigned int iStride = RHS ? RHS : iNumRHS;
+
+	for ( unsigned int j = 0; j < iSize; ++j )
+	{
+		double* pXj = pX + (size_t)j * iStride;
+		double fInvDiagonal = 1.0 / pValues[ pOffsets[ j ] ];
+
+		for ( unsigned int r = 0; r < iStride; ++r )
+			pXj[ r ] *= fInvDiagonal;
+
+		for ( unsigned int p = pOffsets[ j ] + 1; p < pOffsets[ j + 1 ]; ++p )
+		{
+			double* pXi = pX + (size_t)pRows[ p ] * iStride;
+
+			for ( unsigned int r = 0; r < iStride; ++r )
+				pXi[ r ] -= pValues[ p ] * pXj[ r ];
+		}
+	}
+
+	for ( unsigned int j = iSize; j-- > 0; )
+	{
+		double* pXj = pX + (size_t)j * iStride;
+		double fSum[ RHS ? RHS : 1 ];
+
+		if ( RHS )
+		{
+			for ( unsigned int r = 0; r < iStride; ++r )
+				fSum[ r ] = pXj[ r ];
+
+			for ( unsigned int p = pOffsets[ j ] + 1; p < pOffsets[ j + 1 ]; ++p )
+			{
+				const double* pXi = pX + (size_t)pRows[ p ] * iStride;
+
+				for ( unsigned int r = 0; r < iStride; ++r )
+					fSum[ r ] -= pValues[ p ] * pXi[ r ];
+			}
+
+			for ( unsigned int r = 0; r < iStride; ++r )
+				pXj[ r ] = fSum[ r ] / pValues[ pOffsets[ j ] ];
+		}
+		else
+		{
+			for ( unsigned int p = pOffsets[ j ] + 1; p < pOffsets[ j + 1 ]; ++p )
+			{
+				const double* pXi = pX + (size_t)pRows[ p ] * iStride;
+
+				for ( unsigned int r = 0; r < iStride; ++r )
+					pXj[ r ] -= pValues[ p ] * pXi[ r ];
+			}
+
+			for ( unsigned int r = 0; r < iStride; ++r )
+				pXj[ r ] /= pValues[ pOffsets[ j ] ];
+		}
+	}
+}
+
+// Solves with the factor; positions (x, y, z) are the common case.
+void SparseCholesky::solve( double* pX, unsigned int iNumRHS ) const
+{
+	if ( 3 == iNumRHS )
+		substitute< 3 >( m_iSize, m_vColumnOffsets.data(), m_vRows.data(), m_vValues.data(), pX, iNumRHS );
+	else
+		substitute< 0 >( m_iSize, m_vColumnOffsets.data(), m_vRows.data(), m_vValues.data(), pX, iNumRHS );
+}
@@ -11,14 +11,15 @@
 Sphere::Sphere( const vec3* pPos,
 				float fRadius,
 				long lID, const string* sTexName, const Anim_Track* pAnimTrack )
-	: Object3D( pPos, lID, sTexName, pAnimTrack )
+	: Object3D( pPos, lID, sTexName, pAnimTrack ),
+	  m_sCollider( *pPos, fRadius )
 {
 	ShaderManager* pShdrMngr = ShaderManager::getInstance();
 
 	m_fRadius = fRadius;
 	generateMesh();
 	calculateUVs();
-	m_pAnimTrack->animate();
+	animate();
 
 
 	// Setup Mesh information in GPU
@@ -51,13 +52,9 @@ void Sphere::draw( const vec3& vCamLookAt, float fMinThreshold, float fMaxThresh
 		m_pTexture->bindTexture( ShaderManager::eShaderType::MESH_SHDR, "mySampler" );
 
 	if ( nullptr != m_pAnimTrack )
-	{
-		m_pAnimTrack->animate();
-		m_pPosition = m_pAnimTrack->getPosition();
 		m_pAnimTrack->draw();
-	}
 
-	mat4 pPositionTranslated = m_pAnimTrack->getFreNetFrames();
+	mat4 pPositionTranslated = getPublishedFrame();
 	glUseProgram( pShdrMngr->getProgram( ShaderManager::eShaderType::MESH_SHDR ) );
 	pShdrMngr->setUniformFloat( ShaderManager::eShaderType::MESH_SHDR, "fScale", m_fScale );
 	pShdrMngr->setUnifromMatrix4x4( ShaderManager::eShaderType::MESH_SHDR, "translate", &pPositionTranslated );
@@ -75,6 +72,18 @@ void Sphere::draw( const vec3& vCamLookAt, float fMinThreshold, float fMaxThresh
 	glBindVertexArray( 0 );
 }
 
+// Steps the track, then places the sphere and its collider on it.
+void Sphere::animate()
+{
+	Object3D::animate();
+
+	if ( nullptr != m_pAnimTrack )
+	{
+		m_pPosition = m_pAnimTrack->getPosition();
+		m_sCollider.setCenter( m_pPosition );
+	}
+}
+
 // Overridden Debug Output
 string Sphere::getDebugOutput()
 {
@@ -88,6 +97,12 @@ string Sphere::getDebugOutput()
 	return sOutput;
 }
 
+// Checks collision of ray from start point against this sphere.
+bool Sphere::isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal )
+{
+	return m_sCollider.isCollision( vStart, vRay, fT, vIntersectingNormal );
+}
+
 // calculates a mesh of vertices and UV coords for the sphere
 void Sphere::generateMesh()
 {
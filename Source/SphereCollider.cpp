@@ -0,0 +1,93 @@
+#include "SphereCollider.h"
+
+#define COLLISION_BATCH 64		// Rays tested against the sphere at a time
+
+// Constructor
+SphereCollider::SphereCollider( const vec3& vCenter, float fRadius )
+{
+	m_vCenter = vCenter;
+	m_fRadius = fRadius;
+}
+
+// Points of the segment are vStart + t * vRay for t in [0, 1]; with vDiff = vStart - vCenter the segment meets
+//	the sphere where a*t^2 + 2*b*t + c = 0, with a = |vRay|^2, b = dot( vDiff, vRay ) and c = |vDiff|^2 - r^2.
+//	It enters from outside if it starts outside (c >= 0), moves towards the center (b < 0) and the first root
+//	t = (-b - sqrt( b^2 - a*c )) / a is real and no further than the end of the segment.
+bool SphereCollider::isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal ) const
+{
+	vec3 vDiff = vStart - m_vCenter;
+	float fB = dot( vDiff, vRay );
+	float fC = dot( vDiff, vDiff ) - m_fRadius * m_fRadius;
+	float fA, fDiscriminant, fFraction;
+	bool bReturn = false;
+
+	// Inside already or moving away: the segment can't enter
+	if ( fC >= 0.0f && fB < 0.0f )
+	{
+		fA = dot( vRay, vRay );
+		fDiscriminant = fB * fB - fA * fC;
+
+		if ( fDiscriminant >= 0.0f )
+		{
+			fFraction = (-fB - sqrt( fDiscriminant )) / fA;
+			bReturn = fFraction <= 1.0f;
+		}
+	}
+
+	if ( bReturn )
+	{
+		fT = fFraction * sqrt( fA );
+		vIntersectingNormal = (vDiff + vRay * fFraction) / m_fRadius;
+	}
+
+	return bReturn;
+}
+
+// Same test as isCollision without branches, vectorized over COLLISION_BATCH rays at a time; only the hits are
+//	then written out.
+void SphereCollider::findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+									unsigned int* pObject, unsigned int iObject ) const
+{
+	float fFraction[ COLLISION_BATCH ];
+	float fDistance[ COLLISION_BATCH ];
+	float fRadius2 = m_fRadius * m_fRadius;
+
+	for ( unsigned int iFirst = 0; iFirst < iCount; iFirst += COLLISION_BATCH )
+	{
+		unsigned int iBatch = std::min( iCount - iFirst, (unsigned int)COLLISION_BATCH );
+		const vec3* pBatchStart = pStart + iFirst;
+		const vec3* pBatchRay = pRay + iFirst;
+
+#if _OPENMP >= 201307
+		#pragma omp simd
+#endif
+		for ( unsigned int i = 0; i < iBatch; ++i )
+		{
+			float fX = pBatchStart[ i ].x - m_vCenter.x, fY = pBatchStart[ i ].y - m_vCenter.y, fZ = pBatchStart[ i ].z - m_vCenter.z;
+			float fA = pBatchRay[ i ].x * pBatchRay[ i ].x + pBatchRay[ i ].y * pBatchRay[ i ].y + pBatchRay[ i ].z * pBatchRay[ i ].z;
+			float fB = fX * pBatchRay[ i ].x + fY * pBatchRay[ i ].y + fZ * pBatchRay[ i ].z;
+			float fC = fX * fX + fY * fY + fZ * fZ - fRadius2;
+			float fDiscriminant = fB * fB - fA * fC;
+			bool bHit = (fC >= 0.0f) & (fB < 0.0f) & (fDiscriminant >= 0.0f);
+
+			// a > 0 whenever b < 0, the misses only need something to divide by
+			float fRoot = -fB - sqrt( bHit ? fDiscriminant : 0.0f );
+			float fScale = bHit ? fA : 1.0f;
+
+			fFraction[ i ] = fRoot / fScale;
+			fDistance[ i ] = (bHit & (fRoot <= fA)) ? fRoot / sqrt( fScale ) : FLT_MAX;
+		}
+
+		for ( unsigned int i = 0; i < iBatch; ++i )
+		{
+			unsigned int iRay = iFirst + i;
+
+			if ( fDistance[ i ] < pT[ iRay ] )
+			{
+				pT[ iRay ] = fDistance[ i ];
+				pNormal[ iRay ] = (pStart[ iRay ] + pRay[ iRay ] * fFraction[ i ] - m_vCenter) / m_fRadius;
+				pObject[ iRay ] = iObject;
+			}
+		}
+	}
+}
@@ -0,0 +1,279 @@
+#include "SpringKernels.h"
+#include <cmath>
+
+/***********\
+ * DEFINES *
+\***********/
+#if defined( __x86_64__ ) || defined( __i386__ ) || defined( _M_X64 ) || defined( _M_IX86 )
+#define SPRING_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// Per-function instruction set targets so the rest of the program doesn't need -mavx2
+#if defined( SPRING_KERNELS_X86 ) && defined( __GNUC__ )
+#define TARGET_AVX2 __attribute__( ( target( "avx2,fma" ) ) )
+#define TARGET_AVX512 __attribute__( ( target( "avx512f" ) ) )
+#define SPRING_KERNELS_AVX512
+#elif defined( SPRING_KERNELS_X86 )
+#define TARGET_AVX2
+#define TARGET_AVX512
+#if _MSC_VER >= 1911	// AVX-512 intrinsics are only available from VS 2017 15.3
+#define SPRING_KERNELS_AVX512
+#endif
+#endif
+
+#define AVX2_WIDTH 8
+#define AVX512_WIDTH 16
+
+using glm::vec3;
+
+/*********************************************************************************\
+* Kernel Selection                                                               *
+\*********************************************************************************/
+
+// Checks whether the CPU (and OS) can run the given kernel.
+bool SpringKernels::isSupported( eKernelType eType )
+{
+	bool bReturnValue = false;
+
+	switch ( eType )
+	{
+	case SCALAR_KERNEL:
+		bReturnValue = true;
+		break;
+#ifdef SPRING_KERNELS_X86
+#ifdef __GNUC__
+	case AVX2_KERNEL:
+		bReturnValue = __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+		break;
+	case AVX512_KERNEL:
+		bReturnValue = __builtin_cpu_supports( "avx512f" );
+		break;
+#else
+	case AVX2_KERNEL:
+	case AVX512_KERNEL:
+	{
+		int iInfo[ 4 ];
+		bool bOSXSave, bFMA;
+
+		__cpuid( iInfo, 1 );
+		bOSXSave = 0 != (iInfo[ 2 ] & (1 << 27));
+		bFMA = 0 != (iInfo[ 2 ] & (1 << 12));
+
+		if ( bOSXSave )
+		{
+			unsigned long long iXCR0 = _xgetbv( 0 );
+			__cpuidex( iInfo, 7, 0 );
+
+			if ( AVX2_KERNEL == eType )	// OS saves YMM state, CPU has AVX2 and FMA
+				bReturnValue = (0x6 == (iXCR0 & 0x6)) && bFMA && 0 != (iInfo[ 1 ] & (1 << 5));
+#ifdef SPRING_KERNELS_AVX512
+			else						// OS saves ZMM state, CPU has AVX-512F
+				bReturnValue = (0xE6 == (iXCR0 & 0xE6)) && 0 != (iInfo[ 1 ] & (1 << 16));
+#endif
+		}
+		break;
+	}
+#endif
+#endif
+	default:
+		break;
+	}
+
+#ifndef SPRING_KERNELS_AVX512
+	bReturnValue &= (AVX512_KERNEL != eType);
+#endif
+
+	return bReturnValue;
+}
+
+// Returns the widest kernel the CPU supports.
+SpringKernels::eKernelType SpringKernels::getBestKernel()
+{
+	eKernelType eReturnType = SCALAR_KERNEL;
+
+	if ( isSupported( AVX512_KERNEL ) )
+		eReturnType = AVX512_KERNEL;
+	else if ( isSupported( AVX2_KERNEL ) )
+		eReturnType = AVX2_KERNEL;
+
+	return eReturnType;
+}
+
+// Returns the kernel function for a type; unsupported types fall back to the scalar kernel.
+SpringForceKernel SpringKernels::getKernel( eKernelType eType )
+{
+	SpringForceKernel pReturnKernel = accumulateScalar;
+
+	if ( isSupported( eType ) )
+	{
+		if ( AVX2_KERNEL == eType )
+			pReturnKernel = accumulateAVX2;
+		else if ( AVX512_KERNEL == eType )
+			pReturnKernel = accumulateAVX512;
+	}
+
+	return pReturnKernel;
+}
+
+// Name of a kernel type for output and options.
+const char* SpringKernels::getName( eKernelType eType )
+{
+	static const char* cNames[ MAX_KERNELS ] = { "scalar", "avx2", "avx512" };
+
+	return (eType < MAX_KERNELS) ? cNames[ eType ] : "unknown";
+}
+
+/*********************************************************************************\
+* Kernels                                                                        *
+\*********************************************************************************/
+
+// Reference kernel: one spring at a time.  The force on the second mass is the negation of the
+//	force on the first, so only one direction is normalized.
+void SpringKernels::accumulateScalar( const unsigned int* pMass1, const unsigned int* pMass2,
+									  const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+									  const vec3* pPosition, vec3* pForce, float fK )
+{
+	for ( unsigned int s = iBegin; s < iEnd; ++s )
+	{
+		vec3 vD12 = pPosition[ pMass2[ s ] ] - pPosition[ pMass1[ s ] ];
+		float fLength2 = dot( vD12, vD12 );
+
+		if ( fLength2 > 0.0f )
+		{
+			float fLength = sqrt( fLength2 );
+			vec3 vF12 = vD12 * (fK * (fLength - pRestLength[ s ]) / fLength);
+
+			pForce[ pMass1[ s ] ] += vF12;
+			pForce[ pMass2[ s ] ] -= vF12;
+		}
+	}
+}
+
+#ifdef SPRING_KERNELS_X86
+// 8 springs per iteration: gathers both end points, one rsqrt (+ Newton-Raphson step) per spring,
+//	then adds the forces lane by lane so springs sharing a mass in the same batch stay correct.
+TARGET_AVX2
+void SpringKernels::accumulateAVX2( const unsigned int* pMass1, const unsigned int* pMass2,
+									const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+									const vec3* pPosition, vec3* pForce, float fK )
+{
+	const float* pPos = &pPosition[ 0 ].x;
+	const __m256 vK = _mm256_set1_ps( fK );
+	const __m256 vHalf = _mm256_set1_ps( 0.5f );
+	const __m256 vThreeHalves = _mm256_set1_ps( 1.5f );
+	const __m256 vZero = _mm256_setzero_ps();
+	alignas( 32 ) float fX[ AVX2_WIDTH ], fY[ AVX2_WIDTH ], fZ[ AVX2_WIDTH ];
+	unsigned int s = iBegin;
+
+	for ( ; s + AVX2_WIDTH <= iEnd; s += AVX2_WIDTH )
+	{
+		// Float offsets of each end point: index * 3
+		__m256i vIndex1 = _mm256_loadu_si256( (const __m256i*)(pMass1 + s) );
+		__m256i vIndex2 = _mm256_loadu_si256( (const __m256i*)(pMass2 + s) );
+		vIndex1 = _mm256_add_epi32( vIndex1, _mm256_slli_epi32( vIndex1, 1 ) );
+		vIndex2 = _mm256_add_epi32( vIndex2, _mm256_slli_epi32( vIndex2, 1 ) );
+
+		// Direction from mass 1 to mass 2
+		__m256 vDX = _mm256_sub_ps( _mm256_i32gather_ps( pPos, vIndex2, 4 ), _mm256_i32gather_ps( pPos, vIndex1, 4 ) );
+		__m256 vDY = _mm256_sub_ps( _mm256_i32gather_ps( pPos + 1, vIndex2, 4 ), _mm256_i32gather_ps( pPos + 1, vIndex1, 4 ) );
+		__m256 vDZ = _mm256_sub_ps( _mm256_i32gather_ps( pPos + 2, vIndex2, 4 ), _mm256_i32gather_ps( pPos + 2, vIndex1, 4 ) );
+
+		// 1 / |d| from rsqrt refined with one Newton-Raphson iteration
+		__m256 vLength2 = _mm256_fmadd_ps( vDX, vDX, _mm256_fmadd_ps( vDY, vDY, _mm256_mul_ps( vDZ, vDZ ) ) );
+		__m256 vInvLength = _mm256_rsqrt_ps( vLength2 );
+		vInvLength = _mm256_mul_ps( vInvLength,
+									_mm256_fnmadd_ps( _mm256_mul_ps( vHalf, vLength2 ), _mm256_mul_ps( vInvLength, vInvLength ), vThreeHalves ) );
+
+		// k * (|d| - rest) / |d|; zero for degenerate springs
+		__m256 vScale = _mm256_mul_ps( vK, _mm256_sub_ps( _mm256_mul_ps( vLength2, vInvLength ), _mm256_loadu_ps( pRestLength + s ) ) );
+		vScale = _mm256_and_ps( _mm256_mul_ps( vScale, vInvLength ), _mm256_cmp_ps( vLength2, vZero, _CMP_GT_OQ ) );
+
+		_mm256_store_ps( fX, _mm256_mul_ps( vDX, vScale ) );
+		_mm256_store_ps( fY, _mm256_mul_ps( vDY, vScale ) );
+		_mm256_store_ps( fZ, _mm256_mul_ps( vDZ, vScale ) );
+
+		for ( unsigned int l = 0; l < AVX2_WIDTH; ++l )
+		{
+			vec3 vF12( fX[ l ], fY[ l ], fZ[ l ] );
+			pForce[ pMass1[ s + l ] ] += vF12;
+			pForce[ pMass2[ s + l ] ] -= vF12;
+		}
+	}
+
+	// Remainder
+	accumulateScalar( pMass1, pMass2, pRestLength, s, iEnd, pPosition, pForce, fK );
+}
+#else
+void SpringKernels::accumulateAVX2( const unsigned int* pMass1, const unsigned int* pMass2,
+									const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+									const vec3* pPosition, vec3* pForce, float fK )
+{
+	accumulateScalar( pMass1, pMass2, pRestLength, iBegin, iEnd, pPosition, pForce, fK );
+}
+#endif
+
+#ifdef SPRING_KERNELS_AVX512
+// 16 springs per iteration; same scheme as the AVX2 kernel with rsqrt14 as the estimate.
+TARGET_AVX512
+void SpringKernels::accumulateAVX512( const unsigned int* pMass1, const unsigned int* pMass2,
+									  const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+									  const vec3* pPosition, vec3* pForce, float fK )
+{
+	const float* pPos = &pPosition[ 0 ].x;
+	const __m512 vK = _mm512_set1_ps( fK );
+	const __m512 vHalf = _mm512_set1_ps( 0.5f );
+	const __m512 vThreeHalves = _mm512_set1_ps( 1.5f );
+	const __m512 vZero = _mm512_setzero_ps();
+	alignas( 64 ) float fX[ AVX512_WIDTH ], fY[ AVX512_WIDTH ], fZ[ AVX512_WIDTH ];
+	unsigned int s = iBegin;
+
+	for ( ; s + AVX512_WIDTH <= iEnd; s += AVX512_WIDTH )
+	{
+		// Float offsets of each end point: index * 3
+		__m512i vIndex1 = _mm512_loadu_si512( (const void*)(pMass1 + s) );
+		__m512i vIndex2 = _mm512_loadu_si512( (const void*)(pMass2 + s) );
+		vIndex1 = _mm512_add_epi32( vIndex1, _mm512_slli_epi32( vIndex1, 1 ) );
+		vIndex2 = _mm512_add_epi32( vIndex2, _mm512_slli_epi32( vIndex2, 1 ) );
+
+		// Direction from mass 1 to mass 2
+		__m512 vDX = _mm512_sub_ps( _mm512_i32gather_ps( vIndex2, pPos, 4 ), _mm512_i32gather_ps( vIndex1, pPos, 4 ) );
+		__m512 vDY = _mm512_sub_ps( _mm512_i32gather_ps( vIndex2, pPos + 1, 4 ), _mm512_i32gather_ps( vIndex1, pPos + 1, 4 ) );
+		__m512 vDZ = _mm512_sub_ps( _mm512_i32gather_ps( vIndex2, pPos + 2, 4 ), _mm512_i32gather_ps( vIndex1, pPos + 2, 4 ) );
+
+		// 1 / |d| from rsqrt14 refined with one Newton-Raphson iteration
+		__m512 vLength2 = _mm512_fmadd_ps( vDX, vDX, _mm512_fmadd_ps( vDY, vDY, _mm512_mul_ps( vDZ, vDZ ) ) );
+		__m512 vInvLength = _mm512_rsqrt14_ps( vLength2 );
+		vInvLength = _mm512_mul_ps( vInvLength,
+									_mm512_fnmadd_ps( _mm512_mul_ps( vHalf, vLength2 ), _mm512_mul_ps( vInvLength, vInvLength ), vThreeHalves ) );
+
+		// k * (|d| - rest) / |d|; zero for degenerate springs
+		__m512 vScale = _mm512_mul_ps( vK, _mm512_sub_ps( _mm512_mul_ps( vLength2, vInvLength ), _mm512_loadu_ps( pRestLength + s ) ) );
+		vScale = _mm512_maskz_mul_ps( _mm512_cmp_ps_mask( vLength2, vZero, _CMP_GT_OQ ), vScale, vInvLength );
+
+		_mm512_store_ps( fX, _mm512_mul_ps( vDX, vScale ) );
+		_mm512_store_ps( fY, _mm512_mul_ps( vDY, vScale ) );
+		_mm512_store_ps( fZ, _mm512_mul_ps( vDZ, vScale ) );
+
+		for ( unsigned int l = 0; l < AVX512_WIDTH; ++l )
+		{
+			vec3 vF12( fX[ l ], fY[ l ], fZ[ l ] );
+			pForce[ pMass1[ s + l ] ] += vF12;
+			pForce[ pMass2[ s + l ] ] -= vF12;
+		}
+	}
+
+	// Remainder
+	accumulateScalar( pMass1, pMass2, pRestLength, s, iEnd, pPosition, pForce, fK );
+}
+#else
+void SpringKernels::accumulateAVX512( const unsigned int* pMass1, const unsigned int* pMass2,
+									  const float* pRestLength, unsigned int iBegin, unsigned int iEnd,
+									  const vec3* pPosition, vec3* pForce, float fK )
+{
+	accumulateAVX2( pMass1, pMass2, pRestLength, iBegin, iEnd, pPosition, pForce, fK );
+}
+#endif
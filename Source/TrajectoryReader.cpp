@@ -0,0 +1,185 @@
+#include "TrajectoryReader.h"
+#include <climits>
+
+/***********\
+ * DEFINES *
+\***********/
+#define NO_CHUNK UINT_MAX		// Nothing decoded yet
+#define MAX_VARINT_SHIFT 28		// Shift of the last 7 bits that fit in a 32-bit value
+
+// Maps the file and finds its chunks: from the index at the end of the file when it was closed, otherwise
+//	by walking them from the header.
+TrajectoryReader::TrajectoryReader( const string& sFileName )
+	: m_sFile( sFileName )
+{
+	m_sHeader = {};
+	m_iNumFrames = 0;
+	m_iChunk = NO_CHUNK;
+	m_iFrame = 0;
+	m_iNextFrameOffset = 0;
+
+	if ( m_sFile.isOpen() && m_sFile.getSize() >= sizeof( TrajectoryRecorder::FileHeader ) )
+	{
+		memcpy( &m_sHeader, m_sFile.getData(), sizeof( TrajectoryRecorder::FileHeader ) );
+
+		if ( TrajectoryRecorder::FILE_MAGIC == m_sHeader.iMagic && TrajectoryRecorder::VERSION == m_sHeader.iVersion
+			 && sizeof( TrajectoryRecorder::FileHeader ) == m_sHeader.iHeaderSize )
+		{
+			if ( !readIndex() )
+				scanChunks();
+		}
+	}
+
+	if ( !isOpen() )
+		cout << "Error: Trajectory \"" << sFileName << "\" can't be read.\n";
+}
+
+// Reads the index the footer points to.  Every entry has to point at the header of a chunk that starts
+//	where the one before ended, in frames, and the chunks have to end on the index.
+bool TrajectoryReader::readIndex()
+{
+	const char* pData = m_sFile.getData();
+	size_t iSize = m_sFile.getSize();
+	TrajectoryRecorder::Footer sFooter;
+	TrajectoryRecorder::ChunkHeader sChunk;
+	unsigned long long iNextFrame = 0;
+	bool bReturn;
+
+	if ( iSize < sizeof( TrajectoryRecorder::FileHeader ) + sizeof( TrajectoryRecorder::Footer ) )
+		return false;
+
+	memcpy( &sFooter, pData + iSize - sizeof( TrajectoryRecorder::Footer ), sizeof( TrajectoryRecorder::Footer ) );
+	bReturn = TrajectoryRecorder::INDEX_MAGIC == sFooter.iMagic
+		&& sFooter.iIndexOffset <= iSize - sizeof( TrajectoryRecorder::Footer )
+		&& (iSize - sizeof( TrajectoryRecorder::Footer ) - sFooter.iIndexOffset) == sFooter.iNumChunks * sizeof( TrajectoryRecorder::IndexEntry );
+
+	if ( bReturn )
+	{
+		m_vIndex.resize( sFooter.iNumChunks );
+		memcpy( m_vIndex.data(), pData + sFooter.iIndexOffset, m_vIndex.size() * sizeof( TrajectoryRecorder::IndexEntry ) );
+	}
+
+	for ( unsigned int c = 0; c < m_vIndex.size() && bReturn; ++c )
+	{
+		bReturn = m_vIndex[ c ].iFirstFrame == iNextFrame && m_vIndex[ c ].iOffset >= sizeof( TrajectoryRecorder::FileHeader )
+			&& m_vIndex[ c ].iOffset + sizeof( TrajectoryRecorder::ChunkHeader ) <= sFooter.iIndexOffset;
+
+		if ( bReturn )
+		{
+			memcpy( &sChunk, pData + m_vIndex[ c ].iOffset, sizeof( TrajectoryRecorder::ChunkHeader ) );
+			bReturn = TrajectoryRecorder::CHUNK_MAGIC == sChunk.iMagic && sChunk.iFirstFrame == iNextFrame
+				&& sChunk.iBytes <= sFooter.iIndexOffset - m_vIndex[ c ].iOffset - sizeof( TrajectoryRecorder::ChunkHeader );
+			iNextFrame += sChunk.iNumFrames;
+		}
+	}
+
+	if ( bReturn && iNextFrame == sFooter.iNumFrames )
+		m_iNumFrames = sFooter.iNumFrames;
+	else
+		m_vIndex.clear();
+
+	return !m_vIndex.empty();
+}
+
+// Indexes the chunks of a file that wasn't closed, up to the first one cut short.
+void TrajectoryReader::scanChunks()
+{
+	const char* pData = m_sFile.getData();
+	size_t iSize = m_sFile.getSize();
+	size_t iOffset = sizeof( TrajectoryRecorder::FileHeader );
+	TrajectoryRecorder::ChunkHeader sChunk;
+
+	m_vIndex.clear();
+	m_iNumFrames = 0;
+
+	while ( iSize - iOffset >= sizeof( TrajectoryRecorder::ChunkHeader ) )
+	{
+		memcpy( &sChunk, pData + iOffset, sizeof( TrajectoryRecorder::ChunkHeader ) );
+		if ( TrajectoryRecorder::CHUNK_MAGIC != sChunk.iMagic || sChunk.iFirstFrame != m_iNumFrames
+			 || sChunk.iBytes > iSize - iOffset - sizeof( TrajectoryRecorder::ChunkHeader ) )
+			break;
+
+		m_vIndex.push_back( { sChunk.iFirstFrame, iOffset } );
+		m_iNumFrames += sChunk.iNumFrames;
+		iOffset += sizeof( TrajectoryRecorder::ChunkHeader ) + sChunk.iBytes;
+	}
+}
+
+// Seeks to the chunk holding the frame and decodes up to it, carrying on from the frame decoded last if
+//	it's earlier in the same chunk.
+bool TrajectoryReader::readFrame( unsigned long long iFrame, aligned_vector< vec3 >& vPositions )
+{
+	TrajectoryRecorder::ChunkHeader sChunk;
+	unsigned int iChunk;
+	size_t iEnd;
+	bool bReturn = true;
+
+	if ( !isOpen() || iFrame >= m_iNumFrames )
+		return false;
+
+	iChunk = (unsigned int)(upper_bound( m_vIndex.begin(), m_vIndex.end(), iFrame,
+		[]( unsigned long long iValue, const TrajectoryRecorder::IndexEntry& sEntry ) { return iValue < sEntry.iFirstFrame; } )
+		- m_vIndex.begin()) - 1;
+	memcpy( &sChunk, m_sFile.getData() + m_vIndex[ iChunk ].iOffset, sizeof( TrajectoryRecorder::ChunkHeader ) );
+	iEnd = m_vIndex[ iChunk ].iOffset + sizeof( TrajectoryRecorder::ChunkHeader ) + sChunk.iBytes;
+
+	if ( iChunk != m_iChunk || iFrame < m_iFrame )
+	{
+		m_iChunk = iChunk;
+		m_iFrame = sChunk.iFirstFrame;
+		m_iNextFrameOffset = m_vIndex[ iChunk ].iOffset + sizeof( TrajectoryRecorder::ChunkHeader );
+		bReturn = decodeFrame( iEnd, true );
+	}
+
+	while ( bReturn && m_iFrame < iFrame )
+	{
+		bReturn = decodeFrame( iEnd, false );
+		++m_iFrame;
+	}
+
+	if ( bReturn )
+	{
+		vPositions.resize( m_sHeader.iNumMasses );
+		for ( unsigned int i = 0; i < m_sHeader.iNumMasses; ++i )
+			for ( unsigned int a = 0; a < 3; ++a )
+				vPositions[ i ][ a ] = sChunk.fMin[ a ] + (float)m_vQuantized[ 3 * i + a ] * sChunk.fStep[ a ];
+	}
+	else
+		m_iChunk = NO_CHUNK;
+
+	return bReturn;
+}
+
+// Decodes the next frame of the current chunk into m_vQuantized: the values themselves for its first frame,
+//	the zigzagged changes to add for the others.  Fails on an encoding that would run past iEnd.
+bool TrajectoryReader::decodeFrame( size_t iEnd, bool bFirst )
+{
+	const unsigned char* pData = reinterpret_cast< const unsigned char* >( m_sFile.getData() );
+	size_t iOffset = m_iNextFrameOffset;
+	unsigned int iNumValues = 3 * m_sHeader.iNumMasses;
+
+	m_vQuantized.resize( iNumValues );
+
+	for ( unsigned int v = 0; v < iNumValues; ++v )
+	{
+		unsigned int iValue = 0, iShift = 0;
+		unsigned char iByte;
+
+		do
+		{
+			if ( iOffset >= iEnd || iShift > MAX_VARINT_SHIFT )
+				return false;
+			iByte = pData[ iOffset++ ];
+			iValue |= (unsigned int)(iByte & 0x7fu) << iShift;
+			iShift += 7;
+		} while ( iByte & 0x80u );
+
+		if ( bFirst )
+			m_vQuantized[ v ] = (unsigned short)iValue;
+		else
+			m_vQuantized[ v ] = (unsigned short)(m_vQuantized[ v ] + ((iValue >> 1) ^ (0u - (iValue & 1u))));
+	}
+
+	m_iNextFrameOffset = iOffset;
+	return true;
+}
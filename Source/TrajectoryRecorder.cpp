@@ -0,0 +1,260 @@
+#include "TrajectoryRecorder.h"
+#include <cfloat>
+#include <climits>
+#include <cmath>
+
+/***********\
+ * DEFINES *
+\***********/
+#define QUANTIZED_MAX 65535.0f		// Largest 16-bit quantized value, the top of a chunk's bounding box
+
+// Appends iValue 7 bits at a time, low bits first, with the top bit of every byte but the last set.
+static void putVarint( vector< unsigned char >& vBytes, unsigned int iValue )
+{
+	while ( iValue >= 0x80u )
+	{
+		vBytes.push_back( (unsigned char)(iValue | 0x80u) );
+		iValue >>= 7;
+	}
+	vBytes.push_back( (unsigned char)iValue );
+}
+
+// Default Constructor
+TrajectoryRecorder::TrajectoryRecorder()
+{
+	m_iNumMasses = 0;
+	m_iChunkFrames = DEFAULT_CHUNK_FRAMES;
+	m_iMaxQueued = DEFAULT_CHUNK_FRAMES;
+	m_bClosing = false;
+	m_iFrameCount = 0;
+	m_iFramesDropped = 0;
+	m_iBytesWritten = 0;
+	m_iFramesWritten = 0;
+}
+
+// Destructor: the file is finished before it's let go
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+	close();
+}
+
+// Closes the file being recorded, if any, then starts a new one.  The queue takes as many frames as a chunk.
+bool TrajectoryRecorder::open( const string& sFileName, unsigned int iNumMasses, unsigned int iChunkFrames )
+{
+	FileHeader sHeader = {};
+	unsigned long long iFrameBytes = (unsigned long long)iNumMasses * sizeof( vec3 );
+	unsigned long long iBudgetFrames = (iFrameBytes > 0) ? BUFFER_BYTES / iFrameBytes : DEFAULT_CHUNK_FRAMES;
+
+	close();
+
+	m_sFileName = sFileName;
+	m_sFile.clear();
+	m_sFile.open( sFileName, ios::binary | ios::trunc );
+	if ( !m_sFile )
+	{
+		cout << "Error: Unable to create trajectory \"" << sFileName << "\".\n";
+		return false;
+	}
+
+	m_iNumMasses = iNumMasses;
+	m_iChunkFrames = iChunkFrames > 0 ? iChunkFrames : DEFAULT_CHUNK_FRAMES;
+	if ( m_iChunkFrames > iBudgetFrames )
+		m_iChunkFrames = iBudgetFrames > 0 ? (unsigned int)iBudgetFrames : 1;
+	m_iMaxQueued = m_iChunkFrames;
+	m_bClosing = false;
+	m_iFrameCount = 0;
+	m_iFramesDropped = 0;
+	m_iBytesWritten = 0;
+	m_iFramesWritten = 0;
+	m_vIndex.clear();
+
+	sHeader.iMagic = FILE_MAGIC;
+	sHeader.iVersion = VERSION;
+	sHeader.iHeaderSize = sizeof( FileHeader );
+	sHeader.iNumMasses = m_iNumMasses;
+	sHeader.iChunkFrames = m_iChunkFrames;
+	write( &sHeader, sizeof( FileHeader ) );
+
+	m_pThread = thread( &TrajectoryRecorder::run, this );
+	return true;
+}
+
+// Only the copy is made on the calling thread, into a frame the writer is done with when there's one.  The
+//	writer only takes frames off the queue, so one that has room here still has room once the copy is made.
+bool TrajectoryRecorder::record( const aligned_vector< vec3 >& vPositions )
+{
+	aligned_vector< vec3 > vFrame;
+
+	if ( !isOpen() || vPositions.size() != m_iNumMasses )
+		return false;
+
+	{
+		lock_guard< mutex > lQueue( m_mQueue );
+		if ( m_vQueued.size() >= m_iMaxQueued )
+		{
+			++m_iFramesDropped;
+			return false;
+		}
+		if ( !m_vFree.empty() )
+		{
+			vFrame.swap( m_vFree.back() );
+			m_vFree.pop_back();
+		}
+	}
+
+	vFrame.assign( vPositions.begin(), vPositions.end() );
+
+	{
+		lock_guard< mutex > lQueue( m_mQueue );
+		m_vQueued.push_back( move( vFrame ) );
+	}
+	m_cvQueue.notify_one();
+	++m_iFrameCount;
+
+	return true;
+}
+
+// Lets the writer thread drain the queue and finish the file, then waits for it.
+bool TrajectoryRecorder::close()
+{
+	bool bReturn = true;
+
+	if ( isOpen() )
+	{
+		{
+			lock_guard< mutex > lQueue( m_mQueue );
+			m_bClosing = true;
+		}
+		m_cvQueue.notify_one();
+		m_pThread.join();
+
+		m_sFile.close();
+		bReturn = !m_sFile.fail();
+		if ( !bReturn )
+			cout << "Error: Unable to write trajectory \"" << m_sFileName << "\".\n";
+
+		m_vFree.clear();
+	}
+
+	return bReturn;
+}
+
+// Writer thread: gathers queued frames into chunks and writes each once full.  Closing writes the last,
+//	partial chunk, then the index of every chunk and the footer pointing to it.
+void TrajectoryRecorder::run()
+{
+	unique_lock< mutex > lQueue( m_mQueue );
+	Footer sFooter = {};
+
+	while ( true )
+	{
+		m_cvQueue.wait( lQueue, [ this ] { return m_bClosing || !m_vQueued.empty(); } );
+		if ( m_vQueued.empty() )
+			break;
+
+		m_vChunk.push_back( move( m_vQueued.front() ) );
+		m_vQueued.pop_front();
+
+		if ( m_vChunk.size() == m_iChunkFrames )
+		{
+			lQueue.unlock();
+			writeChunk();
+			lQueue.lock();
+		}
+	}
+	lQueue.unlock();
+
+	if ( !m_vChunk.empty() )
+		writeChunk();
+
+	sFooter.iMagic = INDEX_MAGIC;
+	sFooter.iNumChunks = m_vIndex.size();
+	sFooter.iNumFrames = m_iFramesWritten;
+	sFooter.iIndexOffset = m_iBytesWritten;
+	write( m_vIndex.data(), m_vIndex.size() * sizeof( IndexEntry ) );
+	write( &sFooter, sizeof( Footer ) );
+}
+
+// Quantizes the frames of the chunk within their bounding box and encodes them: the first frame's values
+//	as they are, every other's as the zigzagged difference from the frame before, so a mass that barely
+//	moved takes a byte per axis.  Positions that aren't finite don't widen the box and come back as its
+//	minimum.
+void TrajectoryRecorder::writeChunk()
+{
+	ChunkHeader sChunk = {};
+	vec3 vMin( FLT_MAX ), vMax( -FLT_MAX ), vScale;
+	unsigned int iNumValues = 3 * m_iNumMasses;
+
+	for ( unsigned int f = 0; f < m_vChunk.size(); ++f )
+	{
+		for ( unsigned int i = 0; i < m_iNumMasses; ++i )
+		{
+			const vec3& vPos = m_vChunk[ f ][ i ];
+
+			if ( isfinite( vPos.x ) && isfinite( vPos.y ) && isfinite( vPos.z ) )
+			{
+				vMin = min( vMin, vPos );
+				vMax = max( vMax, vPos );
+			}
+		}
+	}
+	if ( vMin.x > vMax.x )
+		vMin = vMax = vec3( 0.0f );
+
+	for ( unsigned int a = 0; a < 3; ++a )
+	{
+		sChunk.fMin[ a ] = vMin[ a ];
+		sChunk.fStep[ a ] = (vMax[ a ] - vMin[ a ]) / QUANTIZED_MAX;
+		vScale[ a ] = sChunk.fStep[ a ] > 0.0f ? 1.0f / sChunk.fStep[ a ] : 0.0f;
+	}
+
+	m_vEncoded.clear();
+	m_vQuantized.resize( iNumValues );
+	m_vPrevQuantized.resize( iNumValues );
+
+	for ( unsigned int f = 0; f < m_vChunk.size(); ++f )
+	{
+		const float* pPos = value_ptr( m_vChunk[ f ][ 0 ] );
+
+		for ( unsigned int v = 0; v < iNumValues; ++v )
+		{
+			float fQuantized = (pPos[ v ] - sChunk.fMin[ v % 3 ]) * vScale[ v % 3 ] + 0.5f;
+
+			// Written so a NaN fails the first test
+			m_vQuantized[ v ] = fQuantized > 0.0f ? (fQuantized < QUANTIZED_MAX ? (unsigned short)fQuantized : USHRT_MAX) : 0;
+
+			if ( 0 == f )
+				putVarint( m_vEncoded, m_vQuantized[ v ] );
+			else
+			{
+				int iDelta = (int)m_vQuantized[ v ] - (int)m_vPrevQuantized[ v ];
+				putVarint( m_vEncoded, ((unsigned int)iDelta << 1) ^ (unsigned int)(iDelta >> 31) );
+			}
+		}
+		m_vQuantized.swap( m_vPrevQuantized );
+	}
+
+	sChunk.iMagic = CHUNK_MAGIC;
+	sChunk.iNumFrames = m_vChunk.size();
+	sChunk.iFirstFrame = m_iFramesWritten;
+	sChunk.iBytes = m_vEncoded.size();
+
+	m_vIndex.push_back( { m_iFramesWritten, m_iBytesWritten } );
+	write( &sChunk, sizeof( ChunkHeader ) );
+	write( m_vEncoded.data(), m_vEncoded.size() );
+	m_iFramesWritten += m_vChunk.size();
+
+	// The frames can be reused by record
+	{
+		lock_guard< mutex > lQueue( m_mQueue );
+		for ( unsigned int f = 0; f < m_vChunk.size(); ++f )
+			m_vFree.push_back( move( m_vChunk[ f ] ) );
+	}
+	m_vChunk.clear();
+}
+
+void TrajectoryRecorder::write( const void* pData, size_t iBytes )
+{
+	m_sFile.write( static_cast< const char* >( pData ), iBytes );
+	m_iBytesWritten += iBytes;
+}
@@ -4,20 +4,14 @@
 #define VERTEX_1 m_pVertices[1]
 #define VERTEX_2 m_pVertices[2]
 #define EPSILON	1e-6
-#define NUM_VERTS 3
 
 // Constructor.
 Triangle::Triangle( const vec3* pPosition, const vector<vec3>* pVerts, long lID, const string* sTexName, const Anim_Track* pAnimTrack )
-	: Object3D( pPosition, lID, sTexName, pAnimTrack )
+	: Object3D( pPosition, lID, sTexName, pAnimTrack ),
+	  m_sCollider( *pVerts )
 {
-	if ( NUM_VERTS != pVerts->size() )
-	{
-		m_pVertices.push_back( vec3( 1.f, 0.f, 0.f ) );
-		m_pVertices.push_back( vec3( 0.f, 1.f, 0.f ) );
-		m_pVertices.push_back( vec3( 0.f, 0.f, 1.f ) );
-	}
-	else
-		m_pVertices.insert( m_pVertices.begin(), pVerts->begin(), pVerts->end() );
+	// Geometry comes from the collider (default triangle), so collisions happen where the Triangle is drawn
+	m_pVertices = m_sCollider.getVertices();
 
 	mat4 pTranslation = translate( m_pPosition - vec3( 0.f ) );
 
@@ -65,6 +59,12 @@ void Triangle::draw( const vec3& vCamLookAt, float fMinThreshold, float fMaxThre
 	glBindVertexArray( 0 );
 }
 
+// Checks collision of ray from start point against this triangle.
+bool Triangle::isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal )
+{
+	return m_sCollider.isCollision( vStart, vRay, fT, vIntersectingNormal );
+}
+
 // Inherited from Parent
 void Triangle::calculateUVs()
 {
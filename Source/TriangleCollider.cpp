@@ -0,0 +1,122 @@
+#include "TriangleCollider.h"
+
+#define NUM_VERTS 3
+#define COLLISION_BATCH 64		// Rays classified against the triangle at a time
+#define EDGE_SLACK 1e-4f		// Hits this close outside an edge still count, so rays through a shared edge aren't missed
+
+// Constructor: Finds the normal, edges and bounds of the triangle.
+TriangleCollider::TriangleCollider( const vector< vec3 >& vVertices )
+{
+	if ( NUM_VERTS != vVertices.size() )	// Set up a default Triangle
+	{
+		m_vVertices.push_back( vec3( 1.f, 0.f, 0.f ) );
+		m_vVertices.push_back( vec3( 0.f, 1.f, 0.f ) );
+		m_vVertices.push_back( vec3( 0.f, 0.f, 1.f ) );
+	}
+	else
+		m_vVertices.insert( m_vVertices.begin(), vVertices.begin(), vVertices.end() );
+
+	// A degenerate triangle gets a zero normal: no segment crosses its plane, so it's never hit.
+	vec3 vNormal = cross( m_vVertices[ 1 ] - m_vVertices[ 0 ], m_vVertices[ 2 ] - m_vVertices[ 0 ] );
+	float fLength = length( vNormal );
+
+	m_vNormal = (fLength > 0.0f) ? vNormal / fLength : vec3( 0.0f );
+	m_fD = dot( m_vNormal, m_vVertices[ 0 ] );
+
+	for ( unsigned int e = 0; e < NUM_VERTS; ++e )
+	{
+		const vec3& vFrom = m_vVertices[ e ];
+		const vec3& vTo = m_vVertices[ (e + 1) % NUM_VERTS ];
+		vec3 vEdgeNormal = cross( m_vNormal, vTo - vFrom );
+
+		fLength = length( vEdgeNormal );
+		m_vEdgeNormal[ e ] = (fLength > 0.0f) ? vEdgeNormal / fLength : vec3( 0.0f );
+		m_fEdgeOffset[ e ] = dot( m_vEdgeNormal[ e ], vFrom );
+
+		if ( dot( m_vEdgeNormal[ e ], m_vVertices[ (e + 2) % NUM_VERTS ] ) < m_fEdgeOffset[ e ] )
+		{
+			m_vEdgeNormal[ e ] = -m_vEdgeNormal[ e ];
+			m_fEdgeOffset[ e ] = -m_fEdgeOffset[ e ];
+		}
+	}
+
+	m_vMin = min( min( m_vVertices[ 0 ], m_vVertices[ 1 ] ), m_vVertices[ 2 ] );
+	m_vMax = max( max( m_vVertices[ 0 ], m_vVertices[ 1 ] ), m_vVertices[ 2 ] );
+}
+
+// A point on the plane is inside the triangle if it's on the inner side of all 3 edges.
+bool TriangleCollider::isInside( const vec3& vPoint ) const
+{
+	return dot( vPoint, m_vEdgeNormal[ 0 ] ) >= m_fEdgeOffset[ 0 ] - EDGE_SLACK
+		&& dot( vPoint, m_vEdgeNormal[ 1 ] ) >= m_fEdgeOffset[ 1 ] - EDGE_SLACK
+		&& dot( vPoint, m_vEdgeNormal[ 2 ] ) >= m_fEdgeOffset[ 2 ] - EDGE_SLACK;
+}
+
+// Only segments whose bounds overlap the triangle's and that end on the other side of its plane can hit; that
+//	test is a few compares and a pair of dot products per ray and runs vectorized over COLLISION_BATCH rays at a
+//	time.  The few rays that cross the plane then go through the full isCollision test.
+void TriangleCollider::findCollisions( const vec3* pStart, const vec3* pRay, unsigned int iCount, float* pT, vec3* pNormal,
+										unsigned int* pObject, unsigned int iObject ) const
+{
+	unsigned char bCrossing[ COLLISION_BATCH ];
+	float fT;
+	vec3 vNormal;
+
+	for ( unsigned int iFirst = 0; iFirst < iCount; iFirst += COLLISION_BATCH )
+	{
+		unsigned int iBatch = std::min( iCount - iFirst, (unsigned int)COLLISION_BATCH );
+		const vec3* pBatchStart = pStart + iFirst;
+		const vec3* pBatchRay = pRay + iFirst;
+
+#if _OPENMP >= 201307
+		#pragma omp simd
+#endif
+		for ( unsigned int i = 0; i < iBatch; ++i )
+		{
+			const vec3& vStart = pBatchStart[ i ];
+			vec3 vEnd = vStart + pBatchRay[ i ];
+			float fStart = vStart.x * m_vNormal.x + vStart.y * m_vNormal.y + vStart.z * m_vNormal.z - m_fD;
+			float fEnd = vEnd.x * m_vNormal.x + vEnd.y * m_vNormal.y + vEnd.z * m_vNormal.z - m_fD;
+
+			bCrossing[ i ] = overlapsBounds( vStart, vEnd ) & (((fStart > 0.0f) & (fEnd <= 0.0f)) | ((fStart < 0.0f) & (fEnd >= 0.0f)));
+		}
+
+		for ( unsigned int i = 0; i < iBatch; ++i )
+		{
+			unsigned int iRay = iFirst + i;
+
+			if ( bCrossing[ i ] && isCollision( pStart[ iRay ], pRay[ iRay ], fT, vNormal ) && fT < pT[ iRay ] )
+			{
+				pT[ iRay ] = fT;
+				pNormal[ iRay ] = vNormal;
+				pObject[ iRay ] = iObject;
+			}
+		}
+	}
+}
+
+// The segment has to overlap the bounds of the triangle, then it crosses its plane if its ends are on opposite sides (a segment starting on the
+//	plane isn't entering it from either), then the crossing has to be inside the edges.  Checked over the whole
+//	segment, so a point moving any distance over a step can't pass through.
+bool TriangleCollider::isCollision( const vec3& vStart, const vec3& vRay, float& fT, vec3& vIntersectingNormal ) const
+{
+	vec3 vEnd = vStart + vRay;
+	float fStart = dot( vStart, m_vNormal ) - m_fD;
+	float fEnd = dot( vEnd, m_vNormal ) - m_fD;
+	float fFraction;
+	bool bReturn = false;
+
+	if ( overlapsBounds( vStart, vEnd ) && ((fStart > 0.0f && fEnd <= 0.0f) || (fStart < 0.0f && fEnd >= 0.0f)) )
+	{
+		fFraction = fStart / (fStart - fEnd);
+		bReturn = isInside( vStart + vRay * fFraction );
+	}
+
+	if ( bReturn )
+	{
+		fT = fFraction * length( vRay );
+		vIntersectingNormal = (fStart > 0.0f) ? m_vNormal : -m_vNormal;
+	}
+
+	return bReturn;
+}
@@ -0,0 +1,195 @@
+#include "XPBDSolver.h"
+#include "MassSpringSystem.h"
+
+/***********\
+ * DEFINES *
+\***********/
+#define DEFAULT_XPBD_ITERATIONS 10
+#define JACOBI_RELAXATION 1.5f		// Over-relaxation of the averaged Jacobi corrections (1 - 2)
+
+// Default Constructor
+XPBDSolver::XPBDSolver( MassSpringSystem* pSystem )
+{
+	m_pSystem = pSystem;
+	m_iIterations = DEFAULT_XPBD_ITERATIONS;
+	m_eIterationType = GAUSS_SEIDEL;
+}
+
+// Destructor
+XPBDSolver::~XPBDSolver()
+{
+	m_pSystem = nullptr;
+}
+
+// Sizes the buffers and gives fixed masses a weight (inverse mass) of 0 so no constraint can move them.
+void XPBDSolver::initialize()
+{
+	const MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	unsigned int iNumMasses = sMasses.size();
+	unsigned int iNumSprings = m_pSystem->m_sSprings.size();
+
+	m_vPrevPosition.assign( sMasses.m_vPosition.begin(), sMasses.m_vPosition.end() );
+	m_fWeight.resize( iNumMasses );
+	for ( unsigned int m = 0; m < iNumMasses; ++m )
+		m_fWeight[ m ] = sMasses.isFixed( m ) ? 0.0f : sMasses.m_fInvMass[ m ];
+
+	m_fLambda.assign( iNumSprings, 0.0f );
+	m_vCorrection.assign( iNumSprings, vec3( 0.0f ) );
+}
+
+// One XPBD step:
+//	1. Predict positions from the velocities and external forces, detect contacts along the predicted path.
+//	2. Project the spring and contact constraints m_iIterations times.
+//	3. Catch masses the springs pushed through a plane, then velocities from the change in position.
+void XPBDSolver::step( float fDeltaT )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	int iNumThreads = m_pSystem->m_iNumThreads;
+	int iNumMasses = (int)sMasses.size();
+	int iNumSprings = (int)m_fLambda.size();
+	float fCompliance = 1.0f / (m_pSystem->m_fK * fDeltaT * fDeltaT);	// alpha / h^2 with alpha = 1 / k
+
+	predict( fDeltaT, iNumThreads );
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int s = 0; s < iNumSprings; ++s )
+		m_fLambda[ s ] = 0.0f;
+
+	for ( unsigned int i = 0; i < m_iIterations; ++i )
+	{
+		if ( JACOBI == m_eIterationType )
+			solveJacobi( fCompliance, iNumThreads );
+		else
+			solveGaussSeidel( fCompliance, iNumThreads );
+
+		#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+		for ( int m = 0; m < iNumMasses; ++m )
+			m_pSystem->projectContact( m, m_vPrevPosition[ m ] );
+	}
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		if ( m_fWeight[ m ] > 0.0f )
+		{
+			if ( m_pSystem->findContact( m, m_vPrevPosition[ m ] ) )
+				m_pSystem->projectContact( m, m_vPrevPosition[ m ] );
+
+			sMasses.m_vVelocity[ m ] = (sMasses.m_vPosition[ m ] - m_vPrevPosition[ m ]) / fDeltaT;
+		}
+	}
+}
+
+// Applies gravity and spring damping (the same forces as the other integrators, the damping taken
+//	implicitly) to the velocities, moves every free mass along its velocity and updates its contact along
+//	the predicted path.
+void XPBDSolver::predict( float fDeltaT, int iNumThreads )
+{
+	MassSpringSystem::PointMasses& sMasses = m_pSystem->m_sMasses;
+	int iNumMasses = (int)sMasses.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		vec3& vPosition = sMasses.m_vPosition[ m ];
+		vec3& vVelocity = sMasses.m_vVelocity[ m ];
+
+		m_vPrevPosition[ m ] = vPosition;
+		if ( 0.0f == m_fWeight[ m ] )
+			continue;
+
+		m_pSystem->integrateMassForces( m, fDeltaT );
+		vPosition += vVelocity * fDeltaT;
+
+		m_pSystem->updateContact( m, m_vPrevPosition[ m ] );
+	}
+}
+
+// Projects a single distance constraint C = |x1 - x2| - rest in place.
+void XPBDSolver::projectSpring( unsigned int iSpring, float fCompliance )
+{
+	const MassSpringSystem::Springs& sSprings = m_pSystem->m_sSprings;
+	vec3* pPosition = m_pSystem->m_sMasses.m_vPosition.data();
+	unsigned int iMass1 = sSprings.m_iMass1[ iSpring ];
+	unsigned int iMass2 = sSprings.m_iMass2[ iSpring ];
+	float fWeight = m_fWeight[ iMass1 ] + m_fWeight[ iMass2 ] + fCompliance;
+	vec3 vD12 = pPosition[ iMass1 ] - pPosition[ iMass2 ];
+	float fLength = length( vD12 );
+
+	if ( fLength > 0.0f )
+	{
+		float fDeltaLambda = (sSprings.m_fRestLength[ iSpring ] - fLength - fCompliance * m_fLambda[ iSpring ]) / fWeight;
+		vec3 vCorrection = vD12 * (fDeltaLambda / fLength);
+
+		m_fLambda[ iSpring ] += fDeltaLambda;
+		pPosition[ iMass1 ] += vCorrection * m_fWeight[ iMass1 ];
+		pPosition[ iMass2 ] -= vCorrection * m_fWeight[ iMass2 ];
+	}
+}
+
+// Gauss-Seidel: each spring sees the corrections of every spring before it.  Springs of the same color
+//	share no masses, so each color is projected in parallel; uncolored overflow springs run serially.
+void XPBDSolver::solveGaussSeidel( float fCompliance, int iNumThreads )
+{
+	const vector< unsigned int >& vColorOffsets = m_pSystem->m_vColorOffsets;
+	int iNumColors = (int)vColorOffsets.size() - 1;
+
+	for ( int c = 0; c < iNumColors; ++c )
+	{
+		int iBegin = (int)vColorOffsets[ c ];
+		int iEnd = (int)vColorOffsets[ c + 1 ];
+		bool bParallel = iNumThreads > 1 && c != SERIAL_SPRING_COLOR;
+
+		#pragma omp parallel for num_threads( iNumThreads ) if( bParallel )
+		for ( int s = iBegin; s < iEnd; ++s )
+			projectSpring( s, fCompliance );
+	}
+}
+
+// Jacobi: every spring computes its correction from the same positions, then each mass moves by the
+//	over-relaxed average of the corrections of its springs.  Both passes are fully parallel.
+void XPBDSolver::solveJacobi( float fCompliance, int iNumThreads )
+{
+	const MassSpringSystem::Springs& sSprings = m_pSystem->m_sSprings;
+	const MassSpringSystem::SpringAdjacency& sAdjacency = m_pSystem->m_sAdjacency;
+	vec3* pPosition = m_pSystem->m_sMasses.m_vPosition.data();
+	int iNumSprings = (int)sSprings.size();
+	int iNumMasses = (int)m_fWeight.size();
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int s = 0; s < iNumSprings; ++s )
+	{
+		unsigned int iMass1 = sSprings.m_iMass1[ s ];
+		unsigned int iMass2 = sSprings.m_iMass2[ s ];
+		vec3 vD12 = pPosition[ iMass1 ] - pPosition[ iMass2 ];
+		float fLength = length( vD12 );
+
+		m_vCorrection[ s ] = vec3( 0.0f );
+		if ( fLength > 0.0f )
+		{
+			float fDeltaLambda = (sSprings.m_fRestLength[ s ] - fLength - fCompliance * m_fLambda[ s ])
+								 / (m_fWeight[ iMass1 ] + m_fWeight[ iMass2 ] + fCompliance);
+
+			m_fLambda[ s ] += fDeltaLambda;
+			m_vCorrection[ s ] = vD12 * (fDeltaLambda / fLength);
+		}
+	}
+
+	#pragma omp parallel for num_threads( iNumThreads ) if( iNumThreads > 1 )
+	for ( int m = 0; m < iNumMasses; ++m )
+	{
+		vec3 vSum( 0.0f );
+		unsigned int iCount = sAdjacency.getCount( m );
+
+		if ( 0.0f == m_fWeight[ m ] || 0 == iCount )
+			continue;
+
+		for ( unsigned int a = sAdjacency.m_vOffsets[ m ]; a < sAdjacency.m_vOffsets[ m + 1 ]; ++a )
+		{
+			unsigned int s = sAdjacency.m_vSpring[ a ];
+			vSum += (sSprings.m_iMass1[ s ] == (unsigned int)m) ? m_vCorrection[ s ] : -m_vCorrection[ s ];
+		}
+
+		pPosition[ m ] += vSum * (m_fWeight[ m ] * JACOBI_RELAXATION / (float)iCount);
+	}
+}